@@ -16,6 +16,7 @@ Usage: $0 [OPTIONS]
 
     --with-libdvbcsa            - build with libdvbcsa
     --with-igmp-emulation       - build with igmp emulated multicast renew
+    --with-io-uring             - use io_uring instead of epoll (Linux 6.0+)
 
     --cc=GCC                    - custom C compiler (cross-compile)
     --static                    - build static binary
@@ -47,6 +48,7 @@ ARG_CFLAGS=""
 ARG_LDFLAGS=""
 ARG_LIBDVBCSA=0
 ARG_IGMP_EMULATION=0
+ARG_IO_URING=0
 ARG_DEBUG=0
 
 set_cc()
@@ -76,6 +78,9 @@ while [ $# -ne 0 ] ; do
         "--with-igmp-emulation")
             ARG_IGMP_EMULATION=1
             ;;
+        "--with-io-uring")
+            ARG_IO_URING=1
+            ;;
         "--cc="*)
             set_cc `echo $OPT | sed 's/^--cc=//'`
             ;;
@@ -365,6 +370,26 @@ if check_clock_gettime ; then
     LDFLAGS="$LDFLAGS -lrt"
 fi
 
+clock_nanosleep_test_c()
+{
+    cat <<EOF
+#include <time.h>
+int main(void) {
+    struct timespec ts = { 0, 0 };
+    return clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+EOF
+}
+
+check_clock_nanosleep()
+{
+    clock_nanosleep_test_c | $APP_C -Werror $CFLAGS -c -o /dev/null -x c - >/dev/null 2>&1
+}
+
+if check_clock_nanosleep ; then
+    CFLAGS="$CFLAGS -DHAVE_CLOCK_NANOSLEEP=1"
+fi
+
 sctp_h_test_c()
 {
     cat <<EOF
@@ -455,6 +480,128 @@ if check_strnlen ; then
     CFLAGS="$CFLAGS -DHAVE_STRNLEN=1"
 fi
 
+eventfd_test_c()
+{
+    cat <<EOF
+#include <sys/eventfd.h>
+int main(void) { return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC); }
+EOF
+}
+
+check_eventfd()
+{
+    eventfd_test_c | $APP_C -Werror $CFLAGS -c -o /dev/null -x c - >/dev/null 2>&1
+}
+
+if check_eventfd ; then
+    CFLAGS="$CFLAGS -DHAVE_EVENTFD=1"
+fi
+
+recvmmsg_test_c()
+{
+    cat <<EOF
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+int main(void)
+{
+    struct mmsghdr m[2];
+    memset(m, 0, sizeof(m));
+    return recvmmsg(0, m, 2, MSG_DONTWAIT, NULL);
+}
+EOF
+}
+
+check_recvmmsg()
+{
+    recvmmsg_test_c | $APP_C -Werror $CFLAGS -c -o /dev/null -x c - >/dev/null 2>&1
+}
+
+if check_recvmmsg ; then
+    CFLAGS="$CFLAGS -DHAVE_RECVMMSG=1"
+fi
+
+sendmmsg_test_c()
+{
+    cat <<EOF
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+int main(void)
+{
+    struct mmsghdr m[2];
+    memset(m, 0, sizeof(m));
+    return sendmmsg(0, m, 2, MSG_DONTWAIT);
+}
+EOF
+}
+
+check_sendmmsg()
+{
+    sendmmsg_test_c | $APP_C -Werror $CFLAGS -c -o /dev/null -x c - >/dev/null 2>&1
+}
+
+if check_sendmmsg ; then
+    CFLAGS="$CFLAGS -DHAVE_SENDMMSG=1"
+fi
+
+tpacket_v3_test_c()
+{
+    cat <<EOF
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+int main(void)
+{
+    struct tpacket_req3 req = { .tp_block_size = 0 };
+    struct tpacket_block_desc *block = (struct tpacket_block_desc *)0;
+    return (int)req.tp_block_size + TPACKET_V3 + PACKET_RX_RING + SO_ATTACH_FILTER
+         + (block != 0);
+}
+EOF
+}
+
+check_tpacket_v3()
+{
+    tpacket_v3_test_c | $APP_C -Werror $CFLAGS -c -o /dev/null -x c - >/dev/null 2>&1
+}
+
+if check_tpacket_v3 ; then
+    CFLAGS="$CFLAGS -DHAVE_TPACKET_V3=1"
+fi
+
+# io_uring
+
+io_uring_test_c()
+{
+    cat <<EOF
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+int main(void)
+{
+    struct io_uring_buf_reg reg = { .bgid = 0 };
+    return (int)reg.bgid + IORING_RECV_MULTISHOT + IORING_REGISTER_PBUF_RING + __NR_io_uring_setup;
+}
+EOF
+}
+
+check_io_uring()
+{
+    io_uring_test_c | $APP_C -Werror $CFLAGS -c -o /dev/null -x c - >/dev/null 2>&1
+}
+
+if [ $ARG_IO_URING -eq 1 ] ; then
+    if [ "$OS" != "linux" ] ; then
+        echo "ERROR: io_uring is available on Linux only" >&2
+        exit 1
+    fi
+    if ! check_io_uring ; then
+        echo "ERROR: linux/io_uring.h is not found or too old" >&2
+        exit 1
+    fi
+    CFLAGS="$CFLAGS -DWITH_IO_URING=1"
+fi
+
 # IGMP Emulation
 
 if [ $ARG_IGMP_EMULATION -eq 1 ]; then
@@ -39,6 +39,21 @@ uint64_t asc_utime(void)
 #endif
 }
 
+__asc_inline
+uint64_t asc_ntime(void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+
+    if(clock_gettime(CLOCK_MONOTONIC, &ts) == EINVAL)
+        (void)clock_gettime(CLOCK_REALTIME, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000) + (uint64_t)ts.tv_nsec;
+#else
+    return asc_utime() * 1000;
+#endif
+}
+
 __asc_inline
 void asc_usleep(uint64_t usec)
 {
@@ -58,3 +73,19 @@ void asc_usleep(uint64_t usec)
     CloseHandle(timer);
 #endif
 }
+
+/* sleep until the absolute time in the asc_utime() scale */
+void asc_usleep_until(uint64_t utime)
+{
+#ifdef HAVE_CLOCK_NANOSLEEP
+    struct timespec ts;
+    ts.tv_sec = utime / 1000000;
+    ts.tv_nsec = (utime % 1000000) * 1000;
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        continue;
+#else
+    const uint64_t now = asc_utime();
+    if(utime > now)
+        asc_usleep(utime - now);
+#endif
+}
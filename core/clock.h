@@ -25,6 +25,8 @@
 #include "base.h"
 
 uint64_t asc_utime(void);
+uint64_t asc_ntime(void);
 void asc_usleep(uint64_t usec);
+void asc_usleep_until(uint64_t utime);
 
 #endif /* _ASC_CLOCK_H_ */
@@ -21,9 +21,14 @@
 #include "assert.h"
 #include "event.h"
 #include "list.h"
+#include "clock.h"
 #include "log.h"
 #include "loopctl.h"
 
+#ifdef HAVE_EVENTFD
+#   include <sys/eventfd.h>
+#endif
+
 #ifndef EV_LIST_SIZE
 #   define EV_LIST_SIZE 1024
 #endif
@@ -35,6 +40,15 @@
 #elif defined(WITH_SELECT)
 #   define EV_TYPE_SELECT
 #   define MSG(_msg) "[core/event select] " _msg
+#elif defined(WITH_IO_URING)
+#   define EV_TYPE_URING
+#   include <sys/mman.h>
+#   include <sys/syscall.h>
+#   include <netinet/in.h>
+#   include <linux/io_uring.h>
+#   include <poll.h>
+#   include <pthread.h>
+#   define MSG(_msg) "[core/event io_uring] " _msg
 #elif defined(WITH_KQUEUE)
 #   define EV_TYPE_KQUEUE
 #   include <sys/event.h>
@@ -61,8 +75,123 @@ struct asc_event_t
     event_callback_t on_write;
     event_callback_t on_error;
     void *arg;
+
+#ifdef EV_TYPE_URING
+    bool is_closed;
+    bool is_ready;          /* in the ready list */
+    asc_event_t *ready_next;
+    int op_count;           /* requests in flight and dispatch holds */
+
+    bool is_poll;           /* poll is armed */
+    uint32_t poll_mask;
+
+    int recv_type;          /* SOCK_STREAM, SOCK_DGRAM or 0 - poll */
+    bool is_recv;           /* multishot receive is armed */
+    bool is_recv_cancel;
+    struct msghdr recv_msg; /* SOCK_DGRAM: recvmsg template */
+
+    int recv_head;          /* received buffers queue */
+    int recv_tail;
+    int recv_size;
+    uint64_t recv_count;    /* asc_event_recv() calls with result */
+
+    bool is_eof;
+    bool is_truncated;
+    bool is_notified;       /* eof or error delivered to on_read */
+    int error;
+#endif
 };
 
+/*
+ * oooo     oooo      o      oooo   oooo ooooooooooo
+ *  88   88  88      888      888  o88    888    88
+ *   88 888 88      8  88     888888      888ooo8
+ *    888 888      8oooo88    888  88o    888    oo
+ *     8   8     o88o  o888o o888o o888o o888ooo8888
+ *
+ * asc_event_core_wake() interrupts the blocking wait of the main loop.
+ * Safe to call from the worker threads and from the signal handlers.
+ */
+
+static inline void asc_event_call(event_callback_t callback, void *arg)
+{
+    const uint64_t time_begin = asc_utime();
+    callback(arg);
+    asc_main_loop_trace(&main_loop_stat.event_time, time_begin, "event", NULL);
+}
+
+#ifndef _WIN32
+#   define EV_WAKE 1
+
+static int wake_fd[2] = { -1, -1 }; /* 0 - read, 1 - write */
+static volatile int wake_pending = 0;
+
+static void asc_event_wake_open(void)
+{
+#ifdef HAVE_EVENTFD
+    wake_fd[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    wake_fd[1] = wake_fd[0];
+    asc_assert(wake_fd[0] != -1, MSG("failed to open eventfd [%s]"), strerror(errno));
+#else
+    const int ret = pipe(wake_fd);
+    asc_assert(ret != -1, MSG("failed to open pipe [%s]"), strerror(errno));
+    for(int i = 0; i < 2; ++i)
+    {
+        fcntl(wake_fd[i], F_SETFL, fcntl(wake_fd[i], F_GETFL) | O_NONBLOCK);
+        fcntl(wake_fd[i], F_SETFD, FD_CLOEXEC);
+    }
+#endif
+    wake_pending = 0;
+}
+
+static void asc_event_wake_close(void)
+{
+    if(wake_fd[0] == -1)
+        return;
+
+    close(wake_fd[0]);
+    if(wake_fd[1] != wake_fd[0])
+        close(wake_fd[1]);
+    wake_fd[0] = -1;
+    wake_fd[1] = -1;
+}
+
+static void asc_event_wake_drain(void)
+{
+    /* clear flag before reading, the next wake will be written again */
+    __sync_lock_release(&wake_pending);
+
+    uint64_t value;
+    while(read(wake_fd[0], &value, sizeof(value)) > 0)
+        ;
+
+    ++main_loop_stat.wake_count;
+}
+
+void asc_event_core_wake(void)
+{
+    if(wake_fd[1] == -1)
+        return;
+
+    if(__sync_lock_test_and_set(&wake_pending, 1))
+        return;
+
+    const uint64_t value = 1;
+    const int errno_save = errno;
+    if(write(wake_fd[1], &value, sizeof(value)) == -1)
+        __sync_lock_release(&wake_pending);
+    errno = errno_save;
+}
+
+#else
+
+void asc_event_core_wake(void)
+{
+    ;
+}
+
+#endif /* !_WIN32 */
+
 #if defined(EV_TYPE_KQUEUE) || defined(EV_TYPE_EPOLL)
 
 /*
@@ -107,6 +236,20 @@ void asc_event_core_init(void)
     asc_assert(event_observer.fd != -1
                , MSG("failed to init event observer [%s]")
                , strerror(errno));
+
+    /* wake descriptor is registered with NULL as user data */
+    asc_event_wake_open();
+
+    EV_OTYPE ed;
+#if defined(EV_TYPE_KQUEUE)
+    EV_SET(&ed, wake_fd[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+    const int ret = kevent(event_observer.fd, &ed, 1, NULL, 0, NULL);
+#else
+    ed.data.ptr = NULL;
+    ed.events = EPOLLIN;
+    const int ret = epoll_ctl(event_observer.fd, EPOLL_CTL_ADD, wake_fd[0], &ed);
+#endif
+    asc_assert(ret != -1, MSG("failed to attach wake fd [%s]"), strerror(errno));
 }
 
 void asc_event_core_destroy(void)
@@ -117,6 +260,8 @@ void asc_event_core_destroy(void)
     close(event_observer.fd);
     event_observer.fd = 0;
 
+    asc_event_wake_close();
+
     asc_event_t *prev_event = NULL;
     for(asc_list_first(event_observer.event_list)
         ; !asc_list_eol(event_observer.event_list)
@@ -135,18 +280,23 @@ void asc_event_core_destroy(void)
     event_observer.event_list = NULL;
 }
 
-void asc_event_core_loop(void)
+void asc_event_core_loop(unsigned int timeout)
 {
-    if(!asc_list_size(event_observer.event_list))
-        return;
+    if(timeout > 0)
+        ++main_loop_stat.wait_count;
 
+    const uint64_t wait_begin = asc_utime();
 #if defined(EV_TYPE_KQUEUE)
-    static const struct timespec timeout = { 0, 0 };
+    struct timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000;
     const int ret = kevent(event_observer.fd, NULL, 0
-                           , event_observer.ed_list, EV_LIST_SIZE, &timeout);
+                           , event_observer.ed_list, EV_LIST_SIZE, &ts);
 #else
-    const int ret = epoll_wait(event_observer.fd, event_observer.ed_list, EV_LIST_SIZE, 0);
+    const int ret = epoll_wait(event_observer.fd, event_observer.ed_list, EV_LIST_SIZE
+                               , (int)timeout);
 #endif
+    main_loop_stat.wait_time = asc_utime() - wait_begin;
 
     if(ret == -1)
     {
@@ -159,11 +309,21 @@ void asc_event_core_loop(void)
     {
         EV_OTYPE *ed = &event_observer.ed_list[i];
 #if defined(EV_TYPE_KQUEUE)
+        if(ed->udata == NULL)
+        {
+            asc_event_wake_drain();
+            continue;
+        }
         asc_event_t *event = (asc_event_t *)ed->udata;
         const bool is_rd = (ed->data > 0) && (ed->filter == EVFILT_READ);
         const bool is_wr = (ed->data > 0) && (ed->filter == EVFILT_WRITE);
         const bool is_er = (ed->flags & ~EV_ADD) && (!is_rd || is_wr);
 #else
+        if(ed->data.ptr == NULL)
+        {
+            asc_event_wake_drain();
+            continue;
+        }
         asc_event_t *event = (asc_event_t *)ed->data.ptr;
         const bool is_rd = ed->events & EPOLLIN;
         const bool is_wr = ed->events & EPOLLOUT;
@@ -172,21 +332,21 @@ void asc_event_core_loop(void)
         if(event->on_read && is_rd)
         {
             is_main_loop_idle = false;
-            event->on_read(event->arg);
+            asc_event_call(event->on_read, event->arg);
             if(event_observer.is_changed)
                 break;
         }
         if(event->on_error && is_er)
         {
             is_main_loop_idle = false;
-            event->on_error(event->arg);
+            asc_event_call(event->on_error, event->arg);
             if(event_observer.is_changed)
                 break;
         }
         if(event->on_write && is_wr)
         {
             is_main_loop_idle = false;
-            event->on_write(event->arg);
+            asc_event_call(event->on_write, event->arg);
             if(event_observer.is_changed)
                 break;
         }
@@ -294,6 +454,1003 @@ void asc_event_close(asc_event_t *event)
     free(event);
 }
 
+#elif defined(EV_TYPE_URING)
+
+/*
+ * ooooo  oooo oooooooooo  ooooo oooo   oooo  oooooooo8
+ *  888    88   888    888  888   8888o  88 o888     88
+ *  888    88   888oooo88   888   88 888o88 888    oooooo
+ *  888    88   888  88o    888   88   8888 888o    oo88
+ *   888oo88   o888o  88o8 o888o o88o    88  888ooo888
+ *
+ * Sockets keep a multishot receive armed. The kernel picks a buffer from
+ * the shared provided buffer ring, the completion is queued in the event and
+ * on_read is called. asc_socket_recv() copies data from the queue without
+ * a syscall. Other descriptors and the write readiness use a poll request,
+ * re-armed after each completion to keep the level-triggered behavior.
+ * Datagrams are copied into the send slots and submitted in batches with
+ * the next io_uring_enter().
+ */
+
+#ifndef URING_BUFFER_COUNT
+#   define URING_BUFFER_COUNT 4096 /* power of 2 */
+#endif
+
+#ifndef URING_BUFFER_SIZE
+#   define URING_BUFFER_SIZE 2048
+#endif
+
+#ifndef URING_SEND_COUNT
+#   define URING_SEND_COUNT 1024
+#endif
+
+#define URING_SEND_SIZE 2048
+#define URING_SEND_BATCH 32
+#define URING_QUEUE_LIMIT 64 /* receive is paused while more buffers queued */
+#define URING_CQ_SIZE (EV_LIST_SIZE * 16)
+#define URING_BGID 1
+
+/* request type in the low bits of user_data */
+#define URING_OP_WAKE 1
+#define URING_OP_POLL 2
+#define URING_OP_RECV 3
+#define URING_OP_SEND 4
+#define URING_OP_CANCEL 5
+#define URING_OP_MASK 7
+
+#define URING_UD(_ptr, _op) ((uint64_t)(uintptr_t)(_ptr) | (_op))
+
+typedef struct
+{
+    int next;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t name_size;
+} uring_buffer_t;
+
+typedef struct uring_send_t uring_send_t;
+
+struct uring_send_t
+{
+    uring_send_t *next;
+    asc_event_send_status_t *status; /* NULL if not in flight */
+    struct msghdr msg;
+    struct iovec iov;
+    struct sockaddr_storage addr;
+    uint8_t buffer[URING_SEND_SIZE];
+};
+
+typedef struct
+{
+    asc_list_t *event_list;
+    asc_list_t *zombie_list; /* closed, requests in flight */
+
+    int fd;
+    pthread_t thread;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    uint32_t *sq_array;
+    struct io_uring_sqe *sqe_list;
+    size_t sqe_list_size;
+    uint32_t sq_local_tail;
+    uint32_t sq_pending;
+
+    void *cq_ring;
+    size_t cq_ring_size;
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe *cqe_list;
+
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    uint16_t buf_ring_tail;
+    uint8_t *buffer;
+    uring_buffer_t buffer_list[URING_BUFFER_COUNT];
+
+    uring_send_t *send_list;
+    uring_send_t *send_free;
+    int send_pending;
+
+    asc_event_t *ready_head;
+    asc_event_t *ready_tail;
+} event_observer_t;
+
+static event_observer_t event_observer;
+
+static void asc_event_subscribe(asc_event_t *event);
+
+static inline uint32_t uring_load(const uint32_t *ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void uring_store(uint32_t *ptr, uint32_t value)
+{
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+static int uring_enter(unsigned int to_submit, unsigned int min_complete, unsigned int timeout)
+{
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000;
+
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+
+    return syscall(  __NR_io_uring_enter, event_observer.fd, to_submit, min_complete
+                   , IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+static void uring_submit(void)
+{
+    uring_store(event_observer.sq_tail, event_observer.sq_local_tail);
+    event_observer.send_pending = 0;
+
+    while(event_observer.sq_pending > 0)
+    {
+        const int ret = syscall(  __NR_io_uring_enter, event_observer.fd
+                                , event_observer.sq_pending, 0, 0, NULL, 0);
+        if(ret == -1)
+        {
+            if(errno == EINTR)
+                continue;
+            /* completion queue is overflowed, submitted with the next loop */
+            asc_assert(errno == EAGAIN || errno == EBUSY
+                       , MSG("failed to submit [%s]"), strerror(errno));
+            return;
+        }
+        event_observer.sq_pending -= ret;
+    }
+}
+
+static struct io_uring_sqe * uring_sqe(void)
+{
+    if(event_observer.sq_local_tail - uring_load(event_observer.sq_head)
+       >= event_observer.sq_entries)
+    {
+        uring_submit();
+        asc_assert(event_observer.sq_local_tail - uring_load(event_observer.sq_head)
+                   < event_observer.sq_entries
+                   , MSG("submission queue overflow"));
+    }
+
+    const uint32_t i = event_observer.sq_local_tail & event_observer.sq_mask;
+    struct io_uring_sqe *sqe = &event_observer.sqe_list[i];
+    memset(sqe, 0, sizeof(*sqe));
+    event_observer.sq_array[i] = i;
+
+    ++event_observer.sq_local_tail;
+    ++event_observer.sq_pending;
+
+    return sqe;
+}
+
+static void uring_poll_add(int fd, uint32_t mask, uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = uring_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = mask;
+    sqe->user_data = user_data;
+}
+
+static void uring_cancel(uint8_t opcode, uint64_t target)
+{
+    struct io_uring_sqe *sqe = uring_sqe();
+    sqe->opcode = opcode;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = URING_UD(NULL, URING_OP_CANCEL);
+}
+
+/*
+ * Buffers
+ */
+
+static void uring_buffer_recycle(int bid)
+{
+    struct io_uring_buf *buf = &event_observer.buf_ring->bufs[
+        event_observer.buf_ring_tail & (URING_BUFFER_COUNT - 1)];
+    buf->addr = (uint64_t)(uintptr_t)&event_observer.buffer[(size_t)bid * URING_BUFFER_SIZE];
+    buf->len = URING_BUFFER_SIZE;
+    buf->bid = bid;
+
+    ++event_observer.buf_ring_tail;
+    __atomic_store_n(&event_observer.buf_ring->tail, event_observer.buf_ring_tail
+                     , __ATOMIC_RELEASE);
+}
+
+static void uring_event_push(asc_event_t *event, int bid, uint32_t size)
+{
+    uring_buffer_t *buffer = &event_observer.buffer_list[bid];
+    buffer->next = -1;
+    buffer->offset = 0;
+    buffer->size = size;
+    buffer->name_size = 0;
+
+    if(event->recv_type == SOCK_DGRAM)
+    {
+        const uint8_t *data = &event_observer.buffer[(size_t)bid * URING_BUFFER_SIZE];
+        const struct io_uring_recvmsg_out *out = (const struct io_uring_recvmsg_out *)data;
+        const uint32_t skip = sizeof(*out) + event->recv_msg.msg_namelen;
+        if(size < skip)
+        {
+            uring_buffer_recycle(bid);
+            return;
+        }
+        buffer->offset = skip;
+        buffer->size = size - skip;
+        if(out->payloadlen < buffer->size)
+            buffer->size = out->payloadlen;
+        else if(out->payloadlen > buffer->size && !event->is_truncated)
+        {
+            event->is_truncated = true;
+            asc_log_warning(MSG("fd=%d datagram size %u is greater than URING_BUFFER_SIZE")
+                            , event->fd, out->payloadlen);
+        }
+        buffer->name_size = out->namelen;
+        if(buffer->name_size > event->recv_msg.msg_namelen)
+            buffer->name_size = event->recv_msg.msg_namelen;
+    }
+
+    if(event->recv_head == -1)
+        event->recv_head = bid;
+    else
+        event_observer.buffer_list[event->recv_tail].next = bid;
+    event->recv_tail = bid;
+    ++event->recv_size;
+}
+
+static void uring_event_pop(asc_event_t *event)
+{
+    const int bid = event->recv_head;
+    event->recv_head = event_observer.buffer_list[bid].next;
+    if(event->recv_head == -1)
+        event->recv_tail = -1;
+    --event->recv_size;
+
+    uring_buffer_recycle(bid);
+}
+
+/*
+ * Events
+ */
+
+static void uring_event_free(asc_event_t *event)
+{
+    if(!event->is_closed || event->op_count > 0 || event->is_ready)
+        return;
+
+    asc_list_remove_item(event_observer.zombie_list, event);
+    free(event);
+}
+
+static void uring_ready_push(asc_event_t *event)
+{
+    if(event->is_ready)
+        return;
+
+    event->is_ready = true;
+    event->ready_next = NULL;
+    if(event_observer.ready_tail)
+        event_observer.ready_tail->ready_next = event;
+    else
+        event_observer.ready_head = event;
+    event_observer.ready_tail = event;
+}
+
+static inline bool uring_event_is_pending(asc_event_t *event)
+{
+    return (event->recv_head != -1)
+           || ((event->is_eof || event->error) && !event->is_notified);
+}
+
+static void uring_on_poll(asc_event_t *event, int res, uint32_t flags)
+{
+    if(!(flags & IORING_CQE_F_MORE))
+    {
+        event->is_poll = false;
+        --event->op_count;
+    }
+
+    if(event->is_closed)
+    {
+        uring_event_free(event);
+        return;
+    }
+
+    ++event->op_count;
+
+    if(res > 0)
+    {
+        const bool is_rd = (res & POLLIN) && event->recv_type == 0;
+        const bool is_wr = res & POLLOUT;
+        const bool is_er = res & (POLLERR | POLLRDHUP);
+
+        do
+        {
+            if(event->on_read && is_rd)
+            {
+                is_main_loop_idle = false;
+                asc_event_call(event->on_read, event->arg);
+                if(event->is_closed)
+                    break;
+            }
+            if(event->on_error && is_er)
+            {
+                is_main_loop_idle = false;
+                asc_event_call(event->on_error, event->arg);
+                if(event->is_closed)
+                    break;
+            }
+            if(event->on_write && is_wr)
+            {
+                is_main_loop_idle = false;
+                asc_event_call(event->on_write, event->arg);
+                if(event->is_closed)
+                    break;
+            }
+        } while(0);
+    }
+
+    --event->op_count;
+
+    if(!event->is_closed && !event->is_poll)
+        asc_event_subscribe(event);
+
+    uring_event_free(event);
+}
+
+static void uring_on_recv(asc_event_t *event, int res, uint32_t flags)
+{
+    if(!(flags & IORING_CQE_F_MORE))
+    {
+        event->is_recv = false;
+        event->is_recv_cancel = false;
+        --event->op_count;
+    }
+
+    if(flags & IORING_CQE_F_BUFFER)
+    {
+        const int bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        if(event->is_closed || res <= 0)
+            uring_buffer_recycle(bid);
+        else
+        {
+            uring_event_push(event, bid, (uint32_t)res);
+            if(event->recv_size >= URING_QUEUE_LIMIT
+               && event->is_recv && !event->is_recv_cancel)
+            {
+                /* consumer is slow, keep data in the socket buffer */
+                event->is_recv_cancel = true;
+                uring_cancel(IORING_OP_ASYNC_CANCEL, URING_UD(event, URING_OP_RECV));
+            }
+        }
+    }
+    else if(res == 0)
+    {
+        if(event->recv_type == SOCK_STREAM)
+            event->is_eof = true;
+    }
+    else if(res < 0)
+    {
+        switch(-res)
+        {
+            case ENOBUFS:
+            case ECANCELED:
+                /* rearmed on dispatch */
+                break;
+            default:
+                event->error = -res;
+                break;
+        }
+    }
+
+    if(event->is_closed)
+    {
+        uring_event_free(event);
+        return;
+    }
+
+    if(uring_event_is_pending(event) || !event->is_recv)
+        uring_ready_push(event);
+}
+
+static void uring_on_send(uring_send_t *send, int res)
+{
+    if(res < 0)
+        send->status->error = -res;
+
+    asc_event_send_release(send->status);
+    send->status = NULL;
+
+    send->next = event_observer.send_free;
+    event_observer.send_free = send;
+}
+
+static void uring_on_wake(int res, uint32_t flags)
+{
+    __uarg(res);
+
+    asc_event_wake_drain();
+
+    if(!(flags & IORING_CQE_F_MORE))
+        uring_poll_add(wake_fd[0], POLLIN, URING_UD(NULL, URING_OP_WAKE));
+}
+
+static void uring_dispatch(void)
+{
+    asc_event_t *event = event_observer.ready_head;
+    event_observer.ready_head = NULL;
+    event_observer.ready_tail = NULL;
+
+    while(event)
+    {
+        asc_event_t *next = event->ready_next;
+        event->ready_next = NULL;
+        event->is_ready = false;
+
+        if(event->is_closed)
+        {
+            uring_event_free(event);
+            event = next;
+            continue;
+        }
+
+        ++event->op_count;
+
+        while(event->on_read && uring_event_is_pending(event))
+        {
+            const uint64_t recv_count = event->recv_count;
+            is_main_loop_idle = false;
+            asc_event_call(event->on_read, event->arg);
+            if(event->is_closed || event->recv_count == recv_count)
+                break;
+        }
+
+        --event->op_count;
+
+        if(!event->is_closed)
+        {
+            /* data is not consumed, call again on the next loop */
+            if(event->on_read && uring_event_is_pending(event))
+                uring_ready_push(event);
+            asc_event_subscribe(event);
+        }
+
+        uring_event_free(event);
+        event = next;
+    }
+}
+
+static void uring_complete(uint64_t user_data, int res, uint32_t flags)
+{
+    void *ptr = (void *)(uintptr_t)(user_data & ~(uint64_t)URING_OP_MASK);
+
+    switch(user_data & URING_OP_MASK)
+    {
+        case URING_OP_WAKE:
+            uring_on_wake(res, flags);
+            break;
+        case URING_OP_POLL:
+            uring_on_poll((asc_event_t *)ptr, res, flags);
+            break;
+        case URING_OP_RECV:
+            uring_on_recv((asc_event_t *)ptr, res, flags);
+            break;
+        case URING_OP_SEND:
+            uring_on_send((uring_send_t *)ptr, res);
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Core
+ */
+
+void asc_event_core_init(void)
+{
+    memset(&event_observer, 0, sizeof(event_observer));
+    event_observer.event_list = asc_list_init();
+    event_observer.zombie_list = asc_list_init();
+    event_observer.thread = pthread_self();
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    p.cq_entries = URING_CQ_SIZE;
+    event_observer.fd = syscall(__NR_io_uring_setup, EV_LIST_SIZE, &p);
+    if(event_observer.fd == -1 && errno == EINVAL)
+    {
+        /* Linux before 6.1 */
+        memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = URING_CQ_SIZE;
+        event_observer.fd = syscall(__NR_io_uring_setup, EV_LIST_SIZE, &p);
+    }
+    asc_assert(event_observer.fd != -1
+               , MSG("failed to init event observer [%s]")
+               , strerror(errno));
+    asc_assert(p.features & IORING_FEAT_EXT_ARG, MSG("kernel is not supported"));
+
+    event_observer.sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    event_observer.cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(event_observer.cq_ring_size > event_observer.sq_ring_size)
+            event_observer.sq_ring_size = event_observer.cq_ring_size;
+        event_observer.cq_ring_size = event_observer.sq_ring_size;
+    }
+
+    event_observer.sq_ring = mmap(  NULL, event_observer.sq_ring_size
+                                  , PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE
+                                  , event_observer.fd, IORING_OFF_SQ_RING);
+    asc_assert(event_observer.sq_ring != MAP_FAILED
+               , MSG("failed to map submission queue [%s]"), strerror(errno));
+
+    if(p.features & IORING_FEAT_SINGLE_MMAP)
+        event_observer.cq_ring = event_observer.sq_ring;
+    else
+    {
+        event_observer.cq_ring = mmap(  NULL, event_observer.cq_ring_size
+                                      , PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE
+                                      , event_observer.fd, IORING_OFF_CQ_RING);
+        asc_assert(event_observer.cq_ring != MAP_FAILED
+                   , MSG("failed to map completion queue [%s]"), strerror(errno));
+    }
+
+    event_observer.sqe_list_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    event_observer.sqe_list = (struct io_uring_sqe *)mmap(
+        NULL, event_observer.sqe_list_size
+        , PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE
+        , event_observer.fd, IORING_OFF_SQES);
+    asc_assert(event_observer.sqe_list != MAP_FAILED
+               , MSG("failed to map submission entries [%s]"), strerror(errno));
+
+    uint8_t *sq_ring = (uint8_t *)event_observer.sq_ring;
+    event_observer.sq_head = (uint32_t *)&sq_ring[p.sq_off.head];
+    event_observer.sq_tail = (uint32_t *)&sq_ring[p.sq_off.tail];
+    event_observer.sq_mask = *(uint32_t *)&sq_ring[p.sq_off.ring_mask];
+    event_observer.sq_entries = *(uint32_t *)&sq_ring[p.sq_off.ring_entries];
+    event_observer.sq_array = (uint32_t *)&sq_ring[p.sq_off.array];
+    event_observer.sq_local_tail = *event_observer.sq_tail;
+
+    uint8_t *cq_ring = (uint8_t *)event_observer.cq_ring;
+    event_observer.cq_head = (uint32_t *)&cq_ring[p.cq_off.head];
+    event_observer.cq_tail = (uint32_t *)&cq_ring[p.cq_off.tail];
+    event_observer.cq_mask = *(uint32_t *)&cq_ring[p.cq_off.ring_mask];
+    event_observer.cqe_list = (struct io_uring_cqe *)&cq_ring[p.cq_off.cqes];
+
+    /* provided buffers */
+    event_observer.buf_ring_size = URING_BUFFER_COUNT * sizeof(struct io_uring_buf);
+    event_observer.buf_ring = (struct io_uring_buf_ring *)mmap(
+        NULL, event_observer.buf_ring_size
+        , PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    asc_assert(event_observer.buf_ring != MAP_FAILED
+               , MSG("failed to allocate buffer ring [%s]"), strerror(errno));
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)event_observer.buf_ring;
+    reg.ring_entries = URING_BUFFER_COUNT;
+    reg.bgid = URING_BGID;
+    const int ret = syscall(  __NR_io_uring_register, event_observer.fd
+                            , IORING_REGISTER_PBUF_RING, &reg, 1);
+    asc_assert(ret != -1, MSG("failed to register buffer ring [%s]"), strerror(errno));
+
+    event_observer.buffer = (uint8_t *)malloc((size_t)URING_BUFFER_COUNT * URING_BUFFER_SIZE);
+    for(int i = 0; i < URING_BUFFER_COUNT; ++i)
+        uring_buffer_recycle(i);
+
+    /* send slots */
+    event_observer.send_list = (uring_send_t *)calloc(URING_SEND_COUNT, sizeof(uring_send_t));
+    for(int i = URING_SEND_COUNT - 1; i >= 0; --i)
+    {
+        uring_send_t *send = &event_observer.send_list[i];
+        send->next = event_observer.send_free;
+        event_observer.send_free = send;
+    }
+
+    asc_event_wake_open();
+    uring_poll_add(wake_fd[0], POLLIN, URING_UD(NULL, URING_OP_WAKE));
+}
+
+void asc_event_core_destroy(void)
+{
+    if(!event_observer.fd)
+        return;
+
+    asc_event_t *prev_event = NULL;
+    for(asc_list_first(event_observer.event_list)
+        ; !asc_list_eol(event_observer.event_list)
+        ; asc_list_first(event_observer.event_list))
+    {
+        asc_event_t *event = (asc_event_t *)asc_list_data(event_observer.event_list);
+        asc_assert(event != prev_event
+                   , MSG("loop on asc_event_core_destroy() event:%p")
+                   , (void *)event);
+        if(event->on_error)
+            event->on_error(event->arg);
+        prev_event = event;
+    }
+
+    /* all requests are canceled with the ring */
+    close(event_observer.fd);
+    event_observer.fd = 0;
+
+    munmap(event_observer.sqe_list, event_observer.sqe_list_size);
+    if(event_observer.cq_ring != event_observer.sq_ring)
+        munmap(event_observer.cq_ring, event_observer.cq_ring_size);
+    munmap(event_observer.sq_ring, event_observer.sq_ring_size);
+    munmap(event_observer.buf_ring, event_observer.buf_ring_size);
+    free(event_observer.buffer);
+
+    for(int i = 0; i < URING_SEND_COUNT; ++i)
+    {
+        uring_send_t *send = &event_observer.send_list[i];
+        if(send->status)
+            asc_event_send_release(send->status);
+    }
+    free(event_observer.send_list);
+
+    asc_event_wake_close();
+
+    for(asc_list_first(event_observer.zombie_list)
+        ; !asc_list_eol(event_observer.zombie_list)
+        ; asc_list_first(event_observer.zombie_list))
+    {
+        free(asc_list_data(event_observer.zombie_list));
+        asc_list_remove_current(event_observer.zombie_list);
+    }
+
+    asc_list_destroy(event_observer.zombie_list);
+    event_observer.zombie_list = NULL;
+    asc_list_destroy(event_observer.event_list);
+    event_observer.event_list = NULL;
+}
+
+void asc_event_core_loop(unsigned int timeout)
+{
+    /* not consumed data */
+    if(event_observer.ready_head)
+        timeout = 0;
+
+    if(timeout > 0)
+        ++main_loop_stat.wait_count;
+
+    uring_store(event_observer.sq_tail, event_observer.sq_local_tail);
+    event_observer.send_pending = 0;
+
+    const uint64_t wait_begin = asc_utime();
+    const int ret = uring_enter(event_observer.sq_pending, (timeout > 0) ? 1 : 0, timeout);
+    main_loop_stat.wait_time = asc_utime() - wait_begin;
+
+    if(ret == -1)
+    {
+        asc_assert(   errno == EINTR || errno == ETIME
+                   || errno == EAGAIN || errno == EBUSY
+                   , MSG("event observer critical error [%s]"), strerror(errno));
+    }
+    else
+        event_observer.sq_pending -= ret;
+
+    uint32_t head = *event_observer.cq_head;
+    while(head != uring_load(event_observer.cq_tail))
+    {
+        const struct io_uring_cqe *cqe = &event_observer.cqe_list[head & event_observer.cq_mask];
+        const uint64_t user_data = cqe->user_data;
+        const int res = cqe->res;
+        const uint32_t flags = cqe->flags;
+
+        /* release the entry before callbacks */
+        ++head;
+        uring_store(event_observer.cq_head, head);
+
+        uring_complete(user_data, res, flags);
+    }
+
+    uring_dispatch();
+}
+
+static void asc_event_subscribe(asc_event_t *event)
+{
+    if(event->is_closed)
+        return;
+
+    /* receive */
+    const bool is_recv = (   event->recv_type != 0
+                          && event->on_read != NULL
+                          && !event->is_eof
+                          && !event->error
+                          && event->recv_size < URING_QUEUE_LIMIT);
+
+    if(is_recv && !event->is_recv)
+    {
+        struct io_uring_sqe *sqe = uring_sqe();
+        if(event->recv_type == SOCK_DGRAM)
+        {
+            sqe->opcode = IORING_OP_RECVMSG;
+            sqe->addr = (uint64_t)(uintptr_t)&event->recv_msg;
+            sqe->len = 1;
+            sqe->msg_flags = MSG_TRUNC;
+        }
+        else
+            sqe->opcode = IORING_OP_RECV;
+        sqe->fd = event->fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = URING_BGID;
+        sqe->user_data = URING_UD(event, URING_OP_RECV);
+
+        event->is_recv = true;
+        ++event->op_count;
+    }
+    else if(!is_recv && event->is_recv && !event->is_recv_cancel)
+    {
+        event->is_recv_cancel = true;
+        uring_cancel(IORING_OP_ASYNC_CANCEL, URING_UD(event, URING_OP_RECV));
+    }
+
+    /* readiness */
+    uint32_t mask = 0;
+    if(event->on_read && event->recv_type == 0)
+        mask |= POLLIN;
+    if(event->on_write)
+        mask |= POLLOUT;
+    if(event->on_error && !(event->recv_type != 0 && event->on_read))
+        mask |= POLLRDHUP;
+
+    if(!event->is_poll)
+    {
+        if(mask != 0)
+        {
+            uring_poll_add(event->fd, mask, URING_UD(event, URING_OP_POLL));
+            event->is_poll = true;
+            ++event->op_count;
+        }
+    }
+    else if(mask != event->poll_mask)
+    {
+        if(mask != 0)
+        {
+            struct io_uring_sqe *sqe = uring_sqe();
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = URING_UD(event, URING_OP_POLL);
+            sqe->len = IORING_POLL_UPDATE_EVENTS;
+            sqe->poll32_events = mask;
+            sqe->user_data = URING_UD(NULL, URING_OP_CANCEL);
+        }
+        else
+            uring_cancel(IORING_OP_POLL_REMOVE, URING_UD(event, URING_OP_POLL));
+    }
+    event->poll_mask = mask;
+}
+
+asc_event_t * asc_event_init(int fd, void *arg)
+{
+    asc_event_t *event = (asc_event_t *)calloc(1, sizeof(asc_event_t));
+    event->fd = fd;
+    event->arg = arg;
+    event->recv_head = -1;
+    event->recv_tail = -1;
+
+    asc_list_insert_tail(event_observer.event_list, event);
+
+    return event;
+}
+
+void asc_event_close(asc_event_t *event)
+{
+    if(!event)
+        return;
+
+    asc_list_remove_item(event_observer.event_list, event);
+
+    event->is_closed = true;
+    event->on_read = NULL;
+    event->on_write = NULL;
+    event->on_error = NULL;
+
+    while(event->recv_head != -1)
+        uring_event_pop(event);
+
+    /* requests should be canceled before the descriptor is closed */
+    bool is_submit = false;
+    if(event->is_poll)
+    {
+        uring_cancel(IORING_OP_POLL_REMOVE, URING_UD(event, URING_OP_POLL));
+        is_submit = true;
+    }
+    if(event->is_recv)
+    {
+        uring_cancel(IORING_OP_ASYNC_CANCEL, URING_UD(event, URING_OP_RECV));
+        is_submit = true;
+    }
+    if(is_submit)
+        uring_submit();
+
+    if(event->op_count > 0 || event->is_ready)
+        asc_list_insert_tail(event_observer.zombie_list, event);
+    else
+        free(event);
+}
+
+void asc_event_set_recv(asc_event_t *event, int sock_type)
+{
+    if(event->recv_type == sock_type)
+        return;
+
+    event->recv_type = sock_type;
+    if(sock_type == SOCK_DGRAM)
+    {
+        memset(&event->recv_msg, 0, sizeof(event->recv_msg));
+        event->recv_msg.msg_namelen = sizeof(struct sockaddr_in6);
+    }
+
+    asc_event_subscribe(event);
+}
+
+ssize_t asc_event_recv(  asc_event_t *event, void *buffer, size_t size
+                       , struct sockaddr *addr, socklen_t *addr_size)
+{
+    if(event->recv_head == -1)
+    {
+        if(event->error)
+        {
+            ++event->recv_count;
+            event->is_notified = true;
+            errno = event->error;
+            return -1;
+        }
+        if(event->is_eof)
+        {
+            ++event->recv_count;
+            event->is_notified = true;
+            return 0;
+        }
+        if(!event->is_recv)
+        {
+            /* receive is not armed, read directly */
+            if(addr)
+                return recvfrom(event->fd, buffer, size, 0, addr, addr_size);
+            return recv(event->fd, buffer, size, 0);
+        }
+
+        errno = EAGAIN;
+        return -1;
+    }
+
+    ++event->recv_count;
+
+    uint8_t *dst = (uint8_t *)buffer;
+    size_t skip = 0;
+
+    while(event->recv_head != -1 && skip < size)
+    {
+        const int bid = event->recv_head;
+        uring_buffer_t *item = &event_observer.buffer_list[bid];
+        const uint8_t *data = &event_observer.buffer[(size_t)bid * URING_BUFFER_SIZE];
+
+        size_t len = item->size;
+        if(len > size - skip)
+            len = size - skip;
+        memcpy(&dst[skip], &data[item->offset], len);
+        skip += len;
+
+        if(event->recv_type == SOCK_DGRAM)
+        {
+            /* one datagram per call, the rest is truncated. returns the full
+             * length like recv() with MSG_TRUNC */
+            skip = item->size;
+            if(addr)
+            {
+                socklen_t name_size = item->name_size;
+                if(name_size > *addr_size)
+                    name_size = *addr_size;
+                memcpy(addr, &data[sizeof(struct io_uring_recvmsg_out)], name_size);
+                *addr_size = item->name_size;
+            }
+            uring_event_pop(event);
+            break;
+        }
+
+        item->offset += len;
+        item->size -= len;
+        if(item->size == 0)
+            uring_event_pop(event);
+    }
+
+    return skip;
+}
+
+asc_event_send_status_t *asc_event_send_status(void)
+{
+    asc_event_send_status_t *status =
+        (asc_event_send_status_t *)calloc(1, sizeof(asc_event_send_status_t));
+    status->refcount = 1;
+    return status;
+}
+
+void asc_event_send_release(asc_event_send_status_t *status)
+{
+    if(--status->refcount == 0)
+        free(status);
+}
+
+bool asc_event_send(  int fd, const struct iovec *iov, int iov_count
+                    , const struct sockaddr *addr, socklen_t addr_size
+                    , asc_event_send_status_t *status)
+{
+    /* worker threads send directly */
+    if(!pthread_equal(pthread_self(), event_observer.thread))
+        return false;
+
+    uring_send_t *send = event_observer.send_free;
+    size_t size = 0;
+    for(int i = 0; i < iov_count; ++i)
+        size += iov[i].iov_len;
+
+    if(!send || size > URING_SEND_SIZE || addr_size > sizeof(send->addr))
+    {
+        /* keep order with the queued datagrams */
+        uring_submit();
+        return false;
+    }
+
+    event_observer.send_free = send->next;
+    send->next = NULL;
+    send->status = status;
+    ++status->refcount;
+
+    size_t skip = 0;
+    for(int i = 0; i < iov_count; ++i)
+    {
+        memcpy(&send->buffer[skip], iov[i].iov_base, iov[i].iov_len);
+        skip += iov[i].iov_len;
+    }
+
+    send->iov.iov_base = send->buffer;
+    send->iov.iov_len = size;
+    memset(&send->msg, 0, sizeof(send->msg));
+    send->msg.msg_iov = &send->iov;
+    send->msg.msg_iovlen = 1;
+    if(addr)
+    {
+        memcpy(&send->addr, addr, addr_size);
+        send->msg.msg_name = &send->addr;
+        send->msg.msg_namelen = addr_size;
+    }
+
+    struct io_uring_sqe *sqe = uring_sqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)&send->msg;
+    sqe->len = 1;
+    sqe->user_data = URING_UD(send, URING_OP_SEND);
+
+    if(++event_observer.send_pending >= URING_SEND_BATCH)
+        uring_submit();
+
+    return true;
+}
+
+void asc_event_core_flush(void)
+{
+    if(event_observer.sq_pending > 0)
+        uring_submit();
+}
+
 #elif defined(EV_TYPE_POLL)
 
 /*
@@ -311,7 +1468,7 @@ typedef struct
     bool is_changed;
     int fd_count;
 
-    struct pollfd fd_list[EV_LIST_SIZE];
+    struct pollfd fd_list[EV_LIST_SIZE + 1]; /* last item is a wake fd */
 } event_observer_t;
 
 #define ED_SIZE (int)(sizeof(struct pollfd))
@@ -321,10 +1478,13 @@ static event_observer_t event_observer;
 void asc_event_core_init(void)
 {
     memset(&event_observer, 0, sizeof(event_observer));
+    asc_event_wake_open();
 }
 
 void asc_event_core_destroy(void)
 {
+    asc_event_wake_close();
+
     while(event_observer.fd_count > 0)
     {
         const int next_fd_count = event_observer.fd_count - 1;
@@ -339,18 +1499,31 @@ void asc_event_core_destroy(void)
     }
 }
 
-void asc_event_core_loop(void)
+void asc_event_core_loop(unsigned int timeout)
 {
-    if(!event_observer.fd_count)
-        return;
+    if(timeout > 0)
+        ++main_loop_stat.wait_count;
+
+    struct pollfd *wake_ed = &event_observer.fd_list[event_observer.fd_count];
+    wake_ed->fd = wake_fd[0];
+    wake_ed->events = POLLIN;
+    wake_ed->revents = 0;
 
-    int ret = poll(event_observer.fd_list, event_observer.fd_count, 10);
+    const uint64_t wait_begin = asc_utime();
+    int ret = poll(event_observer.fd_list, event_observer.fd_count + 1, (int)timeout);
+    main_loop_stat.wait_time = asc_utime() - wait_begin;
     if(ret == -1)
     {
         asc_assert(errno == EINTR, MSG("event observer critical error [%s]"), strerror(errno));
         return;
     }
 
+    if(wake_ed->revents)
+    {
+        asc_event_wake_drain();
+        --ret;
+    }
+
     event_observer.is_changed = false;
     for(int i = 0; i < event_observer.fd_count && ret > 0; ++i)
     {
@@ -363,21 +1536,21 @@ void asc_event_core_loop(void)
         if(event->on_read && (revents & POLLIN))
         {
             is_main_loop_idle = false;
-            event->on_read(event->arg);
+            asc_event_call(event->on_read, event->arg);
             if(event_observer.is_changed)
                 break;
         }
         if(event->on_error && (revents & (POLLERR | POLLHUP | POLLNVAL)))
         {
             is_main_loop_idle = false;
-            event->on_error(event->arg);
+            asc_event_call(event->on_error, event->arg);
             if(event_observer.is_changed)
                 break;
         }
         if(event->on_write && (revents & POLLOUT))
         {
             is_main_loop_idle = false;
-            event->on_write(event->arg);
+            asc_event_call(event->on_write, event->arg);
             if(event_observer.is_changed)
                 break;
         }
@@ -474,10 +1647,20 @@ void asc_event_core_init(void)
 {
     memset(&event_observer, 0, sizeof(event_observer));
     event_observer.event_list = asc_list_init();
+
+#ifdef EV_WAKE
+    asc_event_wake_open();
+    FD_SET(wake_fd[0], &event_observer.rmaster);
+    event_observer.max_fd = wake_fd[0];
+#endif
 }
 
 void asc_event_core_destroy(void)
 {
+#ifdef EV_WAKE
+    asc_event_wake_close();
+#endif
+
     asc_event_t *prev_event = NULL;
     for(asc_list_first(event_observer.event_list)
         ; !asc_list_eol(event_observer.event_list)
@@ -496,10 +1679,27 @@ void asc_event_core_destroy(void)
     event_observer.event_list = NULL;
 }
 
-void asc_event_core_loop(void)
+void asc_event_core_loop(unsigned int timeout)
 {
+#ifndef EV_WAKE
+    /* worker threads are not able to wake select(), keep the old 1ms polling */
+    if(timeout > 1)
+        timeout = 1;
+
     if(!asc_list_size(event_observer.event_list))
+    {
+        main_loop_stat.wait_time = 0;
+        if(timeout > 0)
+        {
+            asc_usleep(timeout * 1000);
+            main_loop_stat.wait_time = timeout * 1000;
+        }
         return;
+    }
+#endif
+
+    if(timeout > 0)
+        ++main_loop_stat.wait_count;
 
     fd_set rset;
     fd_set wset;
@@ -508,8 +1708,12 @@ void asc_event_core_loop(void)
     memcpy(&wset, &event_observer.wmaster, sizeof(wset));
     memcpy(&eset, &event_observer.emaster, sizeof(eset));
 
-    static struct timeval timeout = { .tv_sec = 0, .tv_usec = 0 };
-    const int ret = select(event_observer.max_fd + 1, &rset, &wset, &eset, &timeout);
+    struct timeval tv;
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    const uint64_t wait_begin = asc_utime();
+    const int ret = select(event_observer.max_fd + 1, &rset, &wset, &eset, &tv);
+    main_loop_stat.wait_time = asc_utime() - wait_begin;
     if(ret == -1)
     {
 #ifdef _WIN32
@@ -522,6 +1726,11 @@ void asc_event_core_loop(void)
     }
     else if(ret > 0)
     {
+#ifdef EV_WAKE
+        if(FD_ISSET(wake_fd[0], &rset))
+            asc_event_wake_drain();
+#endif
+
         event_observer.is_changed = false;
         asc_list_for(event_observer.event_list)
         {
@@ -529,21 +1738,21 @@ void asc_event_core_loop(void)
             if(event->on_read && FD_ISSET(event->fd, &rset))
             {
                 is_main_loop_idle = false;
-                event->on_read(event->arg);
+                asc_event_call(event->on_read, event->arg);
                 if(event_observer.is_changed)
                     break;
             }
             if(event->on_error && FD_ISSET(event->fd, &eset))
             {
                 is_main_loop_idle = false;
-                event->on_error(event->arg);
+                asc_event_call(event->on_error, event->arg);
                 if(event_observer.is_changed)
                     break;
             }
             if(event->on_write && FD_ISSET(event->fd, &wset))
             {
                 is_main_loop_idle = false;
-                event->on_write(event->arg);
+                asc_event_call(event->on_write, event->arg);
                 if(event_observer.is_changed)
                     break;
             }
@@ -603,7 +1812,11 @@ void asc_event_close(asc_event_t *event)
         return;
     }
 
+#ifdef EV_WAKE
+    event_observer.max_fd = wake_fd[0];
+#else
     event_observer.max_fd = 0;
+#endif
     for(asc_list_first(event_observer.event_list)
         ; !asc_list_eol(event_observer.event_list)
         ; )
@@ -23,12 +23,18 @@
 
 #include "base.h"
 
+#ifdef WITH_IO_URING
+#   include <sys/socket.h>
+#   include <sys/uio.h>
+#endif
+
 typedef struct asc_event_t asc_event_t;
 typedef void (*event_callback_t)(void *);
 
 void asc_event_core_init(void);
-void asc_event_core_loop(void);
+void asc_event_core_loop(unsigned int timeout);
 void asc_event_core_destroy(void);
+void asc_event_core_wake(void);
 
 asc_event_t * asc_event_init(int fd, void *arg) __wur;
 void asc_event_set_on_read(asc_event_t *event, event_callback_t on_read);
@@ -37,4 +43,37 @@ void asc_event_set_on_error(asc_event_t *event, event_callback_t on_error);
 
 void asc_event_close(asc_event_t *event);
 
+#ifdef WITH_IO_URING
+/*
+ * Socket data is received by the io_uring into the shared buffers and queued
+ * in the event. sock_type - SOCK_STREAM or SOCK_DGRAM, 0 - poll for readiness.
+ * asc_event_recv() returns the datagram length even if it is greater than size
+ */
+void asc_event_set_recv(asc_event_t *event, int sock_type);
+ssize_t asc_event_recv(  asc_event_t *event, void *buffer, size_t size
+                       , struct sockaddr *addr, socklen_t *addr_size) __wur;
+
+/*
+ * Result of the queued datagrams. Shared by the owner and the datagrams
+ * in flight, released with asc_event_send_release()
+ */
+typedef struct
+{
+    int refcount;
+    int error; /* errno of the last failed datagram, 0 - none */
+} asc_event_send_status_t;
+
+asc_event_send_status_t *asc_event_send_status(void);
+void asc_event_send_release(asc_event_send_status_t *status);
+
+/*
+ * queue datagram to send with the next submission, false if not queued.
+ * send error is stored in the status
+ */
+bool asc_event_send(  int fd, const struct iovec *iov, int iov_count
+                    , const struct sockaddr *addr, socklen_t addr_size
+                    , asc_event_send_status_t *status) __wur;
+void asc_event_core_flush(void);
+#endif
+
 #endif /* _ASC_EVENT_H_ */
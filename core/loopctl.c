@@ -20,10 +20,17 @@
  */
 
 #include "loopctl.h"
+#include "clock.h"
 #include "log.h"
 
 jmp_buf main_loop;
 bool is_main_loop_idle = true;
+asc_main_loop_stat_t main_loop_stat;
+
+uint64_t main_loop_watchdog = 0;
+
+static char main_loop_blame_name[128];
+static uint64_t main_loop_blame_time = 0;
 
 #ifdef WITH_LUA
 lua_State *lua = NULL;
@@ -68,3 +75,162 @@ void astra_reload(void)
 {
     longjmp(main_loop, 2);
 }
+
+/*
+ * oooo   oooo ooooo  oooooooo8 ooooooooooo
+ *  888    888  888  888        88  888  88
+ *  888oooo888  888   888oooooo     888
+ *  888    888  888          888    888
+ * o888o  o888o o888o o88oooo888   o888o
+ *
+ */
+
+static size_t asc_histogram_index(uint64_t value)
+{
+    if(value < ASC_HISTOGRAM_SUB * 2)
+        return value;
+
+    int msb = 63 - __builtin_clzll(value);
+    if(msb > ASC_HISTOGRAM_MSB_MAX)
+        return ASC_HISTOGRAM_SIZE - 1;
+
+    const int shift = msb - 3;
+    return ASC_HISTOGRAM_SUB * shift + (value >> shift);
+}
+
+/* upper bound of the bucket values */
+static uint64_t asc_histogram_value(size_t idx)
+{
+    if(idx < ASC_HISTOGRAM_SUB * 2)
+        return idx;
+
+    const int shift = idx / ASC_HISTOGRAM_SUB - 1;
+    const uint64_t sub = idx % ASC_HISTOGRAM_SUB + ASC_HISTOGRAM_SUB;
+    return ((sub + 1) << shift) - 1;
+}
+
+void asc_histogram_add(asc_histogram_t *histogram, uint64_t value)
+{
+    ++histogram->count;
+    histogram->total += value;
+    if(value > histogram->max)
+        histogram->max = value;
+    ++histogram->bucket[asc_histogram_index(value)];
+}
+
+uint64_t asc_histogram_percentile(const asc_histogram_t *histogram, double percentile)
+{
+    if(histogram->count == 0)
+        return 0;
+
+    uint64_t limit = (uint64_t)(histogram->count * percentile / 100.0 + 0.5);
+    if(limit == 0)
+        limit = 1;
+
+    uint64_t count = 0;
+    for(size_t i = 0; i < ASC_HISTOGRAM_SIZE; ++i)
+    {
+        count += histogram->bucket[i];
+        if(count >= limit)
+        {
+            const uint64_t value = asc_histogram_value(i);
+            return (value < histogram->max) ? value : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+void asc_histogram_reset(asc_histogram_t *histogram)
+{
+    memset(histogram, 0, sizeof(asc_histogram_t));
+}
+
+/* keep name of the slowest nested call (time in microseconds) */
+void asc_main_loop_blame(const char *name, uint64_t time)
+{
+    if(time <= main_loop_blame_time)
+        return;
+
+    main_loop_blame_time = time;
+    snprintf(main_loop_blame_name, sizeof(main_loop_blame_name), "%s", name);
+}
+
+void asc_main_loop_trace(  asc_histogram_t *histogram, uint64_t time_begin
+                         , const char *type, const char *name)
+{
+    const uint64_t time_end = asc_utime();
+    const uint64_t time = (time_end > time_begin) ? (time_end - time_begin) : 0;
+
+    asc_histogram_add(histogram, time);
+
+    if(name)
+    {
+        /* nested callback, reported by the outer one */
+        asc_main_loop_blame(name, time);
+        return;
+    }
+
+    if(main_loop_watchdog > 0 && time >= main_loop_watchdog)
+    {
+        asc_log_warning("[main] %s callback blocks the main loop for %llums [%s]"
+                        , type, (unsigned long long)(time / 1000)
+                        , (main_loop_blame_time > 0) ? main_loop_blame_name : "unknown");
+    }
+
+    main_loop_blame_time = 0;
+}
+
+typedef struct
+{
+    loop_callback_t callback;
+    void *arg;
+} loop_defer_t;
+
+static loop_defer_t *defer_list = NULL;
+static size_t defer_count = 0;
+static size_t defer_size = 0;
+
+void asc_main_loop_defer(loop_callback_t callback, void *arg)
+{
+    if(defer_count == defer_size)
+    {
+        defer_size = (defer_size > 0) ? (defer_size * 2) : 64;
+        defer_list = (loop_defer_t *)realloc(defer_list, defer_size * sizeof(loop_defer_t));
+    }
+
+    defer_list[defer_count].callback = callback;
+    defer_list[defer_count].arg = arg;
+    ++defer_count;
+}
+
+void asc_main_loop_defer_cancel(void *arg)
+{
+    for(size_t i = 0; i < defer_count; ++i)
+    {
+        if(defer_list[i].arg == arg)
+            defer_list[i].callback = NULL;
+    }
+}
+
+void asc_main_loop_run_deferred(void)
+{
+    /* callbacks deferred in this run are called on the next iteration */
+    const size_t count = defer_count;
+    if(count == 0)
+        return;
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        const loop_defer_t item = defer_list[i];
+        if(item.callback)
+        {
+            defer_list[i].callback = NULL;
+            item.callback(item.arg);
+        }
+    }
+
+    defer_count -= count;
+    if(defer_count > 0)
+        memmove(defer_list, &defer_list[count], defer_count * sizeof(loop_defer_t));
+}
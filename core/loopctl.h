@@ -24,8 +24,74 @@
 
 #include "base.h"
 
+/*
+ * Log-linear histogram of durations in microseconds.
+ * Values below 16 have own bucket, each next power of two
+ * is split to 8 buckets (relative error is 12.5%).
+ */
+
+#define ASC_HISTOGRAM_SUB 8
+#define ASC_HISTOGRAM_MSB_MAX 40
+#define ASC_HISTOGRAM_SIZE (ASC_HISTOGRAM_SUB * (ASC_HISTOGRAM_MSB_MAX - 1))
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t bucket[ASC_HISTOGRAM_SIZE];
+} asc_histogram_t;
+
+void asc_histogram_add(asc_histogram_t *histogram, uint64_t value);
+uint64_t asc_histogram_percentile(const asc_histogram_t *histogram, double percentile) __wur;
+void asc_histogram_reset(asc_histogram_t *histogram);
+
+typedef struct
+{
+    uint64_t loop_count;    /* main loop iterations */
+    uint64_t wait_count;    /* blocking waits in the event observer */
+    uint64_t wake_count;    /* wakes by asc_event_core_wake() */
+
+    uint64_t timer_count;   /* timer shots */
+    uint64_t timer_lag;     /* total delay of the timer shots in microseconds */
+    uint64_t timer_lag_max; /* max delay of the timer shot in microseconds */
+
+    uint64_t wait_time;     /* last blocking wait in the event observer, microseconds */
+
+    /* durations in microseconds */
+    asc_histogram_t loop_time;      /* main loop iteration without waiting */
+    asc_histogram_t event_time;     /* socket and event callbacks */
+    asc_histogram_t timer_time;     /* timer callbacks */
+    asc_histogram_t thread_time;    /* thread on_read and on_close callbacks */
+    asc_histogram_t lua_time;       /* Lua callbacks */
+} asc_main_loop_stat_t;
+
 extern jmp_buf main_loop;
 extern bool is_main_loop_idle;
+extern asc_main_loop_stat_t main_loop_stat;
+
+/*
+ * Watchdog. Callback longer than main_loop_watchdog (microseconds, 0 - disabled)
+ * is reported with the name of the slowest module in the callback.
+ */
+
+extern uint64_t main_loop_watchdog;
+
+void asc_main_loop_blame(const char *name, uint64_t time);
+void asc_main_loop_trace(  asc_histogram_t *histogram, uint64_t time_begin
+                         , const char *type, const char *name);
+
+/*
+ * Deferred callbacks are called once at the end of the main loop iteration,
+ * after events, timers and threads. For example to flush the batched output.
+ * Main thread only.
+ */
+
+typedef void (*loop_callback_t)(void *arg);
+
+void asc_main_loop_defer(loop_callback_t callback, void *arg);
+void asc_main_loop_defer_cancel(void *arg);
+void asc_main_loop_run_deferred(void);
 
 #ifdef WITH_LUA
 extern lua_State *lua;
@@ -37,8 +37,38 @@
 #       include <netinet/sctp.h>
 #   endif
 #   include <netdb.h>
+#   include <sys/ioctl.h>
+#   ifdef __linux__
+#       include <linux/errqueue.h>
+#   endif
+#endif
+
+#if defined(__linux__) && !defined(UDP_SEGMENT)
+#   define UDP_SEGMENT 103
+#endif
+
+#if defined(__linux__) && !defined(SO_TXTIME)
+#   define SO_TXTIME 61
+#   define SCM_TXTIME SO_TXTIME
+#endif
+
+#if defined(__linux__) && !defined(SO_ZEROCOPY)
+#   define SO_ZEROCOPY 60
+#endif
+
+#if defined(__linux__) && !defined(MSG_ZEROCOPY)
+#   define MSG_ZEROCOPY 0x4000000
+#endif
+
+#if defined(__linux__) && !defined(SO_EE_ORIGIN_ZEROCOPY)
+#   define SO_EE_ORIGIN_ZEROCOPY 5
+#   define SO_EE_CODE_ZEROCOPY_COPIED 1
 #endif
 
+/* UDP GSO limits: segments per call and total payload size */
+#define UDP_GSO_COUNT 64
+#define UDP_GSO_SIZE 65000
+
 #ifdef IGMP_EMULATION
 #   define IP_HEADER_SIZE 24
 #   define IGMP_HEADER_SIZE 8
@@ -60,6 +90,18 @@ struct asc_socket_t
 
     struct ip_mreq mreq;
 
+#ifdef WITH_IO_URING
+    asc_event_send_status_t *send_status; /* queued datagrams */
+#endif
+
+    bool is_gso;
+    bool is_txtime;
+    bool is_pktinfo;
+
+    bool is_zerocopy;
+    uint32_t zerocopy_sent; /* MSG_ZEROCOPY sends */
+    uint32_t zerocopy_done; /* sends completed by the kernel */
+
     /* Callbacks */
     void *arg;
     event_callback_t on_read;      /* data read */
@@ -195,6 +237,15 @@ void asc_socket_close(asc_socket_t *sock)
     if(sock->event)
         asc_event_close(sock->event);
 
+#ifdef WITH_IO_URING
+    /* queued datagrams refer to the descriptor */
+    if(sock->send_status)
+    {
+        asc_event_core_flush();
+        asc_event_send_release(sock->send_status);
+    }
+#endif
+
     if(sock->fd > 0)
     {
 #ifdef _WIN32
@@ -216,9 +267,18 @@ void asc_socket_close(asc_socket_t *sock)
  *
  */
 
+#ifdef SO_ZEROCOPY
+static bool __asc_socket_zerocopy_read(asc_socket_t *sock);
+#endif
+
 static void __asc_socket_on_close(void *arg)
 {
     asc_socket_t *sock = (asc_socket_t *)arg;
+#ifdef SO_ZEROCOPY
+    /* completion notifications of MSG_ZEROCOPY are reported as error */
+    if(sock->zerocopy_sent != sock->zerocopy_done && __asc_socket_zerocopy_read(sock))
+        return;
+#endif
     if(sock->on_close)
         sock->on_close(sock->arg);
 }
@@ -262,15 +322,24 @@ static bool __asc_socket_check_event(asc_socket_t *sock)
     if(sock->event == NULL)
     {
         if(is_callback == true)
+        {
             sock->event = asc_event_init(sock->fd, sock);
+#ifdef WITH_IO_URING
+            /* control messages are not queued. datagrams are read directly */
+            asc_event_set_recv(sock->event, (sock->is_pktinfo) ? 0 : sock->type);
+#endif
+        }
     }
     else
     {
+#ifndef WITH_IO_URING
+        /* with io_uring the event is kept, received data is queued in it */
         if(is_callback == false)
         {
             asc_event_close(sock->event);
             sock->event = NULL;
         }
+#endif
     }
 
     return (sock->event != NULL);
@@ -385,6 +454,9 @@ void asc_socket_listen(  asc_socket_t *sock
     if(sock->event == NULL)
         sock->event = asc_event_init(sock->fd, sock);
 
+#ifdef WITH_IO_URING
+    asc_event_set_recv(sock->event, 0);
+#endif
     asc_event_set_on_read(sock->event, __asc_socket_on_accept);
     asc_event_set_on_write(sock->event, NULL);
     asc_event_set_on_error(sock->event, __asc_socket_on_close);
@@ -412,6 +484,9 @@ bool asc_socket_accept(asc_socket_t *sock, asc_socket_t **client_ptr, void * arg
         return false;
     }
 
+    client->family = sock->family;
+    client->type = sock->type;
+    client->protocol = sock->protocol;
     client->arg = arg;
     asc_socket_set_nonblock(client, true);
 
@@ -495,7 +570,12 @@ void asc_socket_connect(  asc_socket_t *sock, const char *addr, int port
     sock->on_ready = on_connect;
     sock->on_close = on_error;
     if(sock->event == NULL)
+    {
         sock->event = asc_event_init(sock->fd, sock);
+#ifdef WITH_IO_URING
+        asc_event_set_recv(sock->event, sock->type);
+#endif
+    }
 
     asc_event_set_on_read(sock->event, NULL);
     asc_event_set_on_write(sock->event, __asc_socket_on_connect);
@@ -513,15 +593,170 @@ void asc_socket_connect(  asc_socket_t *sock, const char *addr, int port
 
 ssize_t asc_socket_recv(asc_socket_t *sock, void *buffer, size_t size)
 {
+#ifdef WITH_IO_URING
+    if(sock->event)
+    {
+        const ssize_t len = asc_event_recv(sock->event, buffer, size, NULL, NULL);
+        return ((size_t)len > size && len > 0) ? (ssize_t)size : len;
+    }
+#endif
     return recv(sock->fd, buffer, size, 0);
 }
 
 ssize_t asc_socket_recvfrom(asc_socket_t *sock, void *buffer, size_t size)
 {
     socklen_t slen = sizeof(struct sockaddr_in);
+#ifdef WITH_IO_URING
+    if(sock->event)
+    {
+        const ssize_t len = asc_event_recv(  sock->event, buffer, size
+                                           , (struct sockaddr *)&sock->sockaddr, &slen);
+        return ((size_t)len > size && len > 0) ? (ssize_t)size : len;
+    }
+#endif
     return recvfrom(sock->fd, buffer, size, 0, (struct sockaddr *)&sock->sockaddr, &slen);
 }
 
+/*
+ * receives up to count datagrams, each one into the buffer with the size step.
+ * len_list - datagram lengths. greater than size if datagram is truncated
+ * (if supported by the system). returns number of datagrams
+ */
+int asc_socket_recv_batch(  asc_socket_t *sock, void *buffer, size_t size
+                          , size_t *len_list, int count)
+{
+    uint8_t *ptr = (uint8_t *)buffer;
+
+#ifdef WITH_IO_URING
+    if(sock->event)
+    {
+        int i = 0;
+        for(; i < count; ++i)
+        {
+            const ssize_t len = asc_event_recv(sock->event, &ptr[i * size], size, NULL, NULL);
+            if(len < 0)
+                break;
+            len_list[i] = len;
+        }
+        return (i > 0) ? i : -1;
+    }
+#endif
+
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr msg_list[count];
+    struct iovec iov_list[count];
+    memset(msg_list, 0, sizeof(msg_list));
+    for(int i = 0; i < count; ++i)
+    {
+        iov_list[i].iov_base = &ptr[i * size];
+        iov_list[i].iov_len = size;
+        msg_list[i].msg_hdr.msg_iov = &iov_list[i];
+        msg_list[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    const int ret = recvmmsg(sock->fd, msg_list, count, MSG_DONTWAIT | MSG_TRUNC, NULL);
+    for(int i = 0; i < ret; ++i)
+        len_list[i] = msg_list[i].msg_len;
+    return ret;
+#else
+#   if defined(MSG_TRUNC) && defined(__linux__)
+    const int flags = MSG_TRUNC;
+#   else
+    const int flags = 0;
+#   endif
+
+    int i = 0;
+    for(; i < count; ++i)
+    {
+        const ssize_t len = recv(sock->fd, (char *)&ptr[i * size], size, flags);
+        if(len < 0)
+            break;
+        len_list[i] = len;
+    }
+    return (i > 0) ? i : -1;
+#endif
+}
+
+/*
+ * same as asc_socket_recv_batch(). dst_list - destination address of each datagram
+ * in the network byte order, INADDR_NONE if unknown. see asc_socket_set_pktinfo()
+ */
+int asc_socket_recv_batch_dst(  asc_socket_t *sock, void *buffer, size_t size
+                              , size_t *len_list, uint32_t *dst_list, int count)
+{
+#ifdef IP_PKTINFO
+    uint8_t *ptr = (uint8_t *)buffer;
+    uint8_t control[count][CMSG_SPACE(sizeof(struct in_pktinfo))];
+
+#   ifdef HAVE_RECVMMSG
+    struct mmsghdr msg_list[count];
+    struct iovec iov_list[count];
+    memset(msg_list, 0, sizeof(msg_list));
+    for(int i = 0; i < count; ++i)
+    {
+        iov_list[i].iov_base = &ptr[i * size];
+        iov_list[i].iov_len = size;
+        msg_list[i].msg_hdr.msg_iov = &iov_list[i];
+        msg_list[i].msg_hdr.msg_iovlen = 1;
+        msg_list[i].msg_hdr.msg_control = control[i];
+        msg_list[i].msg_hdr.msg_controllen = sizeof(control[i]);
+    }
+
+    const int ret = recvmmsg(sock->fd, msg_list, count, MSG_DONTWAIT | MSG_TRUNC, NULL);
+    for(int i = 0; i < ret; ++i)
+    {
+        struct msghdr *msg = &msg_list[i].msg_hdr;
+        len_list[i] = msg_list[i].msg_len;
+#   else
+    int ret = 0;
+    for(; ret < count; ++ret)
+    {
+        struct iovec iov;
+        iov.iov_base = &ptr[ret * size];
+        iov.iov_len = size;
+
+        struct msghdr msg_item;
+        memset(&msg_item, 0, sizeof(msg_item));
+        msg_item.msg_iov = &iov;
+        msg_item.msg_iovlen = 1;
+        msg_item.msg_control = control[ret];
+        msg_item.msg_controllen = sizeof(control[ret]);
+
+        const ssize_t len = recvmsg(sock->fd, &msg_item, MSG_DONTWAIT | MSG_TRUNC);
+        if(len < 0)
+            break;
+
+        struct msghdr *msg = &msg_item;
+        const int i = ret;
+        len_list[i] = len;
+#   endif
+
+        dst_list[i] = INADDR_NONE;
+        for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg))
+        {
+            if(cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO)
+            {
+                struct in_pktinfo pktinfo;
+                memcpy(&pktinfo, CMSG_DATA(cmsg), sizeof(pktinfo));
+                dst_list[i] = pktinfo.ipi_addr.s_addr;
+                break;
+            }
+        }
+    }
+
+#   ifdef HAVE_RECVMMSG
+    return ret;
+#   else
+    return (ret > 0) ? ret : -1;
+#   endif
+#else
+    const int ret = asc_socket_recv_batch(sock, buffer, size, len_list, count);
+    for(int i = 0; i < ret; ++i)
+        dst_list[i] = INADDR_NONE;
+    return ret;
+#endif
+}
+
 /*
  *  oooooooo8 ooooooooooo oooo   oooo ooooooooo
  * 888         888    88   8888o  88   888    88o
@@ -548,12 +783,401 @@ ssize_t asc_socket_send(asc_socket_t *sock, const void *buffer, size_t size)
     return ret;
 }
 
+#ifdef WITH_IO_URING
+/*
+ * queues datagram to the io_uring. the error of the sent datagrams is
+ * returned by the next call, as the ICMP errors of the unconnected socket.
+ * 0 - not queued, send directly
+ */
+static ssize_t socket_send_queue(  asc_socket_t *sock
+                                 , const struct iovec *iov, int iov_count)
+{
+    if(sock->type != SOCK_DGRAM)
+        return 0;
+
+    if(!sock->send_status)
+        sock->send_status = asc_event_send_status();
+    else if(sock->send_status->error)
+    {
+        errno = sock->send_status->error;
+        sock->send_status->error = 0;
+        return -1;
+    }
+
+    if(!asc_event_send(  sock->fd, iov, iov_count
+                       , (struct sockaddr *)&sock->sockaddr, sizeof(struct sockaddr_in)
+                       , sock->send_status))
+    {
+        return 0;
+    }
+
+    ssize_t size = 0;
+    for(int i = 0; i < iov_count; ++i)
+        size += iov[i].iov_len;
+    return size;
+}
+#endif
+
 ssize_t asc_socket_sendto(asc_socket_t *sock, const void *buffer, size_t size)
 {
     const socklen_t slen = sizeof(struct sockaddr_in);
+#ifdef WITH_IO_URING
+    struct iovec iov;
+    iov.iov_base = (void *)buffer;
+    iov.iov_len = size;
+    const ssize_t ret = socket_send_queue(sock, &iov, 1);
+    if(ret != 0)
+        return ret;
+#endif
     return sendto(sock->fd, buffer, size, 0, (struct sockaddr *)&sock->sockaddr, slen);
 }
 
+/* sends one datagram gathered from iov */
+ssize_t asc_socket_sendtov(asc_socket_t *sock, const struct iovec *iov, int iov_count)
+{
+#ifdef _WIN32
+    uint8_t buffer[65536];
+    size_t size = 0;
+    for(int i = 0; i < iov_count; ++i)
+    {
+        if(size + iov[i].iov_len > sizeof(buffer))
+            return -1;
+        memcpy(&buffer[size], iov[i].iov_base, iov[i].iov_len);
+        size += iov[i].iov_len;
+    }
+    return asc_socket_sendto(sock, buffer, size);
+#else
+#   ifdef WITH_IO_URING
+    const ssize_t ret = socket_send_queue(sock, iov, iov_count);
+    if(ret != 0)
+        return ret;
+#   endif
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &sock->sockaddr;
+    msg.msg_namelen = sizeof(struct sockaddr_in);
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = iov_count;
+    return sendmsg(sock->fd, &msg, 0);
+#endif
+}
+
+/*
+ * stream socket. returns number of bytes sent or 0 if the socket buffer is full
+ */
+ssize_t asc_socket_sendv(asc_socket_t *sock, const struct iovec *iov, int iov_count)
+{
+#ifdef _WIN32
+    /* partial send is allowed for the stream */
+    __uarg(iov_count);
+    return asc_socket_send(sock, iov[0].iov_base, iov[0].iov_len);
+#else
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = iov_count;
+
+    const ssize_t ret = sendmsg(sock->fd, &msg, 0);
+    if(ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+    return ret;
+#endif
+}
+
+/*
+ * same as asc_socket_sendv but with MSG_ZEROCOPY if enabled on the socket
+ * (see asc_socket_set_zerocopy). Kernel sends data from the user memory, data
+ * should not be changed until the send is completed. Sends are numbered by
+ * asc_socket_zerocopy_sent(), completed sends - asc_socket_zerocopy_done()
+ */
+ssize_t asc_socket_sendv_zerocopy(asc_socket_t *sock, const struct iovec *iov, int iov_count)
+{
+#ifdef SO_ZEROCOPY
+    if(sock->is_zerocopy)
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (struct iovec *)iov;
+        msg.msg_iovlen = iov_count;
+
+        const ssize_t ret = sendmsg(sock->fd, &msg, MSG_ZEROCOPY);
+        if(ret > 0)
+        {
+            ++sock->zerocopy_sent;
+            return ret;
+        }
+        if(ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        /* ENOBUFS - too many pending notifications (optmem_max). data is copied */
+        if(ret == -1 && errno != ENOBUFS)
+            return ret;
+    }
+#endif
+    return asc_socket_sendv(sock, iov, iov_count);
+}
+
+#ifdef SO_ZEROCOPY
+/* reads completion notifications. returns false if nothing was read */
+static bool __asc_socket_zerocopy_read(asc_socket_t *sock)
+{
+    bool is_read = false;
+
+    while(1)
+    {
+        uint8_t control[CMSG_SPACE(sizeof(struct sock_extended_err)
+                                   + sizeof(struct sockaddr_in))];
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if(recvmsg(sock->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1)
+            break;
+
+        for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg)
+            ; cmsg
+            ; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if(cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR)
+                continue;
+
+            const struct sock_extended_err *ee =
+                (const struct sock_extended_err *)CMSG_DATA(cmsg);
+            if(ee->ee_errno != 0 || ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+
+            /* ee_info..ee_data - range of the completed sends. TCP completes in order */
+            const uint32_t done = ee->ee_data + 1;
+            if((int32_t)(done - sock->zerocopy_done) > 0)
+                sock->zerocopy_done = done;
+
+            if(sock->is_zerocopy && (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED))
+            {
+                /* deferred copy is more expensive than the regular send */
+                asc_log_debug(MSG("data is copied by the kernel. MSG_ZEROCOPY is disabled"));
+                sock->is_zerocopy = false;
+            }
+
+            is_read = true;
+        }
+    }
+
+    return is_read;
+}
+#endif
+
+uint32_t asc_socket_zerocopy_sent(asc_socket_t *sock)
+{
+    return sock->zerocopy_sent;
+}
+
+uint32_t asc_socket_zerocopy_done(asc_socket_t *sock)
+{
+#ifdef SO_ZEROCOPY
+    if(sock->zerocopy_sent != sock->zerocopy_done)
+        __asc_socket_zerocopy_read(sock);
+#endif
+    return sock->zerocopy_done;
+}
+
+#ifdef SO_TXTIME
+static int __asc_socket_sendto_txtime(  asc_socket_t *sock
+                                      , const asc_socket_datagram_t *list, int count)
+{
+    uint8_t control[CMSG_SPACE(sizeof(uint64_t))];
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &sock->sockaddr;
+    msg.msg_namelen = sizeof(struct sockaddr_in);
+
+    int i = 0;
+    for(; i < count; ++i)
+    {
+        msg.msg_iov = list[i].iov;
+        msg.msg_iovlen = list[i].iov_count;
+
+        if(list[i].txtime > 0)
+        {
+            memset(control, 0, sizeof(control));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_TXTIME;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+            memcpy(CMSG_DATA(cmsg), &list[i].txtime, sizeof(uint64_t));
+        }
+        else
+        {
+            msg.msg_control = NULL;
+            msg.msg_controllen = 0;
+        }
+
+        if(sendmsg(sock->fd, &msg, 0) == -1)
+            break;
+    }
+
+    return (i > 0) ? i : -1;
+}
+#endif /* SO_TXTIME */
+
+#ifdef UDP_SEGMENT
+static size_t __asc_socket_datagram_size(const asc_socket_datagram_t *datagram)
+{
+    size_t size = 0;
+    for(int i = 0; i < datagram->iov_count; ++i)
+        size += datagram->iov[i].iov_len;
+    return size;
+}
+
+/*
+ * sends datagrams with the same size as one UDP GSO super-buffer.
+ * only the last datagram of the call could be smaller.
+ * returns number of datagrams sent or -1
+ */
+static int __asc_socket_sendto_gso(  asc_socket_t *sock
+                                   , const asc_socket_datagram_t *list, int count)
+{
+    const size_t segment_size = __asc_socket_datagram_size(&list[0]);
+
+    int iov_count = 0;
+    size_t size = 0;
+    int i = 0;
+    for(; i < count && i < UDP_GSO_COUNT; ++i)
+    {
+        const size_t datagram_size = (i == 0)
+                                   ? segment_size
+                                   : __asc_socket_datagram_size(&list[i]);
+        if(datagram_size > segment_size || size + datagram_size > UDP_GSO_SIZE)
+            break;
+
+        iov_count += list[i].iov_count;
+        size += datagram_size;
+
+        if(datagram_size < segment_size)
+        {
+            ++i;
+            break;
+        }
+    }
+
+    if(i == 1)
+        return (asc_socket_sendtov(sock, list[0].iov, list[0].iov_count) != -1) ? 1 : -1;
+
+    struct iovec iov[iov_count];
+    iov_count = 0;
+    for(int j = 0; j < i; ++j)
+    {
+        memcpy(&iov[iov_count], list[j].iov, list[j].iov_count * sizeof(struct iovec));
+        iov_count += list[j].iov_count;
+    }
+
+    uint8_t control[CMSG_SPACE(sizeof(uint16_t))];
+    memset(control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &sock->sockaddr;
+    msg.msg_namelen = sizeof(struct sockaddr_in);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_count;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    const uint16_t gso_size = segment_size;
+    memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+
+    if(sendmsg(sock->fd, &msg, 0) == -1)
+    {
+        if(errno == EIO || errno == EINVAL)
+        {
+            /* device or route without segmentation support */
+            asc_log_warning(MSG("UDP GSO is not supported. disabled [%s]"), asc_socket_error());
+            sock->is_gso = false;
+            return 0;
+        }
+        return -1;
+    }
+
+    return i;
+}
+#endif /* UDP_SEGMENT */
+
+/*
+ * sends a list of datagrams to the address defined with asc_socket_set_sockaddr().
+ * uses SO_TXTIME, UDP GSO (see asc_socket_set_gso) or sendmmsg if available.
+ * returns number of datagrams sent or -1 if nothing was sent
+ */
+int asc_socket_sendto_batch(  asc_socket_t *sock
+                            , const asc_socket_datagram_t *list, int count)
+{
+    int sent = 0;
+
+#ifdef SO_TXTIME
+    if(sock->is_txtime)
+        return __asc_socket_sendto_txtime(sock, list, count);
+#endif
+
+#ifdef WITH_IO_URING
+    if(sock->event && sock->type == SOCK_DGRAM)
+    {
+        /* already batched by the io_uring submission queue */
+        for(; sent < count; ++sent)
+        {
+            if(asc_socket_sendtov(sock, list[sent].iov, list[sent].iov_count) == -1)
+                break;
+        }
+        return (sent > 0) ? sent : -1;
+    }
+#endif
+
+#ifdef UDP_SEGMENT
+    while(sock->is_gso && sent < count)
+    {
+        const int ret = __asc_socket_sendto_gso(sock, &list[sent], count - sent);
+        if(ret == -1)
+            return (sent > 0) ? sent : -1;
+        sent += ret;
+    }
+#endif
+
+#ifdef HAVE_SENDMMSG
+    while(sent < count)
+    {
+        const int batch = count - sent;
+        struct mmsghdr msg_list[batch];
+        memset(msg_list, 0, sizeof(msg_list));
+        for(int i = 0; i < batch; ++i)
+        {
+            msg_list[i].msg_hdr.msg_name = &sock->sockaddr;
+            msg_list[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            msg_list[i].msg_hdr.msg_iov = list[sent + i].iov;
+            msg_list[i].msg_hdr.msg_iovlen = list[sent + i].iov_count;
+        }
+
+        const int ret = sendmmsg(sock->fd, msg_list, batch, 0);
+        if(ret <= 0)
+            break;
+        sent += ret;
+    }
+#else
+    for(; sent < count; ++sent)
+    {
+        if(asc_socket_sendtov(sock, list[sent].iov, list[sent].iov_count) == -1)
+            break;
+    }
+#endif
+
+    return (sent > 0) ? sent : -1;
+}
+
 /*
  * ooooo oooo   oooo ooooooooooo  ooooooo
  *  888   8888o  88   888    88 o888   888o
@@ -635,6 +1259,19 @@ void asc_socket_set_reuseaddr(asc_socket_t *sock, int is_on)
     setsockopt(sock->fd, SOL_SOCKET, SO_REUSEADDR, (void *)&is_on, sizeof(is_on));
 }
 
+void asc_socket_set_reuseport(asc_socket_t *sock, int is_on)
+{
+#ifdef SO_REUSEPORT
+    if(setsockopt(sock->fd, SOL_SOCKET, SO_REUSEPORT, (void *)&is_on, sizeof(is_on)) == -1)
+    {
+        asc_log_error(MSG("failed to set SO_REUSEPORT [%s]"), asc_socket_error());
+    }
+#else
+    __uarg(is_on);
+    asc_log_error(MSG("SO_REUSEPORT is not available"));
+#endif
+}
+
 void asc_socket_set_non_delay(asc_socket_t *sock, int is_on)
 {
     switch(sock->protocol)
@@ -727,6 +1364,143 @@ void asc_socket_set_buffer(asc_socket_t *sock, int rcvbuf, int sndbuf)
 #endif
 }
 
+/* UDP segmentation offload for asc_socket_sendto_batch(). returns false if not supported */
+bool asc_socket_set_gso(asc_socket_t *sock, bool is_on)
+{
+    sock->is_gso = false;
+#ifdef UDP_SEGMENT
+    if(!is_on || sock->type != SOCK_DGRAM)
+        return false;
+
+    /* probe only. segment size is defined for each call */
+    int val = 0;
+    if(setsockopt(sock->fd, IPPROTO_UDP, UDP_SEGMENT, (void *)&val, sizeof(val)) == -1)
+        return false;
+
+    sock->is_gso = true;
+#else
+    __uarg(is_on);
+#endif
+    return sock->is_gso;
+}
+
+/*
+ * destination address of the received datagrams, e.g. multicast group
+ * if the socket joins many groups. returns false if not supported
+ */
+bool asc_socket_set_pktinfo(asc_socket_t *sock, bool is_on)
+{
+    sock->is_pktinfo = false;
+#ifdef IP_PKTINFO
+    const int val = (is_on) ? 1 : 0;
+    if(setsockopt(sock->fd, IPPROTO_IP, IP_PKTINFO, (void *)&val, sizeof(val)) == -1)
+    {
+        asc_log_error(MSG("failed to set IP_PKTINFO [%s]"), asc_socket_error());
+        return false;
+    }
+
+    sock->is_pktinfo = is_on;
+#   ifdef WITH_IO_URING
+    if(sock->event)
+        asc_event_set_recv(sock->event, (is_on) ? 0 : sock->type);
+#   endif
+#else
+    __uarg(is_on);
+#endif
+    return sock->is_pktinfo;
+}
+
+/*
+ * departure time for each datagram of asc_socket_sendto_batch().
+ * datagrams are paced by the fq (or etf) qdisc on the output interface.
+ * returns false if not supported
+ */
+bool asc_socket_set_txtime(asc_socket_t *sock, bool is_on)
+{
+    sock->is_txtime = false;
+#ifdef SO_TXTIME
+    if(!is_on || sock->type != SOCK_DGRAM)
+        return false;
+
+    struct
+    {
+        clockid_t clockid;
+        uint32_t flags;
+    } txtime = { CLOCK_MONOTONIC, 0 };
+
+    if(setsockopt(sock->fd, SOL_SOCKET, SO_TXTIME, (void *)&txtime, sizeof(txtime)) == -1)
+    {
+        asc_log_error(MSG("failed to set SO_TXTIME [%s]"), asc_socket_error());
+        return false;
+    }
+
+    sock->is_txtime = true;
+#else
+    __uarg(is_on);
+#endif
+    return sock->is_txtime;
+}
+
+/*
+ * kernel receive time of the last datagram in microseconds (CLOCK_REALTIME).
+ * first call enables the timestamping on the socket and returns 0.
+ * returns 0 if not supported
+ */
+uint64_t asc_socket_recv_time(asc_socket_t *sock)
+{
+#ifdef SIOCGSTAMPNS
+    struct timespec ts;
+    if(ioctl(sock->fd, SIOCGSTAMPNS, &ts) == 0)
+        return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    __uarg(sock);
+#endif
+    return 0;
+}
+
+/*
+ * MSG_ZEROCOPY for the TCP socket. Completions are read from the error queue,
+ * on_close should be defined. returns false if not supported
+ */
+bool asc_socket_set_zerocopy(asc_socket_t *sock, bool is_on)
+{
+    sock->is_zerocopy = false;
+#ifdef SO_ZEROCOPY
+    if(!is_on || sock->type != SOCK_STREAM)
+        return false;
+
+    const int val = 1;
+    if(setsockopt(sock->fd, SOL_SOCKET, SO_ZEROCOPY, (void *)&val, sizeof(val)) == -1)
+    {
+        asc_log_error(MSG("failed to set SO_ZEROCOPY [%s]"), asc_socket_error());
+        return false;
+    }
+
+    sock->is_zerocopy = true;
+#else
+    __uarg(is_on);
+#endif
+    return sock->is_zerocopy;
+}
+
+/*
+ * drops the TCP connection with RST. Data in the send queue is discarded
+ * and not retransmitted. Socket should be closed after
+ */
+void asc_socket_reset(asc_socket_t *sock)
+{
+    const struct linger linger = { 1, 0 };
+    setsockopt(sock->fd, SOL_SOCKET, SO_LINGER, (void *)&linger, sizeof(linger));
+#ifdef __linux__
+    /* tcp_disconnect() */
+    struct sockaddr addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sa_family = AF_UNSPEC;
+    if(connect(sock->fd, &addr, sizeof(addr)) == -1)
+        asc_log_debug(MSG("failed to reset connection [%s]"), asc_socket_error());
+#endif
+}
+
 /*
  * oooo     oooo       oooooooo8     o       oooooooo8 ooooooooooo
  *  8888o   888      o888     88    888     888        88  888  88
@@ -842,11 +1616,11 @@ void asc_socket_set_multicast_loop(asc_socket_t *sock, int is_on)
 
 /* multicast_* */
 
-static int __asc_socket_multicast_cmd(asc_socket_t *sock, int cmd)
+static int __asc_socket_multicast_mreq(asc_socket_t *sock, int cmd, const struct ip_mreq *mreq)
 {
     int r;
 
-    r = setsockopt(sock->fd, IPPROTO_IP, cmd, (void *)&sock->mreq, sizeof(sock->mreq));
+    r = setsockopt(sock->fd, IPPROTO_IP, cmd, (void *)mreq, sizeof(*mreq));
     if(r == -1)
         return -1;
 
@@ -855,12 +1629,12 @@ static int __asc_socket_multicast_cmd(asc_socket_t *sock, int cmd)
     memset(buffer, 0, IP_HEADER_SIZE + IGMP_HEADER_SIZE);
 
     struct sockaddr_in dst;
-    dst.sin_addr.s_addr = sock->mreq.imr_multiaddr.s_addr;
+    dst.sin_addr.s_addr = mreq->imr_multiaddr.s_addr;
     dst.sin_family = AF_INET;
 
     create_igmp_packet(buffer,
         (cmd == IP_ADD_MEMBERSHIP) ? 0x16 : 0x17,
-        sock->mreq.imr_multiaddr.s_addr);
+        mreq->imr_multiaddr.s_addr);
 
     int raw_sock = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
     if(raw_sock == -1)
@@ -875,6 +1649,11 @@ static int __asc_socket_multicast_cmd(asc_socket_t *sock, int cmd)
     return 0;
 }
 
+static int __asc_socket_multicast_cmd(asc_socket_t *sock, int cmd)
+{
+    return __asc_socket_multicast_mreq(sock, cmd, &sock->mreq);
+}
+
 void asc_socket_multicast_join(asc_socket_t *sock, const char *addr, const char *localaddr)
 {
     memset(&sock->mreq, 0, sizeof(sock->mreq));
@@ -935,3 +1714,34 @@ void asc_socket_multicast_renew(asc_socket_t *sock)
     asc_log_error(MSG("failed to renew multicast \"%s\" (%s)"),
         inet_ntoa(sock->mreq.imr_multiaddr), asc_socket_error());
 }
+
+/*
+ * membership in the additional group. one socket could join many groups,
+ * the number is limited by the system (net.ipv4.igmp_max_memberships)
+ */
+bool asc_socket_multicast_group(  asc_socket_t *sock, const char *addr
+                                , const char *localaddr, bool is_join)
+{
+    const int cmd = (is_join) ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP;
+    struct ip_mreq mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.imr_multiaddr.s_addr = inet_addr(addr);
+    if(!IN_MULTICAST(ntohl(mreq.imr_multiaddr.s_addr)))
+        return false;
+    if(localaddr)
+    {
+        mreq.imr_interface.s_addr = inet_addr(localaddr);
+        if(mreq.imr_interface.s_addr == INADDR_NONE)
+            mreq.imr_interface.s_addr = INADDR_ANY;
+    }
+
+    if(__asc_socket_multicast_mreq(sock, cmd, &mreq) == -1)
+    {
+        asc_log_error(MSG("failed to %s multicast \"%s\" (%s)")
+                      , (is_join) ? "join" : "leave"
+                      , addr, asc_socket_error());
+        return false;
+    }
+
+    return true;
+}
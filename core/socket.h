@@ -24,6 +24,16 @@
 #include "base.h"
 #include "event.h"
 
+#ifndef _WIN32
+#   include <sys/uio.h>
+#else
+struct iovec
+{
+    void *iov_base;
+    size_t iov_len;
+};
+#endif
+
 typedef struct asc_socket_t asc_socket_t;
 
 void asc_socket_core_init(void);
@@ -53,9 +63,34 @@ void asc_socket_connect(  asc_socket_t *sock, const char *addr, int port
 
 ssize_t asc_socket_recv(asc_socket_t *sock, void *buffer, size_t size) __wur;
 ssize_t asc_socket_recvfrom(asc_socket_t *sock, void *buffer, size_t size) __wur;
+int asc_socket_recv_batch(  asc_socket_t *sock, void *buffer, size_t size
+                          , size_t *len_list, int count) __wur;
+int asc_socket_recv_batch_dst(  asc_socket_t *sock, void *buffer, size_t size
+                              , size_t *len_list, uint32_t *dst_list, int count) __wur;
 
 ssize_t asc_socket_send(asc_socket_t *sock, const void *buffer, size_t size) __wur;
+/*
+ * With io_uring the datagrams of the main thread are queued and sent with
+ * the next submission, the return value is the queued size. A send error
+ * is reported by the next sendto call on the socket: -1 and errno,
+ * the datagram of that call is not sent
+ */
 ssize_t asc_socket_sendto(asc_socket_t *sock, const void *buffer, size_t size) __wur;
+ssize_t asc_socket_sendtov(asc_socket_t *sock, const struct iovec *iov, int iov_count) __wur;
+ssize_t asc_socket_sendv(asc_socket_t *sock, const struct iovec *iov, int iov_count) __wur;
+ssize_t asc_socket_sendv_zerocopy(asc_socket_t *sock, const struct iovec *iov, int iov_count) __wur;
+uint32_t asc_socket_zerocopy_sent(asc_socket_t *sock) __wur;
+uint32_t asc_socket_zerocopy_done(asc_socket_t *sock) __wur;
+
+typedef struct
+{
+    struct iovec *iov;
+    int iov_count;
+    uint64_t txtime; /* departure time in the asc_ntime() scale. see asc_socket_set_txtime */
+} asc_socket_datagram_t;
+
+int asc_socket_sendto_batch(  asc_socket_t *sock
+                            , const asc_socket_datagram_t *list, int count) __wur;
 
 int asc_socket_fd(asc_socket_t *sock) __wur;
 const char * asc_socket_addr(asc_socket_t *sock) __wur;
@@ -64,11 +99,18 @@ int asc_socket_port(asc_socket_t *sock) __wur;
 void asc_socket_set_nonblock(asc_socket_t *sock, bool is_nonblock);
 void asc_socket_set_sockaddr(asc_socket_t *sock, const char *addr, int port);
 void asc_socket_set_reuseaddr(asc_socket_t *sock, int is_on);
+void asc_socket_set_reuseport(asc_socket_t *sock, int is_on);
 void asc_socket_set_non_delay(asc_socket_t *sock, int is_on);
 void asc_socket_set_keep_alive(asc_socket_t *sock, int is_on);
 void asc_socket_set_broadcast(asc_socket_t *sock, int is_on);
 void asc_socket_set_timeout(asc_socket_t *sock, int rcvmsec, int sndmsec);
 void asc_socket_set_buffer(asc_socket_t *sock, int rcvbuf, int sndbuf);
+bool asc_socket_set_gso(asc_socket_t *sock, bool is_on);
+bool asc_socket_set_txtime(asc_socket_t *sock, bool is_on);
+bool asc_socket_set_pktinfo(asc_socket_t *sock, bool is_on);
+bool asc_socket_set_zerocopy(asc_socket_t *sock, bool is_on);
+uint64_t asc_socket_recv_time(asc_socket_t *sock);
+void asc_socket_reset(asc_socket_t *sock);
 
 void asc_socket_set_multicast_if(asc_socket_t *sock, const char *addr);
 void asc_socket_set_multicast_ttl(asc_socket_t *sock, int ttl);
@@ -76,5 +118,7 @@ void asc_socket_set_multicast_loop(asc_socket_t *sock, int is_on);
 void asc_socket_multicast_join(asc_socket_t *sock, const char *addr, const char *localaddr);
 void asc_socket_multicast_leave(asc_socket_t *sock);
 void asc_socket_multicast_renew(asc_socket_t *sock);
+bool asc_socket_multicast_group(  asc_socket_t *sock, const char *addr
+                                , const char *localaddr, bool is_join);
 
 #endif /* _ASC_SOCKET_H_ */
@@ -17,8 +17,9 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
-
 #include "assert.h"
+#include "clock.h"
+#include "event.h"
 #include "thread.h"
 #include "list.h"
 #include "log.h"
@@ -28,23 +29,46 @@
 #   include <windows.h>
 #else
 #   include <pthread.h>
+#   ifdef HAVE_EVENTFD
+#       include <sys/eventfd.h>
+#   endif
 #endif
 
 #define MSG(_msg) "[core/thread] " _msg
 
+#ifndef CACHE_LINE_SIZE
+#   define CACHE_LINE_SIZE 64
+#endif
+
+/* on_read calls per one notification, remaining data is signalled again */
+#define THREAD_READ_LIMIT 16
+
+/*
+ * Single-producer/single-consumer ring.
+ * write and read are the absolute stream positions (not wrapped),
+ * each one is changed only by own side and published with release store.
+ * Positions are placed to the different cache lines.
+ */
+
 struct asc_thread_buffer_t
 {
     uint8_t *buffer;
     size_t size;
-    size_t read;
-    size_t write;
-    size_t count;
 
-#ifdef _WIN32
-    HANDLE mutex;
-#else
-    pthread_mutex_t mutex;
-#endif
+    asc_thread_t *thread; /* notify thread on_read on write */
+
+    uint8_t _pad_0[CACHE_LINE_SIZE];
+
+    /* producer */
+    uint64_t write;
+    uint64_t flush; /* position of the last flush, see asc_thread_buffer_flush() */
+
+    uint8_t _pad_1[CACHE_LINE_SIZE - sizeof(uint64_t) * 2];
+
+    /* consumer */
+    uint64_t read;
+
+    uint8_t _pad_2[CACHE_LINE_SIZE - sizeof(uint64_t)];
 };
 
 struct asc_thread_t
@@ -63,6 +87,10 @@ struct asc_thread_t
     HANDLE thread;
 #else
     pthread_t thread;
+
+    int notify_fd[2]; /* 0 - read, 1 - write */
+    int notify_pending;
+    asc_event_t *notify_event;
 #endif
 };
 
@@ -74,17 +102,8 @@ typedef struct
 
 static thread_observer_t thread_observer;
 
-#ifdef _WIN32
-#   define asc_thread_mutex_init(_mutex) _mutex = CreateMutex(NULL, FALSE, NULL)
-#   define asc_thread_mutex_destroy(_mutex) CloseHandle(_mutex)
-#   define asc_thread_mutex_lock(_mutex) WaitForSingleObject(_mutex, INFINITE)
-#   define asc_thread_mutex_unlock(_mutex) ReleaseMutex(_mutex)
-#else
-#   define asc_thread_mutex_init(_mutex) pthread_mutex_init(&_mutex, NULL)
-#   define asc_thread_mutex_destroy(_mutex) pthread_mutex_destroy(&_mutex)
-#   define asc_thread_mutex_lock(_mutex) pthread_mutex_lock(&_mutex)
-#   define asc_thread_mutex_unlock(_mutex) pthread_mutex_unlock(&_mutex)
-#endif
+#define asc_atomic_load(_ptr) __atomic_load_n(_ptr, __ATOMIC_ACQUIRE)
+#define asc_atomic_store(_ptr, _val) __atomic_store_n(_ptr, _val, __ATOMIC_RELEASE)
 
 void asc_thread_core_init(void)
 {
@@ -112,8 +131,121 @@ void asc_thread_core_destroy(void)
     thread_observer.thread_list = NULL;
 }
 
+static inline void asc_thread_call(thread_callback_t callback, void *arg)
+{
+    const uint64_t time_begin = asc_utime();
+    callback(arg);
+    asc_main_loop_trace(&main_loop_stat.thread_time, time_begin, "thread", NULL);
+}
+
+static inline size_t asc_thread_buffer_count(asc_thread_buffer_t *buffer)
+{
+    return (size_t)(asc_atomic_load(&buffer->write) - asc_atomic_load(&buffer->read));
+}
+
+#ifndef _WIN32
+
+/*
+ * oooo   oooo  ooooooo  ooooooooooo ooooo ooooooooooo ooooo  oooo
+ *  8888o  88 o888   888o 88  888  88 888   888    88    888  88
+ *  88 888o88 888     888     888     888   888ooo8        888
+ *  88   8888 888o   o888     888     888   888            888
+ * o88o    88   88ooo88      o888o   o888o o888o          o888o
+ *
+ * Worker thread signals the main loop through the event observer
+ * when data is written to the buffer or when the thread is finished.
+ * Signal is coalesced with notify_pending flag.
+ */
+
+static void asc_thread_notify_open(asc_thread_t *thread)
+{
+#ifdef HAVE_EVENTFD
+    thread->notify_fd[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    thread->notify_fd[1] = thread->notify_fd[0];
+    asc_assert(thread->notify_fd[0] != -1, MSG("failed to open eventfd [%s]"), strerror(errno));
+#else
+    const int ret = pipe(thread->notify_fd);
+    asc_assert(ret != -1, MSG("failed to open pipe [%s]"), strerror(errno));
+    for(int i = 0; i < 2; ++i)
+    {
+        fcntl(thread->notify_fd[i], F_SETFL, fcntl(thread->notify_fd[i], F_GETFL) | O_NONBLOCK);
+        fcntl(thread->notify_fd[i], F_SETFD, FD_CLOEXEC);
+    }
+#endif
+}
+
+static void asc_thread_notify_close(asc_thread_t *thread)
+{
+    ASC_FREE(thread->notify_event, asc_event_close);
+
+    if(thread->notify_fd[0] == -1)
+        return;
+
+    close(thread->notify_fd[0]);
+    if(thread->notify_fd[1] != thread->notify_fd[0])
+        close(thread->notify_fd[1]);
+    thread->notify_fd[0] = -1;
+    thread->notify_fd[1] = -1;
+}
+
+static void asc_thread_notify(asc_thread_t *thread)
+{
+    /* full barrier. buffer position is published before the flag is checked */
+    if(__sync_lock_test_and_set(&thread->notify_pending, 1))
+        return;
+
+    const uint64_t value = 1;
+    if(write(thread->notify_fd[1], &value, sizeof(value)) == -1)
+        __sync_lock_release(&thread->notify_pending);
+}
+
+static void on_thread_notify(void *arg)
+{
+    asc_thread_t *thread = (asc_thread_t *)arg;
+
+    uint64_t value;
+    while(read(thread->notify_fd[0], &value, sizeof(value)) > 0)
+        ;
+
+    /* clear flag before the buffer check, the next write will signal again */
+    __sync_lock_release(&thread->notify_pending);
+    __sync_synchronize();
+
+    thread_observer.is_changed = false;
+
+    if(thread->on_read && thread->buffer)
+    {
+        for(int i = 0; i < THREAD_READ_LIMIT; ++i)
+        {
+            if(!thread->buffer || asc_thread_buffer_count(thread->buffer) == 0)
+                break;
+
+            asc_thread_call(thread->on_read, thread->arg);
+            if(thread_observer.is_changed)
+                return;
+        }
+
+        if(thread->buffer && asc_thread_buffer_count(thread->buffer) > 0)
+            asc_thread_notify(thread);
+    }
+
+    if(thread->on_close && asc_atomic_load(&thread->is_closed))
+        asc_thread_call(thread->on_close, thread->arg);
+}
+
+static void on_thread_notify_error(void *arg)
+{
+    asc_thread_t *thread = (asc_thread_t *)arg;
+    /* event observer is destroyed before the thread observer */
+    ASC_FREE(thread->notify_event, asc_event_close);
+}
+
+#endif /* !_WIN32 */
+
 void asc_thread_core_loop(void)
 {
+#ifdef _WIN32
+    /* event observer is not able to wait on the thread notification */
     thread_observer.is_changed = false;
     asc_list_for(thread_observer.thread_list)
     {
@@ -121,12 +253,12 @@ void asc_thread_core_loop(void)
         if(!thread->is_started)
             continue;
 
-        if(thread->on_read)
+        if(thread->on_read && thread->buffer)
         {
-            if(thread->buffer->count > 0)
+            if(asc_thread_buffer_count(thread->buffer) > 0)
             {
                 is_main_loop_idle = false;
-                thread->on_read(thread->arg);
+                asc_thread_call(thread->on_read, thread->arg);
                 if(thread_observer.is_changed)
                     break;
             }
@@ -135,11 +267,12 @@ void asc_thread_core_loop(void)
         if(thread->on_close && thread->is_closed)
         {
             is_main_loop_idle = false;
-            thread->on_close(thread->arg);
+            asc_thread_call(thread->on_close, thread->arg);
             if(thread_observer.is_changed)
                 break;
         }
     }
+#endif
 }
 
 asc_thread_t * asc_thread_init(void *arg)
@@ -148,6 +281,13 @@ asc_thread_t * asc_thread_init(void *arg)
 
     thread->arg = arg;
 
+#ifndef _WIN32
+    asc_thread_notify_open(thread);
+    thread->notify_event = asc_event_init(thread->notify_fd[0], thread);
+    asc_event_set_on_read(thread->notify_event, on_thread_notify);
+    asc_event_set_on_error(thread->notify_event, on_thread_notify_error);
+#endif
+
     asc_list_insert_tail(thread_observer.thread_list, thread);
     thread_observer.is_changed = true;
 
@@ -164,11 +304,12 @@ static void * asc_thread_loop(void *arg)
 
     thread->is_started = true;
     thread->loop(thread->arg);
-    thread->is_closed = true;
+    asc_atomic_store(&thread->is_closed, true);
 
 #ifdef _WIN32
     return 0;
 #else
+    asc_thread_notify(thread);
     pthread_exit(NULL);
 #endif
 }
@@ -187,6 +328,7 @@ void asc_thread_start(  asc_thread_t *thread
     {
         thread->buffer = buffer;
         asc_assert(thread->buffer != NULL, MSG("buffer required"));
+        thread->buffer->thread = thread;
     }
 
     thread->on_close = on_close;
@@ -215,27 +357,39 @@ void asc_thread_destroy(asc_thread_t *thread)
     if(!thread)
         return;
 
-    thread->is_closed = true;
+    asc_atomic_store(&thread->is_closed, true);
 
 #ifdef _WIN32
     WaitForSingleObject(thread->thread, INFINITE);
     CloseHandle(thread->thread);
 #else
     pthread_join(thread->thread, NULL);
+    asc_thread_notify_close(thread);
 #endif
 
+    if(thread->buffer)
+        thread->buffer->thread = NULL;
+
     thread_observer.is_changed = true;
     asc_list_remove_item(thread_observer.thread_list, thread);
 
     free(thread);
 }
 
+/*
+ * oooooooooo  ooooo  oooo ooooooooooo ooooooooooo ooooooooooo oooooooooo
+ *  888    888  888    88   888    88   888    88   888    88   888    888
+ *  888oooo88   888    88   888ooo8     888ooo8     888ooo8     888oooo88
+ *  888    888  888    88   888         888         888    oo   888  88o
+ * o888ooo888    888oo88   o888o       o888o       o888ooo8888 o888o  88o8
+ *
+ */
+
 asc_thread_buffer_t * asc_thread_buffer_init(size_t size)
 {
     asc_thread_buffer_t *buffer = (asc_thread_buffer_t *)calloc(1, sizeof(asc_thread_buffer_t));
     buffer->size = size;
     buffer->buffer = (uint8_t *)malloc(size);
-    asc_thread_mutex_init(buffer->mutex);
     return buffer;
 }
 
@@ -243,84 +397,90 @@ void asc_thread_buffer_destroy(asc_thread_buffer_t *buffer)
 {
     if(!buffer)
         return;
+    if(buffer->thread)
+        buffer->thread->buffer = NULL;
     free(buffer->buffer);
-    asc_thread_mutex_destroy(buffer->mutex);
     free(buffer);
 }
 
+/*
+ * Drops all data written before the call.
+ * Could be called by both sides: consumer skips data up to the flush
+ * position on the next read, producer gets free space after that read.
+ */
 void asc_thread_buffer_flush(asc_thread_buffer_t *buffer)
 {
-    asc_thread_mutex_lock(buffer->mutex);
-    buffer->count = 0;
-    buffer->read = 0;
-    buffer->write = 0;
-    asc_thread_mutex_unlock(buffer->mutex);
+    const uint64_t write = asc_atomic_load(&buffer->write);
+    __atomic_store_n(&buffer->flush, write, __ATOMIC_SEQ_CST);
 }
 
+/* Copies up to size bytes. Called by the consumer only */
 ssize_t asc_thread_buffer_read(asc_thread_buffer_t *buffer, void *data, size_t size)
 {
-    asc_thread_mutex_lock(buffer->mutex);
-    if(size > buffer->count)
-        size = buffer->count;
+    uint64_t read = buffer->read;
+
+    const uint64_t flush = asc_atomic_load(&buffer->flush);
+    if(flush > read)
+        read = flush;
+
+    const uint64_t write = asc_atomic_load(&buffer->write);
+    const size_t count = (size_t)(write - read);
+    if(size > count)
+        size = count;
 
     if(!size)
     {
-        asc_thread_mutex_unlock(buffer->mutex);
+        if(read != buffer->read)
+            asc_atomic_store(&buffer->read, read);
         return 0;
     }
 
-    const size_t next_read = buffer->read + size;
-    if(next_read < buffer->size)
-    {
-        memcpy(data, &buffer->buffer[buffer->read], size);
-        buffer->read += size;
-    }
-    else if(next_read > buffer->size)
+    const size_t skip = (size_t)(read % buffer->size);
+    const size_t tail = buffer->size - skip;
+    if(size <= tail)
     {
-        const size_t tail = buffer->size - buffer->read;
-        memcpy(data, &buffer->buffer[buffer->read], tail);
-        buffer->read = size - tail;
-        memcpy(&((uint8_t *)data)[tail], buffer->buffer, buffer->read);
+        memcpy(data, &buffer->buffer[skip], size);
     }
     else
     {
-        memcpy(data, &buffer->buffer[buffer->read], size);
-        buffer->read = 0;
+        memcpy(data, &buffer->buffer[skip], tail);
+        memcpy(&((uint8_t *)data)[tail], buffer->buffer, size - tail);
     }
 
-    buffer->count -= size;
-    asc_thread_mutex_unlock(buffer->mutex);
+    asc_atomic_store(&buffer->read, read + size);
 
     return size;
 }
 
+/* Writes all or nothing. Called by the producer only */
 ssize_t asc_thread_buffer_write(asc_thread_buffer_t *buffer, const void *data, size_t size)
 {
     if(!size)
         return 0;
 
-    asc_thread_mutex_lock(buffer->mutex);
-    if(buffer->count + size > buffer->size)
-    {
-        asc_thread_mutex_unlock(buffer->mutex);
+    const uint64_t write = buffer->write;
+    const uint64_t read = asc_atomic_load(&buffer->read);
+    if((size_t)(write - read) + size > buffer->size)
         return -1; // buffer overflow
-    }
 
-    if(buffer->write + size >= buffer->size)
+    const size_t skip = (size_t)(write % buffer->size);
+    const size_t tail = buffer->size - skip;
+    if(size <= tail)
     {
-        const size_t tail = buffer->size - buffer->write;
-        memcpy(&buffer->buffer[buffer->write], data, tail);
-        buffer->write = size - tail;
-        if(buffer->write > 0)
-            memcpy(buffer->buffer, &((uint8_t *)data)[tail], buffer->write);
+        memcpy(&buffer->buffer[skip], data, size);
     }
     else
     {
-        memcpy(&buffer->buffer[buffer->write], data, size);
-        buffer->write += size;
+        memcpy(&buffer->buffer[skip], data, tail);
+        memcpy(buffer->buffer, &((const uint8_t *)data)[tail], size - tail);
     }
-    buffer->count += size;
-    asc_thread_mutex_unlock(buffer->mutex);
+
+    asc_atomic_store(&buffer->write, write + size);
+
+#ifndef _WIN32
+    if(buffer->thread)
+        asc_thread_notify(buffer->thread);
+#endif
 
     return size;
 }
@@ -18,11 +18,18 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "assert.h"
 #include "clock.h"
 #include "timer.h"
-#include "list.h"
 #include "loopctl.h"
 
+#define MSG(_msg) "[core/timer] " _msg
+
+/*
+ * Timers are stored in the binary min-heap ordered by next_shot.
+ * Each timer keeps own position in the heap, so removing is O(log n).
+ */
+
 struct asc_timer_t
 {
     timer_callback_t callback;
@@ -30,75 +37,178 @@ struct asc_timer_t
 
     uint64_t interval;
     uint64_t next_shot;
+
+    size_t index;
 };
 
-static asc_list_t *timer_list = NULL;
+/* index of the timer removed from the heap (one shot timer on call) */
+#define TIMER_DETACHED ((size_t)-1)
 
-void asc_timer_core_init(void)
+/* max delay (ms) returned by asc_timer_core_loop() */
+#define TIMER_MAX_DELAY 1000
+
+#define TIMER_HEAP_SIZE 256
+
+typedef struct
+{
+    asc_timer_t **heap;
+    size_t size;
+    size_t count;
+} timer_observer_t;
+
+static timer_observer_t timer_observer;
+
+static inline void timer_heap_set(size_t index, asc_timer_t *timer)
 {
-    timer_list = asc_list_init();
+    timer_observer.heap[index] = timer;
+    timer->index = index;
 }
 
-void asc_timer_core_destroy(void)
+static void timer_heap_up(size_t index)
 {
-    asc_list_first(timer_list);
-    while(!asc_list_eol(timer_list))
+    asc_timer_t *const timer = timer_observer.heap[index];
+
+    while(index > 0)
     {
-        free(asc_list_data(timer_list));
-        asc_list_remove_current(timer_list);
+        const size_t parent = (index - 1) / 2;
+        if(timer_observer.heap[parent]->next_shot <= timer->next_shot)
+            break;
+
+        timer_heap_set(index, timer_observer.heap[parent]);
+        index = parent;
     }
-    asc_list_destroy(timer_list);
-    timer_list = NULL;
+
+    timer_heap_set(index, timer);
 }
 
-void asc_timer_core_loop(void)
+static void timer_heap_down(size_t index)
 {
-    int is_detached = 0;
+    asc_timer_t *const timer = timer_observer.heap[index];
 
-    asc_list_for(timer_list)
+    while(true)
     {
-        asc_timer_t *timer = (asc_timer_t *)asc_list_data(timer_list);
-        if(!timer->callback)
-        {
-            ++is_detached;
-            continue;
-        }
+        size_t child = index * 2 + 1;
+        if(child >= timer_observer.count)
+            break;
 
-        const uint64_t cur = asc_utime();
-        if(cur >= timer->next_shot)
+        if(child + 1 < timer_observer.count
+           && timer_observer.heap[child + 1]->next_shot < timer_observer.heap[child]->next_shot)
         {
-            if(timer->interval == 0)
-            {
-                // one shot timer
-                is_main_loop_idle = false;
-                timer->callback(timer->arg);
-                timer->callback = NULL;
-                ++is_detached;
-            }
-            else
-            {
-                is_main_loop_idle = false;
-                timer->next_shot = cur + timer->interval;
-                timer->callback(timer->arg);
-            }
+            ++child;
         }
+
+        if(timer->next_shot <= timer_observer.heap[child]->next_shot)
+            break;
+
+        timer_heap_set(index, timer_observer.heap[child]);
+        index = child;
     }
 
-    if(!is_detached)
+    timer_heap_set(index, timer);
+}
+
+static void timer_heap_insert(asc_timer_t *timer)
+{
+    if(timer_observer.count == timer_observer.size)
+    {
+        const size_t size = timer_observer.size * 2;
+        asc_timer_t **const heap = (asc_timer_t **)realloc(  timer_observer.heap
+                                                           , size * sizeof(asc_timer_t *));
+        asc_assert(heap != NULL, MSG("realloc() failed"));
+        timer_observer.heap = heap;
+        timer_observer.size = size;
+    }
+
+    timer_heap_set(timer_observer.count, timer);
+    ++timer_observer.count;
+    timer_heap_up(timer->index);
+}
+
+static void timer_heap_remove(asc_timer_t *timer)
+{
+    const size_t index = timer->index;
+    timer->index = TIMER_DETACHED;
+
+    --timer_observer.count;
+    if(index == timer_observer.count)
         return;
 
-    asc_list_first(timer_list);
-    while(!asc_list_eol(timer_list))
+    asc_timer_t *const last = timer_observer.heap[timer_observer.count];
+    timer_heap_set(index, last);
+
+    if(index > 0 && timer_observer.heap[(index - 1) / 2]->next_shot > last->next_shot)
+        timer_heap_up(index);
+    else
+        timer_heap_down(index);
+}
+
+void asc_timer_core_init(void)
+{
+    timer_observer.size = TIMER_HEAP_SIZE;
+    timer_observer.count = 0;
+    timer_observer.heap = (asc_timer_t **)malloc(timer_observer.size * sizeof(asc_timer_t *));
+}
+
+void asc_timer_core_destroy(void)
+{
+    for(size_t i = 0; i < timer_observer.count; ++i)
+        free(timer_observer.heap[i]);
+
+    free(timer_observer.heap);
+    timer_observer.heap = NULL;
+    timer_observer.size = 0;
+    timer_observer.count = 0;
+}
+
+unsigned int asc_timer_core_loop(void)
+{
+    uint64_t cur = asc_utime();
+
+    while(timer_observer.count > 0)
     {
-        asc_timer_t *timer = (asc_timer_t *)asc_list_data(timer_list);
-        if(timer->callback)
-            asc_list_next(timer_list);
+        asc_timer_t *const timer = timer_observer.heap[0];
+        if(cur < timer->next_shot)
+            break;
+
+        const uint64_t lag = cur - timer->next_shot;
+        ++main_loop_stat.timer_count;
+        main_loop_stat.timer_lag += lag;
+        if(lag > main_loop_stat.timer_lag_max)
+            main_loop_stat.timer_lag_max = lag;
+
+        is_main_loop_idle = false;
+
+        if(timer->interval == 0)
+        {
+            // one shot timer
+            timer_heap_remove(timer);
+            const uint64_t time_begin = asc_utime();
+            timer->callback(timer->arg);
+            asc_main_loop_trace(&main_loop_stat.timer_time, time_begin, "timer", NULL);
+            free(timer);
+        }
         else
         {
-            free(asc_list_data(timer_list));
-            asc_list_remove_current(timer_list);
+            // timer could be destroyed in the callback
+            timer->next_shot = cur + timer->interval;
+            timer_heap_down(0);
+            const uint64_t time_begin = asc_utime();
+            timer->callback(timer->arg);
+            asc_main_loop_trace(&main_loop_stat.timer_time, time_begin, "timer", NULL);
         }
     }
+
+    if(timer_observer.count == 0)
+        return TIMER_MAX_DELAY;
+
+    const uint64_t next_shot = timer_observer.heap[0]->next_shot;
+    cur = asc_utime();
+    if(next_shot <= cur)
+        return 0;
+
+    /* round up, wake up is not allowed before the shot time */
+    const uint64_t delay = (next_shot - cur + 999) / 1000;
+    return (delay < TIMER_MAX_DELAY) ? (unsigned int)delay : TIMER_MAX_DELAY;
 }
 
 asc_timer_t * asc_timer_init(unsigned int ms, void (*callback)(void *), void *arg)
@@ -110,7 +220,7 @@ asc_timer_t * asc_timer_init(unsigned int ms, void (*callback)(void *), void *ar
 
     timer->next_shot = asc_utime() + timer->interval;
 
-    asc_list_insert_tail(timer_list, timer);
+    timer_heap_insert(timer);
 
     return timer;
 }
@@ -128,5 +238,10 @@ void asc_timer_destroy(asc_timer_t *timer)
     if(!timer)
         return;
 
-    timer->callback = NULL;
+    /* one shot timer on call. released by asc_timer_core_loop() */
+    if(timer->index == TIMER_DETACHED)
+        return;
+
+    timer_heap_remove(timer);
+    free(timer);
 }
@@ -38,6 +38,7 @@ static void signal_handler(int signum)
         case SIGHUP:
             asc_log_hup();
             is_sighup = true;
+            asc_event_core_wake();
             return;
         case SIGPIPE:
             return;
@@ -179,13 +180,18 @@ astra_reload_entry:
                 luaL_error(lua, "[main] %s", lua_tostring(lua, -1));
         }
 
+        unsigned int loop_timeout = 0;
+
         while(true)
         {
             is_main_loop_idle = true;
+            ++main_loop_stat.loop_count;
 
-            asc_event_core_loop();
-            asc_timer_core_loop();
+            const uint64_t loop_begin = asc_utime();
+            asc_event_core_loop(loop_timeout);
+            loop_timeout = asc_timer_core_loop();
             asc_thread_core_loop();
+            asc_main_loop_run_deferred();
 
             if(is_sighup)
             {
@@ -201,16 +207,30 @@ astra_reload_entry:
                     lua_pop(lua, 1);
             }
 
+            current_time = asc_utime();
+            const uint64_t loop_time = current_time - loop_begin;
+            asc_histogram_add(&main_loop_stat.loop_time
+                              , (loop_time > main_loop_stat.wait_time)
+                                ? (loop_time - main_loop_stat.wait_time)
+                                : 0);
+
             if(is_main_loop_idle)
             {
-                current_time = asc_utime();
                 if((current_time - gc_check_timeout) >= GC_TIMEOUT)
                 {
                     gc_check_timeout = current_time;
                     lua_gc(lua, LUA_GCCOLLECT, 0);
                 }
 
-                asc_usleep(1000);
+                /* block in the event observer until the next timer or gc check */
+                const uint64_t gc_delay = gc_check_timeout + GC_TIMEOUT - current_time;
+                if(loop_timeout * 1000 > gc_delay)
+                    loop_timeout = (gc_delay + 999) / 1000;
+            }
+            else
+            {
+                /* callbacks may have a pending work, check events without waiting */
+                loop_timeout = 0;
             }
         }
     }
@@ -31,6 +31,26 @@
  *                  - abort execution
  *      astra.exit()
  *                  - normal exit from astra
+ *      astra.stat([reset])
+ *                  - return table, main loop counters: loop_count, wait_count,
+ *                    wake_count, timer_count, timer_lag (average delay of the
+ *                    timer shots in microseconds), timer_lag_max (since
+ *                    previous call).
+ *                    Durations in microseconds: loop_time (iteration without
+ *                    waiting), event_time, timer_time, thread_time, lua_time
+ *                    (callbacks). Each is a table: count, avg, max, p50, p90,
+ *                    p99, p999. reset - boolean, clear durations after read
+ *      astra.watchdog(ms)
+ *                  - report callbacks longer than ms, 0 - disable.
+ *                    Enables the stream profiler to find the slowest module
+ *      astra.profile(enable)
+ *                  - start or stop the stream profiler. counters are
+ *                    reset on start
+ *      astra.profile_dump()
+ *                  - return array of the stream modules counters: name,
+ *                    packets_in, packets_out, calls, time_total and time_max
+ *                    (nanoseconds, time of the child modules is excluded).
+ *                    counters of one module: module:stats()
  */
 
 #include <astra.h>
@@ -56,6 +76,88 @@ static int _astra_reload(lua_State *L)
     return 0;
 }
 
+static void push_histogram(lua_State *L, asc_histogram_t *histogram, const char *name)
+{
+    lua_newtable(L);
+
+    lua_pushnumber(L, histogram->count);
+    lua_setfield(L, -2, "count");
+    lua_pushnumber(L, (histogram->count > 0) ? (histogram->total / histogram->count) : 0);
+    lua_setfield(L, -2, "avg");
+    lua_pushnumber(L, histogram->max);
+    lua_setfield(L, -2, "max");
+    lua_pushnumber(L, asc_histogram_percentile(histogram, 50.0));
+    lua_setfield(L, -2, "p50");
+    lua_pushnumber(L, asc_histogram_percentile(histogram, 90.0));
+    lua_setfield(L, -2, "p90");
+    lua_pushnumber(L, asc_histogram_percentile(histogram, 99.0));
+    lua_setfield(L, -2, "p99");
+    lua_pushnumber(L, asc_histogram_percentile(histogram, 99.9));
+    lua_setfield(L, -2, "p999");
+
+    lua_setfield(L, -2, name);
+}
+
+static int _astra_stat(lua_State *L)
+{
+    const bool is_reset = lua_toboolean(L, 1);
+
+    lua_newtable(L);
+
+    lua_pushnumber(L, main_loop_stat.loop_count);
+    lua_setfield(L, -2, "loop_count");
+    lua_pushnumber(L, main_loop_stat.wait_count);
+    lua_setfield(L, -2, "wait_count");
+    lua_pushnumber(L, main_loop_stat.wake_count);
+    lua_setfield(L, -2, "wake_count");
+    lua_pushnumber(L, main_loop_stat.timer_count);
+    lua_setfield(L, -2, "timer_count");
+
+    const uint64_t timer_lag = (main_loop_stat.timer_count > 0)
+                             ? (main_loop_stat.timer_lag / main_loop_stat.timer_count)
+                             : 0;
+    lua_pushnumber(L, timer_lag);
+    lua_setfield(L, -2, "timer_lag");
+    lua_pushnumber(L, main_loop_stat.timer_lag_max);
+    lua_setfield(L, -2, "timer_lag_max");
+    main_loop_stat.timer_lag_max = 0;
+
+    asc_histogram_t *const histogram_list[] =
+    {
+        &main_loop_stat.loop_time,
+        &main_loop_stat.event_time,
+        &main_loop_stat.timer_time,
+        &main_loop_stat.thread_time,
+        &main_loop_stat.lua_time,
+    };
+    static const char *const histogram_name[] =
+    {
+        "loop_time",
+        "event_time",
+        "timer_time",
+        "thread_time",
+        "lua_time",
+    };
+
+    for(size_t i = 0; i < ASC_ARRAY_SIZE(histogram_list); ++i)
+    {
+        push_histogram(L, histogram_list[i], histogram_name[i]);
+        if(is_reset)
+            asc_histogram_reset(histogram_list[i]);
+    }
+
+    return 1;
+}
+
+static int _astra_watchdog(lua_State *L)
+{
+    const int ms = luaL_checkinteger(L, 1);
+    main_loop_watchdog = (ms > 0) ? (uint64_t)ms * 1000 : 0;
+    if(main_loop_watchdog > 0)
+        module_stream_profile = true;
+    return 0;
+}
+
 LUA_API int luaopen_astra(lua_State *L)
 {
     static luaL_Reg astra_api[] =
@@ -63,6 +165,10 @@ LUA_API int luaopen_astra(lua_State *L)
         { "exit", _astra_exit },
         { "abort", _astra_abort },
         { "reload", _astra_reload },
+        { "stat", _astra_stat },
+        { "watchdog", _astra_watchdog },
+        { "profile", module_stream_lua_profile },
+        { "profile_dump", module_stream_lua_profile_dump },
         { NULL, NULL }
     };
 
@@ -5,8 +5,8 @@ SOURCES="$SOURCES astra.c log.c timer.c utils.c json.c iso8859.c"
 MODULES="astra log timer utils json base64 sha1 md5 rc4 str2hex iso8859"
 
 if [ "$OS" != "mingw" ] ; then
-    SOURCES="$SOURCES pidfile.c"
-    MODULES="$MODULES pidfile"
+    SOURCES="$SOURCES pidfile.c worker.c"
+    MODULES="$MODULES pidfile worker"
 fi
 
 getifaddrs_test_c()
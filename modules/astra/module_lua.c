@@ -101,3 +101,21 @@ bool module_option_boolean(const char *name, bool *boolean)
     lua_pop(lua, 1);
     return result;
 }
+
+/* lua_call() for callbacks from the main loop. measures the call duration */
+void module_lua_call(int nargs, int nresults)
+{
+    char name[128] = "lua";
+
+    if(main_loop_watchdog > 0)
+    {
+        lua_Debug ar;
+        lua_pushvalue(lua, -(nargs + 1));
+        if(lua_getinfo(lua, ">S", &ar))
+            snprintf(name, sizeof(name), "lua %s:%d", ar.short_src, ar.linedefined);
+    }
+
+    const uint64_t time_begin = asc_utime();
+    lua_call(lua, nargs, nresults);
+    asc_main_loop_trace(&main_loop_stat.lua_time, time_begin, "lua", name);
+}
@@ -112,4 +112,6 @@ bool module_option_number(const char *name, int *number);
 bool module_option_string(const char *name, const char **string, size_t *length);
 bool module_option_boolean(const char *name, bool *boolean);
 
+void module_lua_call(int nargs, int nresults);
+
 #endif /* _MODULE_LUA_H_ */
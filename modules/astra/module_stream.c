@@ -20,16 +20,266 @@
 
 #include <astra.h>
 
+/*
+ * Profiler. Disabled by default, astra.profile(true) to enable.
+ * Time of the child callbacks is excluded from the parent time.
+ */
+
+bool module_stream_profile = false;
+
+static asc_list_t *stream_list = NULL;
+static uint64_t profile_nested_time = 0;
+
+struct stream_slab_pool_t
+{
+    int refcount; // owner and slabs in use
+    size_t size;
+    int limit;
+    int count;
+    stream_slab_t *free_list;
+};
+
+stream_slab_t * stream_slab_init(size_t size)
+{
+    stream_slab_t *slab = (stream_slab_t *)malloc(sizeof(stream_slab_t) + size);
+    asc_assert(slab != NULL, "[stream] malloc() failed");
+    slab->refcount = 1;
+    slab->size = size;
+    slab->pool = NULL;
+    slab->next = NULL;
+    return slab;
+}
+
+stream_slab_t * stream_slab_ref(stream_slab_t *slab)
+{
+    ++slab->refcount;
+    return slab;
+}
+
+static void stream_slab_pool_unref(stream_slab_pool_t *pool)
+{
+    --pool->refcount;
+    if(pool->refcount == 0)
+        free(pool);
+}
+
+void stream_slab_unref(stream_slab_t *slab)
+{
+    if(!slab)
+        return;
+    --slab->refcount;
+    if(slab->refcount > 0)
+        return;
+
+    stream_slab_pool_t *pool = slab->pool;
+    if(!pool)
+    {
+        free(slab);
+        return;
+    }
+
+    if(pool->count < pool->limit)
+    {
+        slab->next = pool->free_list;
+        pool->free_list = slab;
+        ++pool->count;
+    }
+    else
+        free(slab);
+
+    stream_slab_pool_unref(pool);
+}
+
+stream_slab_pool_t * stream_slab_pool_init(size_t size, int limit)
+{
+    stream_slab_pool_t *pool = (stream_slab_pool_t *)calloc(1, sizeof(stream_slab_pool_t));
+    asc_assert(pool != NULL, "[stream] calloc() failed");
+    pool->refcount = 1;
+    pool->size = size;
+    pool->limit = limit;
+    return pool;
+}
+
+void stream_slab_pool_destroy(stream_slab_pool_t *pool)
+{
+    if(!pool)
+        return;
+
+    while(pool->free_list)
+    {
+        stream_slab_t *slab = pool->free_list;
+        pool->free_list = slab->next;
+        free(slab);
+    }
+    pool->count = 0;
+    pool->limit = 0;
+
+    stream_slab_pool_unref(pool);
+}
+
+stream_slab_t * stream_slab_pool_get(stream_slab_pool_t *pool)
+{
+    stream_slab_t *slab = pool->free_list;
+    if(slab)
+    {
+        pool->free_list = slab->next;
+        --pool->count;
+        slab->refcount = 1;
+        slab->next = NULL;
+    }
+    else
+    {
+        slab = stream_slab_init(pool->size);
+        slab->pool = pool;
+    }
+
+    ++pool->refcount;
+    return slab;
+}
+
+/*
+ * Subscribers table. Each pid has a list of childs with is_pid_filter.
+ */
+
+static void pid_table_insert(module_stream_t *stream, module_stream_t *child, uint16_t pid)
+{
+    if(!stream->pid_table)
+        stream->pid_table = (module_stream_pid_t *)calloc(MAX_PID, sizeof(module_stream_pid_t));
+
+    module_stream_pid_t *item = &stream->pid_table[pid];
+    if(item->count == item->size)
+    {
+        item->size = (item->size > 0) ? (item->size * 2) : 4;
+        item->list = (module_stream_t **)realloc(item->list
+                                                 , item->size * sizeof(module_stream_t *));
+    }
+    item->list[item->count] = child;
+    ++item->count;
+}
+
+static void pid_table_remove(module_stream_t *stream, module_stream_t *child, uint16_t pid)
+{
+    if(!stream->pid_table)
+        return;
+
+    module_stream_pid_t *item = &stream->pid_table[pid];
+    for(int i = 0; i < item->count; ++i)
+    {
+        if(item->list[i] == child)
+        {
+            --item->count;
+            memmove(&item->list[i], &item->list[i + 1]
+                    , (item->count - i) * sizeof(module_stream_t *));
+            break;
+        }
+    }
+}
+
+static void pid_table_destroy(module_stream_t *stream)
+{
+    if(!stream->pid_table)
+        return;
+
+    for(int pid = 0; pid < MAX_PID; ++pid)
+        free(stream->pid_table[pid].list);
+    free(stream->pid_table);
+    stream->pid_table = NULL;
+}
+
+static void pid_table_subscribe(module_stream_t *stream, module_stream_t *child, bool is_on)
+{
+    if(!child->pid_list)
+        return;
+
+    for(int pid = 0; pid < MAX_PID; ++pid)
+    {
+        if(child->pid_list[pid] == 0)
+            continue;
+        if(is_on)
+            pid_table_insert(stream, child, pid);
+        else
+            pid_table_remove(stream, child, pid);
+    }
+}
+
+static inline void child_send(module_stream_t *child, const uint8_t *ts, size_t count)
+{
+    if(child->on_ts_batch)
+        child->on_ts_batch(child->self, ts, count);
+    else if(child->on_ts)
+    {
+        for(size_t n = 0; n < count; ++n)
+            child->on_ts(child->self, &ts[n * TS_PACKET_SIZE]);
+    }
+}
+
+static void child_send_profile(module_stream_t *child, const uint8_t *ts, size_t count)
+{
+    const uint64_t nested_time = profile_nested_time;
+    profile_nested_time = 0;
+
+    const uint64_t time_begin = asc_ntime();
+    child_send(child, ts, count);
+    const uint64_t time_call = asc_ntime() - time_begin;
+
+    uint64_t time_self = 0;
+    if(time_call > profile_nested_time)
+        time_self = time_call - profile_nested_time;
+    profile_nested_time = nested_time + time_call;
+
+    module_stream_stat_t *stat = &child->stat;
+    stat->packets_in += count;
+    ++stat->calls;
+    stat->time_total += time_self;
+    if(time_self > stat->time_max)
+        stat->time_max = time_self;
+
+    if(main_loop_watchdog > 0 && child->name)
+        asc_main_loop_blame(child->name, time_self / 1000);
+}
+
+static inline void pid_table_send(module_stream_t *stream, const uint8_t *ts)
+{
+    const module_stream_pid_t *item = &stream->pid_table[TS_GET_PID(ts)];
+    const int count = item->count;
+    if(count == 0)
+        return;
+
+    /* child could join or leave pid in the on_ts */
+    module_stream_t *list[count];
+    memcpy(list, item->list, count * sizeof(module_stream_t *));
+
+    if(module_stream_profile)
+    {
+        for(int i = 0; i < count; ++i)
+            child_send_profile(list[i], ts, 1);
+    }
+    else
+    {
+        for(int i = 0; i < count; ++i)
+            list[i]->on_ts(list[i]->self, ts);
+    }
+}
+
+/*
+ * Stream
+ */
+
 void __module_stream_detach(module_stream_t *stream, module_stream_t *child)
 {
-    asc_list_for(stream->childs)
+    asc_list_t *childs = (child->is_pid_filter) ? stream->pid_childs : stream->childs;
+    asc_list_for(childs)
     {
-        if(child == asc_list_data(stream->childs))
+        if(child == asc_list_data(childs))
         {
-            asc_list_remove_current(stream->childs);
+            asc_list_remove_current(childs);
             break;
         }
     }
+
+    if(child->is_pid_filter)
+        pid_table_subscribe(stream, child, false);
+
     child->parent = NULL;
 }
 
@@ -38,22 +288,118 @@ void __module_stream_attach(module_stream_t *stream, module_stream_t *child)
     if(child->parent)
         __module_stream_detach(child->parent, child);
     child->parent = stream;
-    asc_list_insert_tail(stream->childs, child);
+
+    if(child->is_pid_filter)
+    {
+        asc_list_insert_tail(stream->pid_childs, child);
+        pid_table_subscribe(stream, child, true);
+    }
+    else
+        asc_list_insert_tail(stream->childs, child);
+}
+
+void __module_stream_demux_filter(module_stream_t *stream)
+{
+    if(stream->is_pid_filter)
+        return;
+
+    module_stream_t *parent = stream->parent;
+    if(parent)
+        __module_stream_detach(parent, stream);
+
+    stream->is_pid_filter = true;
+
+    if(parent)
+        __module_stream_attach(parent, stream);
+}
+
+void __module_stream_join_pid(module_stream_t *stream, module_stream_t *child, uint16_t pid)
+{
+    if(child->is_pid_filter)
+        pid_table_insert(stream, child, pid);
+
+    if(stream->join_pid)
+        stream->join_pid(stream->self, pid);
+}
+
+void __module_stream_leave_pid(module_stream_t *stream, module_stream_t *child, uint16_t pid)
+{
+    if(child->is_pid_filter)
+        pid_table_remove(stream, child, pid);
+
+    if(stream->leave_pid)
+        stream->leave_pid(stream->self, pid);
 }
 
 void __module_stream_send(module_stream_t *stream, const uint8_t *ts)
 {
+    if(module_stream_profile)
+    {
+        __module_stream_send_batch(stream, ts, 1);
+        return;
+    }
+
     asc_list_for(stream->childs)
     {
         module_stream_t *i = (module_stream_t *)asc_list_data(stream->childs);
         if(i->on_ts)
             i->on_ts(i->self, ts);
     }
+
+    if(stream->pid_table)
+        pid_table_send(stream, ts);
+}
+
+void __module_stream_send_batch(module_stream_t *stream, const uint8_t *ts, size_t count)
+{
+    if(module_stream_profile)
+    {
+        stream->stat.packets_out += count;
+        asc_list_for(stream->childs)
+            child_send_profile((module_stream_t *)asc_list_data(stream->childs), ts, count);
+    }
+    else
+    {
+        asc_list_for(stream->childs)
+            child_send((module_stream_t *)asc_list_data(stream->childs), ts, count);
+    }
+
+    if(stream->pid_table)
+    {
+        for(size_t n = 0; n < count; ++n)
+            pid_table_send(stream, &ts[n * TS_PACKET_SIZE]);
+    }
+}
+
+void __module_stream_send_slab(  module_stream_t *stream, stream_slab_t *slab
+                               , const uint8_t *ts, size_t count)
+{
+    stream_slab_t *const slab_save = stream->slab;
+    stream->slab = slab;
+    __module_stream_send_batch(stream, ts, count);
+    stream->slab = slab_save;
 }
 
 void __module_stream_init(module_stream_t *stream)
 {
     stream->childs = asc_list_init();
+    stream->pid_childs = asc_list_init();
+
+    if(!stream_list)
+        stream_list = asc_list_init();
+    asc_list_insert_tail(stream_list, stream);
+}
+
+static void __module_stream_release(asc_list_t *childs)
+{
+    asc_list_first(childs);
+    while(!asc_list_eol(childs))
+    {
+        module_stream_t *i = (module_stream_t *)asc_list_data(childs);
+        i->parent = NULL;
+        asc_list_remove_current(childs);
+    }
+    asc_list_destroy(childs);
 }
 
 void __module_stream_destroy(module_stream_t *stream)
@@ -61,13 +407,91 @@ void __module_stream_destroy(module_stream_t *stream)
     if(stream->parent)
         __module_stream_detach(stream->parent, stream);
 
-    asc_list_first(stream->childs);
-    while(!asc_list_eol(stream->childs))
+    __module_stream_release(stream->childs);
+    stream->childs = NULL;
+    __module_stream_release(stream->pid_childs);
+    stream->pid_childs = NULL;
+
+    pid_table_destroy(stream);
+
+    ASC_FREE(stream->name, free);
+
+    asc_list_remove_item(stream_list, stream);
+    if(asc_list_size(stream_list) == 0)
     {
-        module_stream_t *i = (module_stream_t *)asc_list_data(stream->childs);
-        i->parent = NULL;
-        asc_list_remove_current(stream->childs);
+        asc_list_destroy(stream_list);
+        stream_list = NULL;
     }
-    asc_list_destroy(stream->childs);
-    stream->childs = NULL;
+}
+
+/*
+ * Lua
+ */
+
+/* called from the module_init(). stack: 1 - module, 2 - options */
+void __module_stream_set_name(module_stream_t *stream)
+{
+    const char *type = luaL_tolstring(lua, 1, NULL);
+
+    lua_getfield(lua, MODULE_OPTIONS_IDX, "name");
+    const char *name = lua_isstring(lua, -1) ? lua_tostring(lua, -1) : NULL;
+
+    char buffer[256];
+    if(name)
+        snprintf(buffer, sizeof(buffer), "%s %s", type, name);
+    else
+        snprintf(buffer, sizeof(buffer), "%s", type);
+    stream->name = strdup(buffer);
+
+    lua_pop(lua, 2);
+}
+
+void __module_stream_push_stat(module_stream_t *stream)
+{
+    const module_stream_stat_t *stat = &stream->stat;
+
+    lua_newtable(lua);
+    lua_pushstring(lua, (stream->name) ? stream->name : "stream");
+    lua_setfield(lua, -2, "name");
+    lua_pushnumber(lua, stat->packets_in);
+    lua_setfield(lua, -2, "packets_in");
+    lua_pushnumber(lua, stat->packets_out);
+    lua_setfield(lua, -2, "packets_out");
+    lua_pushnumber(lua, stat->calls);
+    lua_setfield(lua, -2, "calls");
+    lua_pushnumber(lua, stat->time_total);
+    lua_setfield(lua, -2, "time_total");
+    lua_pushnumber(lua, stat->time_max);
+    lua_setfield(lua, -2, "time_max");
+}
+
+int module_stream_lua_profile(lua_State *L)
+{
+    const bool is_on = lua_toboolean(L, 1);
+    if(is_on && !module_stream_profile && stream_list)
+    {
+        asc_list_for(stream_list)
+        {
+            module_stream_t *stream = (module_stream_t *)asc_list_data(stream_list);
+            memset(&stream->stat, 0, sizeof(stream->stat));
+        }
+    }
+    module_stream_profile = is_on;
+    profile_nested_time = 0;
+    return 0;
+}
+
+int module_stream_lua_profile_dump(lua_State *L)
+{
+    lua_newtable(L);
+    if(!stream_list)
+        return 1;
+
+    int i = 1;
+    asc_list_for(stream_list)
+    {
+        __module_stream_push_stat((module_stream_t *)asc_list_data(stream_list));
+        lua_rawseti(L, -2, i++);
+    }
+    return 1;
 }
@@ -25,7 +25,63 @@
 #include "module_lua.h"
 #include <core/asc.h>
 
+/*
+ * Reference-counted packet storage. Source module receives data into
+ * the slab and sends it with module_stream_send_slab(). Children could
+ * keep a reference instead of copying packets. Slab data is read-only,
+ * module that changes packets should make own copy.
+ */
+
+typedef struct stream_slab_pool_t stream_slab_pool_t;
+typedef struct stream_slab_t stream_slab_t;
+
+struct stream_slab_t
+{
+    int refcount;
+    size_t size;
+    stream_slab_pool_t *pool;
+    stream_slab_t *next; // free list of the pool
+    uint8_t buffer[];
+};
+
+stream_slab_t * stream_slab_init(size_t size) __wur;
+stream_slab_t * stream_slab_ref(stream_slab_t *slab);
+void stream_slab_unref(stream_slab_t *slab);
+
+#define stream_slab_is_shared(_slab) ((_slab)->refcount > 1)
+
+/*
+ * Free list of the slabs with the same size. Source module takes the next
+ * slab from the pool while the previous one is referenced by the children.
+ * Slab is returned to the pool when the last reference is released.
+ * limit - maximum number of the free slabs. Pool is freed after the last
+ * slab in use, slabs released after stream_slab_pool_destroy() are freed.
+ */
+stream_slab_pool_t * stream_slab_pool_init(size_t size, int limit) __wur;
+void stream_slab_pool_destroy(stream_slab_pool_t *pool);
+stream_slab_t * stream_slab_pool_get(stream_slab_pool_t *pool) __wur;
+
 typedef struct module_stream_t module_stream_t;
+
+/* counters of the stream profiler, see module_stream_profile */
+typedef struct
+{
+    uint64_t packets_in;    /* packets delivered to the module */
+    uint64_t packets_out;   /* packets sent by the module */
+    uint64_t calls;         /* on_ts and on_ts_batch calls */
+    uint64_t time_total;    /* nanoseconds in own callbacks, childs are excluded */
+    uint64_t time_max;      /* nanoseconds, the worst single call */
+} module_stream_stat_t;
+
+extern bool module_stream_profile;
+
+typedef struct
+{
+    module_stream_t **list;
+    int count;
+    int size;
+} module_stream_pid_t;
+
 struct module_stream_t
 {
     module_data_t *self;
@@ -33,6 +89,10 @@ struct module_stream_t
 
     // stream
     void (*on_ts)(module_data_t *mod, const uint8_t *ts);
+    // optional. contiguous run of count packets. on_ts is used if not defined
+    void (*on_ts_batch)(module_data_t *mod, const uint8_t *ts, size_t count);
+    // slab of the batch in delivery, see module_stream_slab()
+    stream_slab_t *slab;
 
     asc_list_t *childs;
 
@@ -41,6 +101,17 @@ struct module_stream_t
     void (*leave_pid)(module_data_t *mod, uint16_t pid);
 
     uint8_t *pid_list;
+
+    // child receives only joined pids, see module_stream_demux_filter()
+    bool is_pid_filter;
+
+    // childs with is_pid_filter and their subscriptions
+    asc_list_t *pid_childs;
+    module_stream_pid_t *pid_table;
+
+    // profiler
+    char *name;
+    module_stream_stat_t stat;
 };
 
 #define MODULE_STREAM_DATA() module_stream_t __stream
@@ -51,12 +122,26 @@ void __module_stream_init(module_stream_t *stream);
 void __module_stream_destroy(module_stream_t *stream);
 void __module_stream_attach(module_stream_t *stream, module_stream_t *child);
 void __module_stream_send(module_stream_t *stream, const uint8_t *ts);
+void __module_stream_send_batch(module_stream_t *stream, const uint8_t *ts, size_t count);
+void __module_stream_send_slab(  module_stream_t *stream, stream_slab_t *slab
+                               , const uint8_t *ts, size_t count);
+
+void __module_stream_set_name(module_stream_t *stream);
+void __module_stream_push_stat(module_stream_t *stream);
+
+int module_stream_lua_profile(lua_State *L);
+int module_stream_lua_profile_dump(lua_State *L);
+
+void __module_stream_demux_filter(module_stream_t *stream);
+void __module_stream_join_pid(module_stream_t *stream, module_stream_t *child, uint16_t pid);
+void __module_stream_leave_pid(module_stream_t *stream, module_stream_t *child, uint16_t pid);
 
 #define module_stream_init(_mod, _on_ts)                                                        \
     {                                                                                           \
         _mod->__stream.self = _mod;                                                             \
         _mod->__stream.on_ts = _on_ts;                                                          \
         __module_stream_init(&_mod->__stream);                                                  \
+        __module_stream_set_name(&_mod->__stream);                                              \
         lua_getfield(lua, MODULE_OPTIONS_IDX, "upstream");                                      \
         if(lua_type(lua, -1) == LUA_TLIGHTUSERDATA)                                             \
         {                                                                                       \
@@ -66,6 +151,11 @@ void __module_stream_send(module_stream_t *stream, const uint8_t *ts);
         lua_pop(lua, 1);                                                                        \
     }
 
+#define module_stream_batch_set(_mod, _on_ts_batch)                                             \
+    {                                                                                           \
+        _mod->__stream.on_ts_batch = _on_ts_batch;                                              \
+    }
+
 #define module_stream_demux_set(_mod, _join_pid, _leave_pid)                                    \
     {                                                                                           \
         _mod->__stream.pid_list = (uint8_t *)calloc(MAX_PID, sizeof(uint8_t));                  \
@@ -97,8 +187,29 @@ void __module_stream_send(module_stream_t *stream, const uint8_t *ts);
 #define module_stream_send(_mod, _ts)                                                           \
     __module_stream_send(&_mod->__stream, _ts)
 
+#define module_stream_send_batch(_mod, _ts, _count)                                             \
+    __module_stream_send_batch(&_mod->__stream, _ts, _count)
+
+#define module_stream_send_slab(_mod, _slab, _ts, _count)                                       \
+    __module_stream_send_slab(&_mod->__stream, _slab, _ts, _count)
+
+/* slab of the packets in on_ts_batch() or NULL if parent sends own buffer */
+#define module_stream_slab(_mod)                                                                \
+    ((_mod->__stream.parent) ? _mod->__stream.parent->slab : NULL)
+
 // demux
 
+/*
+ * Packets of the joined pids only are delivered to the module.
+ * Parent dispatches them by the pid instead of sending every packet.
+ */
+#define module_stream_demux_filter(_mod)                                                        \
+    {                                                                                           \
+        asc_assert(_mod->__stream.pid_list != NULL                                              \
+                   , "%s:%d module_stream_demux_set() is required", __FILE__, __LINE__);        \
+        __module_stream_demux_filter(&_mod->__stream);                                          \
+    }
+
 #define module_stream_demux_check_pid(_mod, _pid)                                               \
     (_mod->__stream.pid_list[_pid] > 0)
 
@@ -108,11 +219,9 @@ void __module_stream_send(module_stream_t *stream, const uint8_t *ts);
         asc_assert(_mod->__stream.pid_list != NULL                                              \
                    , "%s:%d module_stream_demux_set() is required", __FILE__, __LINE__);        \
         ++_mod->__stream.pid_list[__pid];                                                       \
-        if(_mod->__stream.pid_list[__pid] == 1                                                  \
-           && _mod->__stream.parent                                                             \
-           && _mod->__stream.parent->join_pid)                                                  \
+        if(_mod->__stream.pid_list[__pid] == 1 && _mod->__stream.parent)                        \
         {                                                                                       \
-            _mod->__stream.parent->join_pid(_mod->__stream.parent->self, __pid);                \
+            __module_stream_join_pid(_mod->__stream.parent, &_mod->__stream, __pid);            \
         }                                                                                       \
     }
 
@@ -124,11 +233,9 @@ void __module_stream_send(module_stream_t *stream, const uint8_t *ts);
         if(_mod->__stream.pid_list[__pid] > 0)                                                  \
         {                                                                                       \
             --_mod->__stream.pid_list[__pid];                                                   \
-            if(_mod->__stream.pid_list[__pid] == 0                                              \
-               && _mod->__stream.parent                                                         \
-               && _mod->__stream.parent->leave_pid)                                             \
+            if(_mod->__stream.pid_list[__pid] == 0 && _mod->__stream.parent)                    \
             {                                                                                   \
-                _mod->__stream.parent->leave_pid(_mod->__stream.parent->self, __pid);           \
+                __module_stream_leave_pid(_mod->__stream.parent, &_mod->__stream, __pid);       \
             }                                                                                   \
         }                                                                                       \
         else                                                                                    \
@@ -145,9 +252,15 @@ void __module_stream_send(module_stream_t *stream, const uint8_t *ts);
     {                                                                                           \
         lua_pushlightuserdata(lua, &mod->__stream);                                             \
         return 1;                                                                               \
+    }                                                                                           \
+    static int module_stream_stats(module_data_t *mod)                                          \
+    {                                                                                           \
+        __module_stream_push_stat(&mod->__stream);                                              \
+        return 1;                                                                               \
     }
 
 #define MODULE_STREAM_METHODS_REF()                                                             \
-    { "stream", module_stream_stream }
+    { "stream", module_stream_stream },                                                         \
+    { "stats", module_stream_stats }
 
 #endif /* _MODULE_STREAM_H_ */
@@ -26,6 +26,9 @@
  *
  * Usage:
  *      pidfile("/path/to/file.pid")
+ *
+ * File is created and removed by the process that calls pidfile() first.
+ * Forked worker processes (see worker.fork()) do not change it.
  */
 
 #ifdef _WIN32
@@ -41,12 +44,18 @@ struct module_data_t
 
 static const char *filename = NULL;
 
+/* forked worker processes keep the file of the parent */
+static pid_t owner = 0;
+
 /* required */
 
 static void module_init(module_data_t *mod)
 {
     __uarg(mod);
 
+    if(owner != 0 && owner != getpid())
+        return;
+
     if(filename)
     {
         asc_log_error("[pidfile] already created in %s", filename);
@@ -86,6 +95,8 @@ static void module_init(module_data_t *mod)
         astra_abort();
     }
 
+    owner = getpid();
+
     // store in registry to prevent the instance destroying
     lua_pushvalue(lua, 3);
     mod->idx_self = luaL_ref(lua, LUA_REGISTRYINDEX);
@@ -95,6 +106,9 @@ static void module_destroy(module_data_t *mod)
 {
     __uarg(mod);
 
+    if(owner != getpid())
+        return;
+
     if(!access(filename, W_OK))
         unlink(filename);
 
@@ -42,7 +42,7 @@ static void timer_callback(void *arg)
     module_data_t *mod = (module_data_t *)arg;
     lua_rawgeti(lua, LUA_REGISTRYINDEX, mod->idx_callback);
     lua_rawgeti(lua, LUA_REGISTRYINDEX, mod->idx_self);
-    lua_call(lua, 1, 0);
+    module_lua_call(1, 0);
 }
 
 static int method_close(module_data_t *mod)
@@ -0,0 +1,325 @@
+/*
+ * Astra Module: Worker
+ * http://cesbo.com/astra
+ *
+ * Copyright (C) 2015, Andrey Dyldin <and@cesbo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Each worker is a separate process with own event loop, timers,
+ * stream graph and Lua state. Script decides which channels are
+ * started in the worker (see make_channel() in the stream.lua).
+ *
+ * Methods:
+ *      worker.fork(count)
+ *                  - start count-1 child processes, return worker id
+ *                    in range 0..count-1 (0 - parent process).
+ *                    Should be called before any module instance is created.
+ *                    On Linux each worker is pinned to the CPU core (id % cores)
+ *                    and terminated with the parent process. Parent process
+ *                    restarts the terminated workers. On reload returns
+ *                    the id of the current worker
+ *
+ * Variables:
+ *      worker.id   - number, current worker id
+ *      worker.count
+ *                  - number, workers count
+ */
+
+#ifdef _WIN32
+#   error "worker module is not for win32"
+#else
+
+#include <astra.h>
+
+#include <signal.h>
+#include <sys/wait.h>
+
+#ifdef __linux__
+#   include <sched.h>
+#   include <sys/prctl.h>
+#endif
+
+extern char **environ;
+
+#define MSG(_msg) "[worker] " _msg
+
+/* worker id for the restarted process, see worker_respawn() */
+#define WORKER_ENV "ASTRA_WORKER_ID"
+
+/* interval to check the child processes in the parent process */
+#define WORKER_CHECK_INTERVAL 1000
+
+static int worker_id = 0;
+static int worker_count = 1;
+
+/* parent process only */
+static pid_t *worker_pid = NULL;
+static char **worker_argv = NULL;
+static asc_timer_t *worker_timer = NULL;
+
+static void worker_set_affinity(int id)
+{
+#ifdef __linux__
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if(cores <= 1)
+        return;
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(id % cores, &mask);
+    if(sched_setaffinity(0, sizeof(mask), &mask) == -1)
+        asc_log_error(MSG("failed to set CPU affinity [%s]"), strerror(errno));
+#else
+    __uarg(id);
+#endif
+}
+
+static void worker_set_parent(pid_t ppid)
+{
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    /* parent is terminated before prctl() */
+    if(getppid() != ppid)
+        _exit(0);
+#else
+    __uarg(ppid);
+#endif
+}
+
+/*
+ * Forked process has a copy of the parent state (Lua, channels, sockets),
+ * so the restarted worker is a new instance of the astra with the same
+ * arguments, except the options of the parent process (--pid).
+ * worker.fork() takes the worker id from the environment.
+ */
+static void worker_respawn(int id)
+{
+#ifdef __linux__
+    char env_id[32];
+    snprintf(env_id, sizeof(env_id), WORKER_ENV "=%d", id);
+
+    size_t env_count = 0;
+    while(environ[env_count])
+        ++env_count;
+
+    char **envp = (char **)calloc(env_count + 2, sizeof(char *));
+    asc_assert(envp != NULL, MSG("calloc() failed"));
+    memcpy(envp, environ, env_count * sizeof(char *));
+    envp[env_count] = env_id;
+
+    const pid_t ppid = getpid();
+    const pid_t pid = fork();
+    if(pid == 0)
+    {
+        worker_set_parent(ppid);
+
+        const long fd_max = sysconf(_SC_OPEN_MAX);
+        for(long fd = 3; fd < fd_max; ++fd)
+            close(fd);
+
+        execve("/proc/self/exe", worker_argv, envp);
+        _exit(1);
+    }
+
+    free(envp);
+
+    if(pid == -1)
+    {
+        /* try again on the next check */
+        asc_log_error(MSG("fork() failed [%s]"), strerror(errno));
+        return;
+    }
+
+    worker_pid[id] = pid;
+    asc_log_info(MSG("worker %d is restarted. pid:%d"), id, pid);
+#else
+    asc_log_error(MSG("worker %d is not restarted"), id);
+    worker_pid[id] = -1;
+#endif
+}
+
+static void on_worker_check(void *arg)
+{
+    __uarg(arg);
+
+    for(int id = 1; id < worker_count; ++id)
+    {
+        if(worker_pid[id] > 0)
+        {
+            int status = 0;
+            if(waitpid(worker_pid[id], &status, WNOHANG) != worker_pid[id])
+                continue;
+
+            if(WIFSIGNALED(status))
+                asc_log_error(MSG("worker %d is terminated by signal %d")
+                              , id, WTERMSIG(status));
+            else
+                asc_log_error(MSG("worker %d exited with status %d")
+                              , id, WEXITSTATUS(status));
+
+            worker_pid[id] = 0;
+        }
+
+        if(worker_pid[id] == 0)
+            worker_respawn(id);
+    }
+}
+
+/* options of the parent process only, with the argument */
+static const char *worker_parent_options[] = { "--pid", NULL };
+
+static bool worker_is_parent_option(const char *arg)
+{
+    for(int i = 0; worker_parent_options[i]; ++i)
+    {
+        if(!strcmp(arg, worker_parent_options[i]))
+            return true;
+    }
+    return false;
+}
+
+static void worker_save_argv(lua_State *L)
+{
+    lua_getglobal(L, "argv");
+    const int argc = (lua_type(L, -1) == LUA_TTABLE) ? luaL_len(L, -1) : 0;
+
+    worker_argv = (char **)calloc(argc + 2, sizeof(char *));
+    asc_assert(worker_argv != NULL, MSG("calloc() failed"));
+    worker_argv[0] = strdup("astra");
+
+    int count = 1;
+    for(int i = 1; i <= argc; ++i)
+    {
+        lua_rawgeti(L, -1, i);
+        const char *arg = luaL_checkstring(L, -1);
+        if(worker_is_parent_option(arg))
+            ++i; /* skip the option argument */
+        else
+            worker_argv[count++] = strdup(arg);
+        lua_pop(L, 1);
+    }
+
+    lua_pop(L, 1);
+}
+
+static int worker_fork(lua_State *L)
+{
+    const int count = luaL_checkinteger(L, 1);
+    if(count < 1)
+        luaL_error(L, MSG("workers count must be greater than 0"));
+
+    if(worker_count > 1)
+    {
+        /* astra.reload() in the worker, processes are already started */
+        if(count != worker_count)
+            luaL_error(L, MSG("workers count could not be changed on reload"));
+    }
+    else if(getenv(WORKER_ENV))
+    {
+        /* restarted worker, see worker_respawn() */
+        worker_id = atoi(getenv(WORKER_ENV));
+        worker_count = count;
+        unsetenv(WORKER_ENV);
+
+        if(worker_id < 1 || worker_id >= worker_count)
+            luaL_error(L, MSG("wrong worker id %d"), worker_id);
+
+        asc_log_info(MSG("started %d of %d. pid:%d"), worker_id, worker_count, getpid());
+    }
+    else if(count > 1)
+    {
+        worker_count = count;
+        worker_save_argv(L);
+
+        worker_pid = (pid_t *)calloc(count, sizeof(pid_t));
+        asc_assert(worker_pid != NULL, MSG("calloc() failed"));
+
+        const pid_t ppid = getpid();
+        for(int id = 1; id < count; ++id)
+        {
+            const pid_t pid = fork();
+            if(pid == -1)
+            {
+                asc_log_error(MSG("fork() failed [%s]"), strerror(errno));
+                astra_abort();
+            }
+
+            if(pid == 0)
+            {
+                worker_set_parent(ppid);
+
+                /* event observer descriptors are shared with the parent */
+                asc_event_core_destroy();
+                asc_event_core_init();
+
+                worker_id = id;
+                break;
+            }
+
+            worker_pid[id] = pid;
+        }
+
+        if(worker_id != 0)
+        {
+            free(worker_pid);
+            worker_pid = NULL;
+        }
+
+        asc_log_info(MSG("started %d of %d. pid:%d"), worker_id, worker_count, getpid());
+    }
+
+    worker_set_affinity(worker_id);
+
+    /* timer is destroyed on reload with the timer core */
+    if(worker_pid && !worker_timer)
+        worker_timer = asc_timer_init(WORKER_CHECK_INTERVAL, on_worker_check, NULL);
+
+    lua_getglobal(L, "worker");
+    lua_pushnumber(L, worker_id);
+    lua_setfield(L, -2, "id");
+    lua_pushnumber(L, worker_count);
+    lua_setfield(L, -2, "count");
+    lua_pop(L, 1);
+
+    lua_pushnumber(L, worker_id);
+    return 1;
+}
+
+LUA_API int luaopen_worker(lua_State *L)
+{
+    static const luaL_Reg api[] =
+    {
+        { "fork", worker_fork },
+        { NULL, NULL }
+    };
+
+    /* module is opened again on astra.reload() */
+    worker_timer = NULL;
+
+    luaL_newlib(L, api);
+
+    lua_pushnumber(L, worker_id);
+    lua_setfield(L, -2, "id");
+    lua_pushnumber(L, worker_count);
+    lua_setfield(L, -2, "count");
+
+    lua_setglobal(L, "worker");
+
+    return 1;
+}
+
+#endif
@@ -93,10 +93,10 @@ static void on_thread_read(void *arg)
 {
     module_data_t *mod = arg;
 
-    uint8_t ts[TS_PACKET_SIZE];
+    uint8_t ts[TS_PACKET_SIZE * 32];
     const ssize_t r = asc_thread_buffer_read(mod->sec_thread_output, ts, sizeof(ts));
-    if(r == sizeof(ts))
-        module_stream_send(mod, ts);
+    if(r >= TS_PACKET_SIZE)
+        module_stream_send_batch(mod, ts, r / TS_PACKET_SIZE);
 }
 
 static void thread_loop(void *arg)
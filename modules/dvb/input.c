@@ -27,6 +27,9 @@
 
 #define MSG(_msg) "[dvb_input %d:%d] " _msg, mod->adapter, mod->device
 
+#define DVR_BUFFER_SIZE (1022 * TS_PACKET_SIZE)
+#define DVR_SLAB_POOL 4
+
 struct module_data_t
 {
     MODULE_STREAM_DATA();
@@ -48,7 +51,8 @@ struct module_data_t
     /* DVR Base */
     int dvr_fd;
     asc_event_t *dvr_event;
-    uint8_t dvr_buffer[1022 * TS_PACKET_SIZE];
+    stream_slab_pool_t *dvr_pool;
+    stream_slab_t *dvr_slab;
 
     uint32_t dvr_read;
 
@@ -135,7 +139,14 @@ static void dvr_on_read(void *arg)
 {
     module_data_t *mod = (module_data_t *)arg;
 
-    const ssize_t len = read(mod->dvr_fd, mod->dvr_buffer, sizeof(mod->dvr_buffer));
+    if(stream_slab_is_shared(mod->dvr_slab))
+    {
+        stream_slab_unref(mod->dvr_slab);
+        mod->dvr_slab = stream_slab_pool_get(mod->dvr_pool);
+    }
+    uint8_t *const dvr_buffer = mod->dvr_slab->buffer;
+
+    const ssize_t len = read(mod->dvr_fd, dvr_buffer, DVR_BUFFER_SIZE);
     if(len <= 0)
     {
         dvr_on_error(mod);
@@ -143,18 +154,19 @@ static void dvr_on_read(void *arg)
     }
     mod->dvr_read += len;
 
-    for(int i = 0; i < len; i += TS_PACKET_SIZE)
+    const size_t count = len / TS_PACKET_SIZE;
+    for(size_t i = 0; i < count; ++i)
     {
-        const uint8_t *ts = &mod->dvr_buffer[i];
+        const uint8_t *ts = &dvr_buffer[i * TS_PACKET_SIZE];
 
         if(mod->ca->ca_fd > 0)
             ca_on_ts(mod->ca, ts);
 
-        module_stream_send(mod, ts);
-
         if(TS_IS_SYNC(ts) && TS_GET_PID(ts) == 0)
             mpegts_psi_mux(mod->pat, ts, on_pat, mod);
     }
+
+    module_stream_send_slab(mod, mod->dvr_slab, dvr_buffer, count);
 }
 
 static void dvr_open(module_data_t *mod)
@@ -983,7 +995,7 @@ static void on_status_timer(void *arg)
     lua_setfield(lua, -2, "ber");
     lua_pushnumber(lua, mod->fe->unc);
     lua_setfield(lua, -2, "unc");
-    lua_call(lua, 1, 0);
+    module_lua_call(1, 0);
 }
 
 static int method_ca_set_pnr(module_data_t *mod)
@@ -1003,6 +1015,8 @@ static int method_close(module_data_t *mod)
     on_thread_close(mod);
 
     ASC_FREE(mod->pat, mpegts_psi_destroy);
+    ASC_FREE(mod->dvr_slab, stream_slab_unref);
+    ASC_FREE(mod->dvr_pool, stream_slab_pool_destroy);
     ASC_FREE(mod->fe, free);
     ASC_FREE(mod->ca, free);
     ASC_FREE(mod->status_timer, asc_timer_destroy);
@@ -1048,6 +1062,8 @@ static void module_init(module_data_t *mod)
         lua_pop(lua, 1);
 
     mod->pat = mpegts_psi_init(MPEGTS_PACKET_PAT, 0);
+    mod->dvr_pool = stream_slab_pool_init(DVR_BUFFER_SIZE, DVR_SLAB_POOL);
+    mod->dvr_slab = stream_slab_pool_get(mod->dvr_pool);
 
     if(!mod->no_dvr)
     {
@@ -319,7 +319,7 @@ static void on_thread_close(void *arg)
     if(mod->is_eof && mod->idx_callback)
     {
         lua_rawgeti(lua, LUA_REGISTRYINDEX, mod->idx_callback);
-        lua_call(lua, 0, 0);
+        module_lua_call(0, 0);
     }
 }
 
@@ -327,12 +327,10 @@ static void on_thread_read(void *arg)
 {
     module_data_t *mod = (module_data_t *)arg;
 
-    uint8_t ts[TS_PACKET_SIZE];
-    const ssize_t r = asc_thread_buffer_read(mod->thread_output, ts, TS_PACKET_SIZE);
-    if(r != TS_PACKET_SIZE)
-        return;
-
-    module_stream_send(mod, ts);
+    uint8_t ts[TS_PACKET_SIZE * 32];
+    const ssize_t r = asc_thread_buffer_read(mod->thread_output, ts, sizeof(ts));
+    if(r >= TS_PACKET_SIZE)
+        module_stream_send_batch(mod, ts, r / TS_PACKET_SIZE);
 }
 
 static void timer_skip_set(void *arg)
@@ -21,8 +21,13 @@ struct http_client_t
 
     char buffer[HTTP_BUFFER_SIZE];
     size_t buffer_skip;
+    size_t buffer_scan; // search of the empty line is resumed from this position
     size_t chunk_left;
 
+    // pipelined requests received with the current request
+    char *pipeline;
+    size_t pipeline_size;
+
     // request
     int status;         // 1 - empty line is found, 2 - request ready, 3 - release
     int idx_request;
@@ -30,14 +35,25 @@ struct http_client_t
 
     bool is_head;
     bool is_content_length;
+    bool is_chunked;
+    int chunk_state;
     string_buffer_t *content;
 
+    // persistent connection
+    bool is_keep_alive;
+    bool is_http_1_0;   // keep-alive should be confirmed in the response
+    asc_timer_t *idle_timer;
+
     // response
     event_callback_t on_send;
     event_callback_t on_read;
     event_callback_t on_ready;
+    event_callback_t on_stat;   // pushes response statistics, see :stat()
     http_response_t *response;
 
+    bool is_response_framed;    // length of the response body is known
+    bool is_response_connection;
+
     int idx_content;
 };
 
@@ -46,6 +62,7 @@ struct http_client_t
 void http_response_code(http_client_t *client, int code, const char *message);
 void http_response_header(http_client_t *client, const char *header, ...);
 void http_response_send(http_client_t *client);
+void http_response_done(http_client_t *client);
 
 void http_client_warning(http_client_t *client, const char *message, ...);
 void http_client_error(http_client_t *client, const char *message, ...);
@@ -74,21 +74,21 @@ static void on_downstream_read(void *arg)
         }
     }
 
-    while(skip < size)
+    if(skip < size)
     {
-        const uint8_t *ts = (const uint8_t *)&client->buffer[skip];
+        const size_t count = (size - skip) / TS_PACKET_SIZE;
+        if(count > 0)
+        {
+            module_stream_send_batch(  client->response
+                                     , (const uint8_t *)&client->buffer[skip], count);
+            skip += count * TS_PACKET_SIZE;
+        }
 
         const size_t remain = size - skip;
-        if(remain < TS_PACKET_SIZE)
+        if(remain > 0)
         {
-            memcpy(client->response->buffer, ts, remain);
+            memcpy(client->response->buffer, &client->buffer[skip], remain);
             client->response->buffer_skip = remain;
-            break;
-        }
-        else
-        {
-            module_stream_send(client->response, ts);
-            skip += TS_PACKET_SIZE;
         }
     }
 }
@@ -145,7 +145,7 @@ static int module_call(module_data_t *mod)
             lua_pushvalue(lua, 2);
             lua_pushvalue(lua, 3);
             lua_pushvalue(lua, 4);
-            lua_call(lua, 3, 0);
+            module_lua_call(3, 0);
 
             module_stream_destroy(client->response);
 
@@ -174,7 +174,7 @@ static int module_call(module_data_t *mod)
     lua_pushvalue(lua, 2);
     lua_pushvalue(lua, 3);
     lua_pushvalue(lua, 4);
-    lua_call(lua, 3, 0);
+    module_lua_call(3, 0);
 
     return 0;
 }
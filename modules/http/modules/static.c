@@ -130,7 +130,7 @@ static void on_ready_send_file(void *arg)
     response->file_skip += send_size;
 
     if(response->file_skip >= response->file_size)
-        http_client_close(client);
+        http_response_done(client);
 }
 
 static const char * lua_get_mime(http_client_t *client, const char *path)
@@ -21,6 +21,10 @@
 #include <astra.h>
 #include "../http.h"
 
+#ifndef _WIN32
+#   include <sys/mman.h>
+#endif
+
 #define DEFAULT_BUFFER_SIZE (1024 * 1024)
 #define DEFAULT_BUFFER_FILL (128 * 1024)
 
@@ -29,52 +33,580 @@ struct module_data_t
     int idx_callback;
 };
 
-struct http_response_t
+/*
+ * One ring for all clients of the same upstream. Packets are copied once,
+ * each client has own read cursor. Cursors are absolute byte offsets,
+ * position in the buffer is offset % buffer_size
+ */
+
+typedef struct http_ring_t http_ring_t;
+
+/*
+ * Fast channel start. Last PAT, PMT and offset of the last random access
+ * point of the video in the ring. New client receives PSI and then data
+ * from the ring starting with the keyframe
+ */
+
+#define START_RAP_NONE UINT64_MAX
+
+typedef struct
+{
+    mpegts_psi_t *pat;
+    mpegts_psi_t *pmt;
+
+    // last valid sections
+    mpegts_psi_t *pat_cache;
+    mpegts_psi_t *pmt_cache;
+
+    uint16_t video_pid;
+    uint8_t video_type;
+
+    uint64_t rap;
+} http_start_t;
+
+struct http_ring_t
 {
     MODULE_STREAM_DATA();
 
+    uint8_t *buffer;
+    size_t buffer_size;
+    uint64_t write;
+
+    // bytes per second, to show client lag in ms
+    uint64_t rate;
+    uint64_t rate_time;
+    uint64_t rate_write;
+
+    int refcount;
+
+    http_start_t *start;
+
+    // clients without pending data, waiting for buffer_fill
+    TAILQ_HEAD(, http_response_t) wait_list;
+
+    // clients with MSG_ZEROCOPY
+    TAILQ_HEAD(, http_response_t) zerocopy_list;
+
+    http_ring_t *next;
+};
+
+/*
+ * Slow client. Overflow - lag of the client reaches buffer_size:
+ * live - resume from the live position
+ * keyframe - resume from the last keyframe, or wait for the next one
+ * With drop_pids client receives only PSI and video while lag is greater
+ * than a half of the buffer. Stream without video (or before the PMT) is sent
+ * as is. Client is closed after overflow_limit overflows
+ */
+
+typedef enum
+{
+    OVERFLOW_LIVE = 0,
+    OVERFLOW_KEYFRAME = 1,
+} http_overflow_t;
+
+#define QUEUE_SIZE (TS_PACKET_SIZE * 128)
+
+/*
+ * MSG_ZEROCOPY. Kernel sends data directly from the ring. The send is pending
+ * until the kernel completes it and the ring memory should not be changed.
+ * Before the write the ring checks pending data of the clients: zerocopy is
+ * disabled for the client if the data is older than a half of the ring,
+ * connection is reset (send queue is discarded) before the data is
+ * overwritten. Small blocks are copied
+ */
+
+#define ZEROCOPY_MAX 64
+#define ZEROCOPY_MIN (16 * 1024)
+
+struct http_response_t
+{
     module_data_t *mod;
+    http_client_t *client;
 
-    uint8_t *buffer;
-    size_t buffer_count;
-    size_t buffer_read;
-    size_t buffer_write;
+    http_ring_t *ring;
+    uint64_t read;
 
     size_t buffer_size;
     size_t buffer_fill;
 
+    // own data of the client: PSI for the start or filtered packets
+    uint8_t *queue;
+    size_t queue_size;
+    size_t queue_skip;
+    size_t queue_alloc;
+
+    http_overflow_t overflow;
+    int overflow_limit;
+    int overflow_count;
+    bool is_drop_pids;
+    bool is_drop;
+    bool is_wait_rap;
+    uint64_t drop_count;
+
+    bool is_zerocopy;
+    bool is_zerocopy_entry; // in ring->zerocopy_list
+    bool is_reset;
+    uint32_t zerocopy_id; // first pending send
+    uint64_t zerocopy_list[ZEROCOPY_MAX]; // offset of the first byte of the send
+    TAILQ_ENTRY(http_response_t) zerocopy_entry;
+
     bool is_socket_busy;
+    TAILQ_ENTRY(http_response_t) entry;
 };
 
+static http_ring_t *ring_list = NULL;
+
 /*
  * client->mod - http_server module
  * client->response->mod - http_upstream module
  */
 
+/*
+ *  oooooooo8 ooooooooooo   o      oooooooooo  ooooooooooo
+ * 888        88  888  88  888      888    888 88  888  88
+ *  888oooooo     888     8  88     888oooo88      888
+ *         888    888    8oooo88    888  88o       888
+ * o88oooo888    o888o o88o  o888o o888o  88o8    o888o
+ *
+ */
+
+static void on_start_pat(void *arg, mpegts_psi_t *psi)
+{
+    http_start_t *start = (http_start_t *)arg;
+
+    if(psi->buffer[0] != 0x00)
+        return;
+
+    const uint32_t crc32 = PSI_GET_CRC32(psi);
+    if(crc32 == start->pat_cache->crc32)
+        return;
+    if(crc32 != PSI_CALC_CRC32(psi))
+        return;
+
+    uint16_t pmt_pid = MAX_PID;
+    const uint8_t *pointer;
+    PAT_ITEMS_FOREACH(psi, pointer)
+    {
+        if(PAT_ITEM_GET_PNR(psi, pointer) != 0)
+        {
+            pmt_pid = PAT_ITEM_GET_PID(psi, pointer);
+            break;
+        }
+    }
+
+    memcpy(start->pat_cache->buffer, psi->buffer, psi->buffer_size);
+    start->pat_cache->buffer_size = psi->buffer_size;
+    start->pat_cache->crc32 = crc32;
+
+    if(pmt_pid != start->pmt->pid)
+    {
+        start->pmt->pid = pmt_pid;
+        start->pmt->buffer_skip = 0;
+        start->pmt_cache->pid = pmt_pid;
+        start->pmt_cache->buffer_size = 0;
+        start->pmt_cache->crc32 = 0;
+        start->video_pid = MAX_PID;
+        start->rap = START_RAP_NONE;
+    }
+}
+
+static void on_start_pmt(void *arg, mpegts_psi_t *psi)
+{
+    http_start_t *start = (http_start_t *)arg;
+
+    if(psi->buffer[0] != 0x02)
+        return;
+
+    const uint32_t crc32 = PSI_GET_CRC32(psi);
+    if(crc32 == start->pmt_cache->crc32)
+        return;
+    if(crc32 != PSI_CALC_CRC32(psi))
+        return;
+
+    uint16_t video_pid = MAX_PID;
+    uint8_t video_type = 0;
+    const uint8_t *pointer;
+    PMT_ITEMS_FOREACH(psi, pointer)
+    {
+        const uint8_t type = PMT_ITEM_GET_TYPE(psi, pointer);
+        if(mpegts_pes_type(type) == MPEGTS_PACKET_VIDEO)
+        {
+            video_pid = PMT_ITEM_GET_PID(psi, pointer);
+            video_type = type;
+            break;
+        }
+    }
+
+    memcpy(start->pmt_cache->buffer, psi->buffer, psi->buffer_size);
+    start->pmt_cache->buffer_size = psi->buffer_size;
+    start->pmt_cache->crc32 = crc32;
+
+    if(video_pid != start->video_pid)
+    {
+        start->video_pid = video_pid;
+        start->video_type = video_type;
+        start->rap = START_RAP_NONE;
+    }
+}
+
+/* random_access_indicator or the keyframe in the first packet of PES */
+static bool start_is_rap(http_start_t *start, const uint8_t *ts)
+{
+    if(TS_IS_AF(ts) && ts[4] > 0 && (ts[5] & 0x40))
+        return true;
+
+    const uint8_t *payload = TS_GET_PAYLOAD(ts);
+    if(!payload)
+        return false;
+
+    const uint8_t *const end = &ts[TS_PACKET_SIZE];
+    if(end - payload < 9 || PES_BUFFER_GET_HEADER(payload) != 0x000001)
+        return false;
+
+    const uint8_t *es = &payload[9 + payload[8]];
+    for(; es + 4 <= end; ++es)
+    {
+        if(es[0] != 0x00 || es[1] != 0x00 || es[2] != 0x01)
+            continue;
+
+        switch(start->video_type)
+        {
+            case 0x01:
+            case 0x02:
+                // sequence header
+                if(es[3] == 0xB3)
+                    return true;
+                break;
+            case 0x1B:
+            {
+                // IDR, SPS
+                const uint8_t nal_type = es[3] & 0x1F;
+                if(nal_type == 5 || nal_type == 7)
+                    return true;
+                break;
+            }
+            case 0x24:
+            {
+                // IRAP, VPS, SPS
+                const uint8_t nal_type = (es[3] >> 1) & 0x3F;
+                if((nal_type >= 16 && nal_type <= 21) || nal_type == 32 || nal_type == 33)
+                    return true;
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    return false;
+}
+
+/* offset - position of the packet in the ring */
+static void start_push(http_start_t *start, const uint8_t *ts, uint64_t offset)
+{
+    const uint16_t pid = TS_GET_PID(ts);
+
+    if(pid == start->video_pid)
+    {
+        if(TS_IS_PAYLOAD_START(ts) && start_is_rap(start, ts))
+            start->rap = offset;
+    }
+    else if(pid == 0)
+    {
+        mpegts_psi_mux(start->pat, ts, on_start_pat, start);
+    }
+    else if(pid == start->pmt->pid)
+    {
+        mpegts_psi_mux(start->pmt, ts, on_start_pmt, start);
+    }
+}
+
+static http_start_t * start_init(void)
+{
+    http_start_t *start = (http_start_t *)calloc(1, sizeof(http_start_t));
+    start->pat = mpegts_psi_init(MPEGTS_PACKET_PAT, 0);
+    start->pmt = mpegts_psi_init(MPEGTS_PACKET_PMT, MAX_PID);
+    start->pat_cache = mpegts_psi_init(MPEGTS_PACKET_PAT, 0);
+    start->pmt_cache = mpegts_psi_init(MPEGTS_PACKET_PMT, MAX_PID);
+    start->video_pid = MAX_PID;
+    start->rap = START_RAP_NONE;
+    return start;
+}
+
+static void start_destroy(http_start_t *start)
+{
+    mpegts_psi_destroy(start->pat);
+    mpegts_psi_destroy(start->pmt);
+    mpegts_psi_destroy(start->pat_cache);
+    mpegts_psi_destroy(start->pmt_cache);
+    free(start);
+}
+
+static uint8_t * response_queue_alloc(http_response_t *response, size_t size)
+{
+    if(response->queue_size + size > response->queue_alloc)
+    {
+        response->queue_alloc += QUEUE_SIZE;
+        response->queue = (uint8_t *)realloc(response->queue, response->queue_alloc);
+    }
+
+    uint8_t *data = &response->queue[response->queue_size];
+    response->queue_size += size;
+    return data;
+}
+
+static void response_queue(void *arg, const uint8_t *ts)
+{
+    http_response_t *response = (http_response_t *)arg;
+    memcpy(response_queue_alloc(response, TS_PACKET_SIZE), ts, TS_PACKET_SIZE);
+}
+
+/* moves client to the last keyframe if lag is less than limit. PSI is queued */
+static bool start_prime(http_ring_t *ring, http_response_t *response, uint64_t limit)
+{
+    const http_start_t *start = ring->start;
+
+    if(   start->rap == START_RAP_NONE
+       || ring->write - start->rap >= limit
+       || start->pat_cache->buffer_size == 0
+       || start->pmt_cache->buffer_size == 0)
+    {
+        return false;
+    }
+
+    mpegts_psi_demux(start->pat_cache, response_queue, response);
+    mpegts_psi_demux(start->pmt_cache, response_queue, response);
+    response->read = start->rap;
+
+    return true;
+}
+
+/*
+ *  oooooooo8 ooooo       ooooooo  oooo     oooo
+ * 888         888      o888   888o 88   88  88
+ *  888oooooo  888      888     888  88 888 88
+ *         888 888      888o   o888   888 888
+ * o88oooo888 o888ooooo88 88ooo88      8   8
+ *
+ */
+
+static void on_upstream_ready(void *arg);
+
+static void response_wait(http_response_t *response)
+{
+    if(response->is_socket_busy)
+    {
+        asc_socket_set_on_ready(response->client->sock, NULL);
+        response->is_socket_busy = false;
+        TAILQ_INSERT_TAIL(&response->ring->wait_list, response, entry);
+    }
+}
+
+static void response_resume(http_response_t *response)
+{
+    TAILQ_REMOVE(&response->ring->wait_list, response, entry);
+    asc_socket_set_on_ready(response->client->sock, on_upstream_ready);
+    response->is_socket_busy = true;
+}
+
+/* offset of the first byte not completed by the kernel */
+static uint64_t response_release(http_response_t *response)
+{
+    asc_socket_t *sock = response->client->sock;
+
+    const uint32_t sent = asc_socket_zerocopy_sent(sock);
+    const uint32_t done = asc_socket_zerocopy_done(sock);
+    if((int32_t)(done - response->zerocopy_id) > 0)
+        response->zerocopy_id = done;
+
+    if(response->zerocopy_id == sent)
+        return response->read;
+
+    return response->zerocopy_list[response->zerocopy_id % ZEROCOPY_MAX];
+}
+
+/* returns false if client is closed */
+static bool response_overflow(http_response_t *response)
+{
+    http_client_t *client = response->client;
+    http_ring_t *ring = response->ring;
+
+    ++response->overflow_count;
+    if(response->overflow_limit > 0 && response->overflow_count >= response->overflow_limit)
+    {
+        http_client_warning(client, "client is too slow. overflow limit is reached");
+        http_client_close(client);
+        return false;
+    }
+
+    response->is_drop = false;
+
+    const size_t tail = response->read % TS_PACKET_SIZE;
+    if(tail > 0)
+    {
+        // rest of the partially sent packet keeps the stream aligned
+        const size_t size = TS_PACKET_SIZE - tail;
+        uint8_t *data = response_queue_alloc(response, size);
+        if(ring->write - response->read <= ring->buffer_size)
+            memcpy(data, &ring->buffer[response->read % ring->buffer_size], size);
+        else
+            memset(data, 0xFF, size);
+    }
+
+    if(   response->overflow == OVERFLOW_KEYFRAME
+       && ring->start->video_pid != MAX_PID)
+    {
+        if(start_prime(ring, response, response->buffer_size / 2))
+            return true;
+
+        response->read = ring->write;
+        response->is_wait_rap = true;
+    }
+    else
+    {
+        response->read = ring->write;
+    }
+
+    response_wait(response);
+    return true;
+}
+
+/* PSI and video packets into the queue. read is aligned to the packet */
+static void response_filter(http_response_t *response)
+{
+    http_ring_t *ring = response->ring;
+    const http_start_t *start = ring->start;
+
+    while(response->read < ring->write && response->queue_size < QUEUE_SIZE)
+    {
+        const uint8_t *ts = &ring->buffer[response->read % ring->buffer_size];
+        response->read += TS_PACKET_SIZE;
+
+        const uint16_t pid = TS_GET_PID(ts);
+        if(pid == 0 || pid == start->pmt->pid || pid == start->video_pid)
+            response_queue(response, ts);
+        else
+            ++response->drop_count;
+    }
+}
+
 static void on_upstream_ready(void *arg)
 {
     http_client_t *client = (http_client_t *)arg;
     http_response_t *response = client->response;
+    http_ring_t *ring = response->ring;
 
-    if(response->buffer_count > 0)
+    if(response->is_reset)
     {
-        size_t block_size = (response->buffer_write > response->buffer_read)
-                          ? (response->buffer_write - response->buffer_read)
-                          : (response->buffer_size - response->buffer_read);
-
-        if(block_size > response->buffer_count)
-            block_size = response->buffer_count;
+        http_client_close(client);
+        return;
+    }
 
+    if(response->queue_skip < response->queue_size)
+    {
         const ssize_t send_size = asc_socket_send(  client->sock
-                                                  , &response->buffer[response->buffer_read]
-                                                  , block_size);
+                                                  , &response->queue[response->queue_skip]
+                                                  , response->queue_size - response->queue_skip);
+        if(send_size == -1)
+        {
+            http_client_error(client, "failed to send ts [%s]", asc_socket_error());
+            http_client_close(client);
+            return;
+        }
+
+        response->queue_skip += send_size;
+        if(response->queue_skip == response->queue_size)
+        {
+            response->queue_size = 0;
+            response->queue_skip = 0;
+        }
+        return;
+    }
+
+    const uint64_t count = ring->write - response->read;
+    const uint64_t release = (response->is_zerocopy)
+                           ? response_release(response)
+                           : response->read;
+
+    if(count >= response->buffer_size)
+    {
+        response_overflow(response);
+        return;
+    }
+
+    if(response->is_drop_pids)
+    {
+        // nothing to keep without video
+        if(ring->start->video_pid == MAX_PID)
+            response->is_drop = false;
+        else if(count > response->buffer_size / 2)
+            response->is_drop = true;
+        else if(count < response->buffer_fill)
+            response->is_drop = false;
+    }
+
+    if(response->is_drop && (response->read % TS_PACKET_SIZE) == 0)
+    {
+        response_filter(response);
+        if(response->queue_size > 0)
+            return;
+    }
+    else if(count > 0)
+    {
+        // wrapped data is sent with one call
+        struct iovec iov[2];
+        int iov_count = 1;
+
+        const size_t buffer_read = response->read % ring->buffer_size;
+        size_t block_size = count;
+        if(response->is_drop)
+        {
+            // rest of the partially sent packet
+            block_size = TS_PACKET_SIZE - (response->read % TS_PACKET_SIZE);
+        }
+
+        iov[0].iov_base = &ring->buffer[buffer_read];
+        iov[0].iov_len = ring->buffer_size - buffer_read;
+        if(iov[0].iov_len >= block_size)
+        {
+            iov[0].iov_len = block_size;
+        }
+        else
+        {
+            iov[1].iov_base = ring->buffer;
+            iov[1].iov_len = block_size - iov[0].iov_len;
+            iov_count = 2;
+        }
+
+        // pending data is limited to keep lag of the client
+        const bool is_zerocopy = (   response->is_zerocopy
+                                  && block_size >= ZEROCOPY_MIN
+                                  && response->read + block_size - release
+                                     <= response->buffer_size / 4);
+
+        ssize_t send_size;
+        if(is_zerocopy)
+        {
+            const uint32_t id = asc_socket_zerocopy_sent(client->sock);
+            if(id - response->zerocopy_id < ZEROCOPY_MAX)
+            {
+                response->zerocopy_list[id % ZEROCOPY_MAX] = response->read;
+                send_size = asc_socket_sendv_zerocopy(client->sock, iov, iov_count);
+            }
+            else
+            {
+                send_size = asc_socket_sendv(client->sock, iov, iov_count);
+            }
+        }
+        else
+        {
+            send_size = asc_socket_sendv(client->sock, iov, iov_count);
+        }
 
         if(send_size > 0)
         {
-            response->buffer_count -= send_size;
-            response->buffer_read += send_size;
-            if(response->buffer_read >= response->buffer_size)
-                response->buffer_read = 0;
+            response->read += send_size;
         }
         else if(send_size == -1)
         {
@@ -85,58 +617,261 @@ static void on_upstream_ready(void *arg)
         }
     }
 
-    if(response->buffer_count == 0)
-    {
-        asc_socket_set_on_ready(client->sock, NULL);
-        response->is_socket_busy = false;
-    }
+    if(response->read == ring->write)
+        response_wait(response);
 }
 
-static void on_ts(void *arg, const uint8_t *ts)
+static void on_upstream_stat(void *arg)
 {
     http_client_t *client = (http_client_t *)arg;
     http_response_t *response = client->response;
+    http_ring_t *ring = response->ring;
 
-    if(response->buffer_count + TS_PACKET_SIZE >= response->buffer_size)
+    const uint64_t lag = ring->write - response->read
+                       + response->queue_size - response->queue_skip;
+
+    lua_newtable(lua);
+    lua_pushnumber(lua, lag);
+    lua_setfield(lua, -2, "lag");
+    lua_pushnumber(lua, (ring->rate > 0) ? (lag * 1000 / ring->rate) : 0);
+    lua_setfield(lua, -2, "lag_ms");
+    lua_pushnumber(lua, response->overflow_count);
+    lua_setfield(lua, -2, "overflow");
+    lua_pushnumber(lua, response->drop_count);
+    lua_setfield(lua, -2, "drop");
+}
+
+/* pending data of the zerocopy clients before the ring is written up to the write offset */
+static void ring_zerocopy_check(http_ring_t *ring, uint64_t write)
+{
+    http_response_t *response;
+    TAILQ_FOREACH(response, &ring->zerocopy_list, zerocopy_entry)
     {
-        // overflow
-        response->buffer_count = 0;
-        response->buffer_read = 0;
-        response->buffer_write = 0;
-        if(response->is_socket_busy)
+        if(response->is_reset)
+            continue;
+
+        asc_socket_t *sock = response->client->sock;
+        if(response->zerocopy_id == asc_socket_zerocopy_sent(sock))
+            continue;
+
+        // cached offset is not newer than the actual one
+        const uint64_t pending = response->zerocopy_list[response->zerocopy_id % ZEROCOPY_MAX];
+        if(write - pending <= ring->buffer_size / 2)
+            continue;
+
+        const uint64_t release = response_release(response);
+        if(response->zerocopy_id == asc_socket_zerocopy_sent(sock))
+            continue;
+        if(write - release <= ring->buffer_size / 2)
+            continue;
+
+        if(response->is_zerocopy)
         {
-            asc_socket_set_on_ready(client->sock, NULL);
-            response->is_socket_busy = false;
+            http_client_warning(response->client, "client is too slow. zerocopy is disabled");
+            response->is_zerocopy = false;
+        }
+
+        if(write - release > ring->buffer_size)
+        {
+            // closed on the next event, the ring is not changed in the stream callback
+            http_client_warning(response->client, "client is too slow. connection is reset");
+            asc_socket_reset(sock);
+            response->is_reset = true;
+            if(!response->is_socket_busy)
+                response_resume(response);
         }
-        return;
     }
+}
+
+static void on_ts_batch(void *arg, const uint8_t *ts, size_t count)
+{
+    http_ring_t *ring = (http_ring_t *)arg;
 
-    const size_t buffer_write = response->buffer_write + TS_PACKET_SIZE;
-    if(buffer_write < response->buffer_size)
+    size_t size = count * TS_PACKET_SIZE;
+    if(size > ring->buffer_size)
     {
-        memcpy(&response->buffer[response->buffer_write], ts, TS_PACKET_SIZE);
-        response->buffer_write = buffer_write;
+        // keep the tail only
+        ts += size - ring->buffer_size;
+        ring->write += size - ring->buffer_size;
+        size = ring->buffer_size;
     }
-    else if(buffer_write > response->buffer_size)
+
+    if(!TAILQ_EMPTY(&ring->zerocopy_list))
+        ring_zerocopy_check(ring, ring->write + size);
+
+    if(ring->start)
     {
-        const size_t ts_head = response->buffer_size - response->buffer_write;
-        memcpy(&response->buffer[response->buffer_write], ts, ts_head);
-        response->buffer_write = TS_PACKET_SIZE - ts_head;
-        memcpy(response->buffer, &ts[ts_head], response->buffer_write);
+        for(size_t i = 0; i < size; i += TS_PACKET_SIZE)
+            start_push(ring->start, &ts[i], ring->write + i);
+    }
+
+    const uint64_t now = asc_utime();
+    if(now - ring->rate_time >= 1000000)
+    {
+        if(ring->rate_time > 0)
+            ring->rate = (ring->write - ring->rate_write) * 1000000 / (now - ring->rate_time);
+        ring->rate_time = now;
+        ring->rate_write = ring->write;
+    }
+
+    const size_t buffer_write = ring->write % ring->buffer_size;
+    const size_t ts_head = ring->buffer_size - buffer_write;
+    if(size <= ts_head)
+    {
+        memcpy(&ring->buffer[buffer_write], ts, size);
     }
     else
     {
-        memcpy(&response->buffer[response->buffer_write], ts, TS_PACKET_SIZE);
-        response->buffer_write = 0;
+        memcpy(&ring->buffer[buffer_write], ts, ts_head);
+        memcpy(ring->buffer, &ts[ts_head], size - ts_head);
     }
-    response->buffer_count += TS_PACKET_SIZE;
+    ring->write += size;
 
-    if(   response->is_socket_busy == false
-       && response->buffer_count >= response->buffer_fill)
+    http_response_t *response, *response_next;
+    TAILQ_FOREACH_SAFE(response, &ring->wait_list, entry, response_next)
     {
-        asc_socket_set_on_ready(client->sock, on_upstream_ready);
-        response->is_socket_busy = true;
+        if(response->is_wait_rap)
+        {
+            const uint64_t rap = ring->start->rap;
+            if(rap != START_RAP_NONE && rap >= response->read)
+            {
+                response->is_wait_rap = false;
+                start_prime(ring, response, response->buffer_size);
+                response_resume(response);
+            }
+            else if(ring->write - response->read >= response->buffer_size / 2)
+            {
+                // no keyframes. continue from the live position
+                response->is_wait_rap = false;
+                response->read = ring->write;
+            }
+        }
+        else if(ring->write - response->read >= response->buffer_fill)
+        {
+            response_resume(response);
+        }
+    }
+}
+
+static void on_ts(void *arg, const uint8_t *ts)
+{
+    on_ts_batch(arg, ts, 1);
+}
+
+/*
+ * pages pinned by the pending MSG_ZEROCOPY sends are kept by the kernel
+ * after munmap() and could not be reused by the next allocation
+ */
+static uint8_t * ring_buffer_alloc(size_t size)
+{
+#ifndef _WIN32
+    void *buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    asc_assert(buffer != MAP_FAILED, "[http_upstream] failed to allocate ring [%s]"
+               , strerror(errno));
+    return (uint8_t *)buffer;
+#else
+    return (uint8_t *)malloc(size);
+#endif
+}
+
+static void ring_buffer_free(uint8_t *buffer, size_t size)
+{
+#ifndef _WIN32
+    munmap(buffer, size);
+#else
+    __uarg(size);
+    free(buffer);
+#endif
+}
+
+/* keeps data of the active clients */
+static void ring_resize(http_ring_t *ring, size_t buffer_size)
+{
+    uint8_t *buffer = ring_buffer_alloc(buffer_size);
+
+    size_t size = (ring->write < ring->buffer_size) ? ring->write : ring->buffer_size;
+    for(uint64_t i = ring->write - size; i < ring->write; )
+    {
+        const size_t src = i % ring->buffer_size;
+        const size_t dst = i % buffer_size;
+        size_t block_size = ring->write - i;
+        if(block_size > ring->buffer_size - src)
+            block_size = ring->buffer_size - src;
+        if(block_size > buffer_size - dst)
+            block_size = buffer_size - dst;
+
+        memcpy(&buffer[dst], &ring->buffer[src], block_size);
+        i += block_size;
+    }
+
+    ring_buffer_free(ring->buffer, ring->buffer_size);
+    ring->buffer = buffer;
+    ring->buffer_size = buffer_size;
+}
+
+static http_ring_t * ring_attach(  module_stream_t *upstream, size_t buffer_size
+                                 , bool is_start)
+{
+    // packets are not wrapped in the ring
+    buffer_size = (buffer_size + TS_PACKET_SIZE - 1) / TS_PACKET_SIZE * TS_PACKET_SIZE;
+
+    http_ring_t *ring = ring_list;
+    for(; ring; ring = ring->next)
+    {
+        if(ring->__stream.parent == upstream)
+            break;
+    }
+
+    if(!ring)
+    {
+        ring = (http_ring_t *)calloc(1, sizeof(http_ring_t));
+        ring->buffer = ring_buffer_alloc(buffer_size);
+        ring->buffer_size = buffer_size;
+        TAILQ_INIT(&ring->wait_list);
+        TAILQ_INIT(&ring->zerocopy_list);
+
+        // like module_stream_init()
+        ring->__stream.self = (module_data_t *)ring;
+        ring->__stream.on_ts = (void (*)(module_data_t *, const uint8_t *))on_ts;
+        ring->__stream.on_ts_batch =
+            (void (*)(module_data_t *, const uint8_t *, size_t))on_ts_batch;
+        __module_stream_init(&ring->__stream);
+        __module_stream_attach(upstream, &ring->__stream);
+
+        ring->next = ring_list;
+        ring_list = ring;
+    }
+    else if(ring->buffer_size < buffer_size)
+    {
+        ring_resize(ring, buffer_size);
+    }
+
+    if(is_start && !ring->start)
+        ring->start = start_init();
+
+    ++ring->refcount;
+    return ring;
+}
+
+static void ring_detach(http_ring_t *ring)
+{
+    --ring->refcount;
+    if(ring->refcount > 0)
+        return;
+
+    for(http_ring_t **i = &ring_list; *i; i = &(*i)->next)
+    {
+        if(*i == ring)
+        {
+            *i = ring->next;
+            break;
+        }
     }
+
+    __module_stream_destroy(&ring->__stream);
+    ASC_FREE(ring->start, start_destroy);
+    ring_buffer_free(ring->buffer, ring->buffer_size);
+    free(ring);
 }
 
 static void on_upstream_read(void *arg)
@@ -153,6 +888,8 @@ static void on_upstream_send(void *arg)
     http_client_t *client = (http_client_t *)arg;
 
     module_stream_t *upstream = NULL;
+    bool is_fast_start = false;
+    http_response_t *response = client->response;
 
     client->response->buffer_size = DEFAULT_BUFFER_SIZE;
     client->response->buffer_fill = DEFAULT_BUFFER_FILL;
@@ -164,6 +901,39 @@ static void on_upstream_send(void *arg)
             upstream = (module_stream_t *)lua_touserdata(lua, -1);
         lua_pop(lua, 1);
 
+        lua_getfield(lua, 3, "fast_start");
+        is_fast_start = lua_toboolean(lua, -1);
+        lua_pop(lua, 1);
+
+        lua_getfield(lua, 3, "overflow");
+        if(lua_isstring(lua, -1))
+        {
+            const char *overflow = lua_tostring(lua, -1);
+            if(!strcmp(overflow, "keyframe"))
+                response->overflow = OVERFLOW_KEYFRAME;
+            else if(strcmp(overflow, "live"))
+                http_client_warning(client, "unknown overflow policy: %s", overflow);
+        }
+        lua_pop(lua, 1);
+
+        lua_getfield(lua, 3, "overflow_limit");
+        if(lua_isnumber(lua, -1))
+            response->overflow_limit = lua_tonumber(lua, -1);
+        lua_pop(lua, 1);
+
+        lua_getfield(lua, 3, "drop_pids");
+        response->is_drop_pids = lua_toboolean(lua, -1);
+        lua_pop(lua, 1);
+
+        lua_getfield(lua, 3, "zerocopy");
+        if(lua_toboolean(lua, -1))
+        {
+            response->is_zerocopy = asc_socket_set_zerocopy(client->sock, true);
+            if(!response->is_zerocopy)
+                http_client_warning(client, "MSG_ZEROCOPY is not supported");
+        }
+        lua_pop(lua, 1);
+
         lua_getfield(lua, 3, "buffer_size");
         if(lua_isnumber(lua, -1))
         {
@@ -200,16 +970,34 @@ static void on_upstream_send(void *arg)
         return;
     }
 
-    client->response->buffer = (uint8_t *)malloc(client->response->buffer_size);
+    const bool is_start = (   is_fast_start
+                           || response->overflow == OVERFLOW_KEYFRAME
+                           || response->is_drop_pids);
 
-    // like module_stream_init()
-    client->response->__stream.self = (void *)client;
-    client->response->__stream.on_ts = (void (*)(module_data_t *, const uint8_t *))on_ts;
-    __module_stream_init(&client->response->__stream);
-    __module_stream_attach(upstream, &client->response->__stream);
+    response->client = client;
+    response->ring = ring_attach(upstream, response->buffer_size, is_start);
+    response->read = response->ring->write;
+
+    if(response->is_zerocopy)
+    {
+        TAILQ_INSERT_TAIL(&response->ring->zerocopy_list, response, zerocopy_entry);
+        response->is_zerocopy_entry = true;
+    }
 
     client->on_read = on_upstream_read;
     client->on_ready = NULL;
+    client->on_stat = on_upstream_stat;
+
+    if(is_fast_start && start_prime(response->ring, response, response->buffer_size))
+    {
+        // sending starts right after the response header
+        client->on_ready = on_upstream_ready;
+        response->is_socket_busy = true;
+    }
+    else
+    {
+        TAILQ_INSERT_TAIL(&response->ring->wait_list, response, entry);
+    }
 
     const char *content_type = lua_isstring(lua, 4)
                              ? lua_tostring(lua, 4)
@@ -235,11 +1023,23 @@ static int module_call(module_data_t *mod)
             lua_pushvalue(lua, 2);
             lua_pushvalue(lua, 3);
             lua_pushvalue(lua, 4);
-            lua_call(lua, 3, 0);
+            module_lua_call(3, 0);
 
-            module_stream_destroy(client->response);
+            http_response_t *response = client->response;
+            if(response->ring)
+            {
+                // socket is already closed if the client is disconnected
+                if(!response->is_socket_busy)
+                    TAILQ_REMOVE(&response->ring->wait_list, response, entry);
+                else if(client->sock)
+                    asc_socket_set_on_ready(client->sock, NULL);
+                if(response->is_zerocopy_entry)
+                    TAILQ_REMOVE(&response->ring->zerocopy_list, response, zerocopy_entry);
+                ring_detach(response->ring);
+            }
+            ASC_FREE(response->queue, free);
+            client->on_stat = NULL;
 
-            free(client->response->buffer);
             free(client->response);
             client->response = NULL;
         }
@@ -255,7 +1055,7 @@ static int module_call(module_data_t *mod)
     lua_pushvalue(lua, 2);
     lua_pushvalue(lua, 3);
     lua_pushvalue(lua, 4);
-    lua_call(lua, 3, 0);
+    module_lua_call(3, 0);
 
     return 0;
 }
@@ -271,7 +271,7 @@ static void on_websocket_read(void *arg)
             lua_pushlstring(lua, (const char *)data, response->data_size);
         }
 
-        lua_call(lua, 3, 0);
+        module_lua_call(3, 0);
 
         response->header_size = 0;
         response->data_size = 0;
@@ -292,7 +292,7 @@ static void on_websocket_read(void *arg)
             lua_pushlightuserdata(lua, client);
             string_buffer_push(lua, client->content);
             client->content = NULL;
-            lua_call(lua, 3, 0);
+            module_lua_call(3, 0);
 
             response->header_size = 0;
             response->data_size = 0;
@@ -312,7 +312,7 @@ static int module_call(module_data_t *mod)
             lua_rawgeti(lua, LUA_REGISTRYINDEX, client->idx_server);
             lua_pushlightuserdata(lua, client);
             lua_pushnil(lua);
-            lua_call(lua, 3, 0);
+            module_lua_call(3, 0);
 
             if(client->content)
             {
@@ -157,7 +157,7 @@ static void callback(module_data_t *mod)
     lua_getfield(lua, -1, "callback");
     lua_pushvalue(lua, -3);
     lua_pushvalue(lua, response);
-    lua_call(lua, 2, 0);
+    module_lua_call(2, 0);
     lua_pop(lua, 3); // self + options + response
 }
 
@@ -400,10 +400,10 @@ static void on_thread_read(void *arg)
 {
     module_data_t *mod = (module_data_t *)arg;
 
-    uint8_t ts[TS_PACKET_SIZE];
+    uint8_t ts[TS_PACKET_SIZE * 32];
     const ssize_t r = asc_thread_buffer_read(mod->thread_output, ts, sizeof(ts));
-    if(r == sizeof(ts))
-        module_stream_send(mod, ts);
+    if(r >= TS_PACKET_SIZE)
+        module_stream_send_batch(mod, ts, r / TS_PACKET_SIZE);
 }
 
 static void thread_loop(void *arg)
@@ -28,6 +28,9 @@
  *      server_name  - string, default value: "Astra"
  *      http_version - string, default value: "HTTP/1.1"
  *      sctp         - boolean, use sctp instead of tcp
+ *      reuseport    - boolean, allow several processes to listen the same port
+ *      keep_alive   - number, idle timeout of the persistent connection in seconds,
+ *                     default value: 15. 0 - close connection after each response
  *      route        - list, format: { { "/path", callback }, ... }
  *
  * Module Methods:
@@ -43,6 +46,9 @@
  *                    * content - string, response body from the string
  *      data(client)
  *                  - return table, client data
+ *      stat(client)
+ *                  - return table, response statistics (e.g. lag of the stream client)
+ *                    or nil
  */
 
 #include "http.h"
@@ -57,6 +63,7 @@ struct module_data_t
     int port;
     const char *server_name;
     const char *http_version;
+    int keep_alive;
 
     asc_list_t *routes;
 
@@ -81,6 +88,16 @@ static const char __message[] = "message";
 
 static const char __content_length[] = "Content-Length: ";
 static const char __connection_close[] = "Connection: close";
+static const char __connection_keep_alive[] = "Connection: keep-alive";
+
+/* Transfer-Encoding: chunked */
+enum
+{
+    CHUNK_SIZE = 0,
+    CHUNK_DATA,
+    CHUNK_END,      // CRLF after the chunk data
+    CHUNK_TRAILER,
+};
 
 /*
  *   oooooooo8 ooooo       ooooo ooooooooooo oooo   oooo ooooooooooo
@@ -100,7 +117,7 @@ static void callback(http_client_t *client)
         lua_rawgeti(lua, LUA_REGISTRYINDEX, client->idx_request);
     else
         lua_pushnil(lua);
-    lua_call(lua, 3, 0);
+    module_lua_call(3, 0);
 }
 
 static void on_client_close(void *arg)
@@ -114,6 +131,12 @@ static void on_client_close(void *arg)
     asc_socket_close(client->sock);
     client->sock = NULL;
 
+    if(client->idle_timer)
+    {
+        asc_timer_destroy(client->idle_timer);
+        client->idle_timer = NULL;
+    }
+
     if(client->status == 3)
     {
         client->status = 0;
@@ -147,6 +170,8 @@ static void on_client_close(void *arg)
         client->content = NULL;
     }
 
+    ASC_FREE(client->pipeline, free);
+
     asc_list_remove_item(mod->clients, client);
     free(client);
 }
@@ -178,6 +203,18 @@ static bool routecmp(const char *path, const char *route)
     return false;
 }
 
+/* case-insensitive search of the token in the header value */
+static bool header_has(const char *value, const char *token)
+{
+    const size_t size = strlen(token);
+    for(; *value; ++value)
+    {
+        if(!strncasecmp(value, token, size))
+            return true;
+    }
+    return false;
+}
+
 /*
  * oooooooooo  ooooooooooo      o      ooooooooo
  *  888    888  888    88      888      888    88o
@@ -187,6 +224,8 @@ static bool routecmp(const char *path, const char *route)
  *
  */
 
+static void client_parse(http_client_t *client);
+
 static void on_client_read(void *arg)
 {
     http_client_t *client = (http_client_t *)arg;
@@ -207,22 +246,130 @@ static void on_client_read(void *arg)
         return;
     }
 
+    if(client->idle_timer)
+    {
+        asc_timer_destroy(client->idle_timer);
+        client->idle_timer = NULL;
+    }
+
+    client->buffer_skip += size;
+    client_parse(client);
+}
+
+/* request is ready. data of the next requests is kept until the response is sent */
+static void client_request(http_client_t *client, size_t skip)
+{
+    const size_t size = client->buffer_skip - skip;
+    if(size > 0)
+    {
+        client->pipeline = (char *)malloc(size);
+        memcpy(client->pipeline, &client->buffer[skip], size);
+        client->pipeline_size = size;
+    }
+    client->buffer_skip = 0;
+
+    asc_socket_set_on_read(client->sock, NULL);
+
+    client->status = 3;
+    callback(client);
+}
+
+/*
+ * Transfer-Encoding: chunked. skip - position of the data in the buffer,
+ * on complete - position of the next request.
+ * returns 1 if content is complete, 0 - more data required, -1 - error
+ */
+static int client_chunked(http_client_t *client, size_t *skip_ptr)
+{
+    size_t skip = *skip_ptr;
+
+    while(skip < client->buffer_skip)
+    {
+        if(client->chunk_state == CHUNK_DATA)
+        {
+            size_t size = client->buffer_skip - skip;
+            if(size > client->chunk_left)
+                size = client->chunk_left;
+
+            string_buffer_addlstring(client->content, &client->buffer[skip], size);
+            client->chunk_left -= size;
+            skip += size;
+
+            if(client->chunk_left == 0)
+                client->chunk_state = CHUNK_END;
+            continue;
+        }
+
+        const char *line = &client->buffer[skip];
+        const char *eol = (const char *)memchr(line, '\n', client->buffer_skip - skip);
+        if(!eol)
+            break;
+
+        const bool is_empty = (eol == line || (eol == &line[1] && line[0] == '\r'));
+        skip = eol - client->buffer + 1;
+
+        switch(client->chunk_state)
+        {
+            case CHUNK_SIZE:
+            {
+                char *end = NULL;
+                client->chunk_left = strtoul(line, &end, 16);
+                if(end == line)
+                    return -1;
+                client->chunk_state = (client->chunk_left > 0) ? CHUNK_DATA : CHUNK_TRAILER;
+                break;
+            }
+            case CHUNK_END:
+                if(!is_empty)
+                    return -1;
+                client->chunk_state = CHUNK_SIZE;
+                break;
+            default:
+                if(is_empty)
+                {
+                    *skip_ptr = skip;
+                    return 1;
+                }
+                break;
+        }
+    }
+
+    // incomplete line is moved to the begin of the buffer
+    const size_t tail = client->buffer_skip - skip;
+    if(tail == HTTP_BUFFER_SIZE)
+        return -1;
+    memmove(client->buffer, &client->buffer[skip], tail);
+    client->buffer_skip = tail;
+
+    return 0;
+}
+
+static void client_parse(http_client_t *client)
+{
+    module_data_t *mod = client->mod;
+
     char *uri_host = NULL;
     size_t uri_host_size = 0;
 
     size_t eoh = 0; // end of headers
     size_t skip = 0;
-    client->buffer_skip += size;
 
     if(client->status == 0)
     {
-        // check empty line
-        while(skip < client->buffer_skip)
+        // check empty line. search is resumed on the next read
+        skip = client->buffer_scan;
+        while(skip + 4 <= client->buffer_skip)
         {
-            if(   client->buffer[skip + 0] == '\r'
-               && client->buffer[skip + 1] == '\n'
-               && client->buffer[skip + 2] == '\r'
-               && client->buffer[skip + 3] == '\n')
+            const char *cr = (const char *)memchr(  &client->buffer[skip], '\r'
+                                                  , client->buffer_skip - skip - 3);
+            if(!cr)
+            {
+                skip = client->buffer_skip - 3;
+                break;
+            }
+
+            skip = cr - client->buffer;
+            if(!memcmp(cr, "\r\n\r\n", 4))
             {
                 eoh = skip + 4;
                 client->status = 1; // empty line is found
@@ -232,7 +379,19 @@ static void on_client_read(void *arg)
         }
 
         if(client->status != 1)
+        {
+            if(client->buffer_skip == HTTP_BUFFER_SIZE)
+            {
+                asc_log_error(MSG("request headers are too large"));
+                on_client_close(client);
+                return;
+            }
+
+            client->buffer_scan = skip;
             return;
+        }
+
+        client->buffer_scan = 0;
     }
 
     if(client->status == 1)
@@ -312,6 +471,7 @@ static void on_client_read(void *arg)
         if(!is_safe)
         {
             lua_pop(lua, 1); // request
+            asc_socket_set_on_read(client->sock, NULL);
             http_client_redirect(client, 302, path);
             return;
         }
@@ -391,6 +551,33 @@ static void on_client_read(void *arg)
         }
         lua_pop(lua, 1); // content-length
 
+        lua_getfield(lua, headers, "transfer-encoding");
+        if(lua_isstring(lua, -1) && header_has(lua_tostring(lua, -1), "chunked"))
+        {
+            if(client->content)
+                string_buffer_free(client->content);
+            client->content = string_buffer_alloc();
+            client->is_content_length = false;
+            client->is_chunked = true;
+            client->chunk_state = CHUNK_SIZE;
+            client->chunk_left = 0;
+        }
+        lua_pop(lua, 1); // transfer-encoding
+
+        lua_getfield(lua, request, __version);
+        client->is_http_1_0 = (strcmp(lua_tostring(lua, -1), "HTTP/1.0") == 0);
+        lua_pop(lua, 1); // version
+
+        lua_getfield(lua, headers, "connection");
+        const char *connection = lua_isstring(lua, -1) ? lua_tostring(lua, -1) : "";
+        if(mod->keep_alive == 0 || header_has(connection, "close"))
+            client->is_keep_alive = false;
+        else if(client->is_http_1_0)
+            client->is_keep_alive = header_has(connection, "keep-alive");
+        else
+            client->is_keep_alive = true;
+        lua_pop(lua, 1); // connection
+
         lua_pop(lua, 2); // headers + request
 
         client->idx_callback = 0;
@@ -407,14 +594,14 @@ static void on_client_read(void *arg)
         if(!client->idx_callback)
         {
             http_client_warning(client, "route not found %s", path);
+            asc_socket_set_on_read(client->sock, NULL);
             http_client_abort(client, 404, NULL);
             return;
         }
 
         if(!client->content)
         {
-            client->status = 3;
-            callback(client);
+            client_request(client, skip);
             return;
         }
 
@@ -437,33 +624,47 @@ static void on_client_read(void *arg)
     // Content-Length: *
     if(client->is_content_length)
     {
-        const size_t tail = client->buffer_skip - skip;
+        size_t size = client->buffer_skip - skip;
+        if(size > client->chunk_left)
+            size = client->chunk_left;
+
+        string_buffer_addlstring(client->content, &client->buffer[skip], size);
+        client->chunk_left -= size;
+        skip += size;
 
-        if(client->chunk_left > tail)
+        if(client->chunk_left > 0)
         {
-            string_buffer_addlstring(client->content,
-                &client->buffer[skip], client->buffer_skip - skip);
-            client->chunk_left -= tail;
+            client->buffer_skip = 0;
+            return;
         }
-        else
+    }
+    // Transfer-Encoding: chunked
+    else if(client->is_chunked)
+    {
+        const int ret = client_chunked(client, &skip);
+        if(ret == -1)
         {
-            string_buffer_addlstring(client->content,
-                &client->buffer[skip], client->chunk_left);
-            client->chunk_left = 0;
-
-            lua_rawgeti(lua, LUA_REGISTRYINDEX, client->idx_request);
-            string_buffer_push(lua, client->content);
-            client->content = NULL;
-            lua_setfield(lua, -2, __content);
-            lua_pop(lua, 1); // request
-
-            client->status = 3;
-            callback(client);
+            asc_log_error(MSG("failed to parse chunked content"));
+            on_client_close(client);
+            return;
         }
+        if(ret == 0)
+            return;
+    }
 
-        client->buffer_skip = 0;
-        return;
+    client->is_content_length = false;
+    client->is_chunked = false;
+
+    if(client->content)
+    {
+        lua_rawgeti(lua, LUA_REGISTRYINDEX, client->idx_request);
+        string_buffer_push(lua, client->content);
+        client->content = NULL;
+        lua_setfield(lua, -2, __content);
+        lua_pop(lua, 1); // request
     }
+
+    client_request(client, skip);
 }
 
 /*
@@ -475,6 +676,86 @@ static void on_client_read(void *arg)
  *
  */
 
+static void on_client_idle(void *arg)
+{
+    http_client_t *client = (http_client_t *)arg;
+    client->idle_timer = NULL;
+    on_client_close(client);
+}
+
+/* response is sent. persistent connection is ready for the next request */
+static void on_client_finish(http_client_t *client)
+{
+    module_data_t *mod = client->mod;
+
+    if(!client->is_keep_alive)
+    {
+        on_client_close(client);
+        return;
+    }
+
+    if(client->status == 3)
+    {
+        client->status = 0;
+        callback(client);
+    }
+
+    if(client->response)
+    {
+        asc_log_error(MSG("client instance is not released"));
+        on_client_close(client);
+        return;
+    }
+
+    if(client->idx_content)
+    {
+        luaL_unref(lua, LUA_REGISTRYINDEX, client->idx_content);
+        client->idx_content = 0;
+    }
+
+    if(client->idx_request)
+    {
+        luaL_unref(lua, LUA_REGISTRYINDEX, client->idx_request);
+        client->idx_request = 0;
+    }
+
+    if(client->idx_data)
+    {
+        luaL_unref(lua, LUA_REGISTRYINDEX, client->idx_data);
+        client->idx_data = 0;
+    }
+
+    client->status = 0;
+    client->idx_callback = 0;
+    client->is_head = false;
+    client->is_keep_alive = false;
+    client->chunk_left = 0;
+
+    client->on_send = NULL;
+    client->on_read = NULL;
+    client->on_ready = NULL;
+    client->on_stat = NULL;
+
+    client->buffer_skip = 0;
+    client->buffer_scan = 0;
+    if(client->pipeline)
+    {
+        memcpy(client->buffer, client->pipeline, client->pipeline_size);
+        client->buffer_skip = client->pipeline_size;
+        free(client->pipeline);
+        client->pipeline = NULL;
+        client->pipeline_size = 0;
+    }
+
+    asc_socket_set_on_ready(client->sock, NULL);
+    asc_socket_set_on_read(client->sock, on_client_read);
+
+    if(client->buffer_skip > 0)
+        client_parse(client);
+    else
+        client->idle_timer = asc_timer_one_shot(mod->keep_alive * 1000, on_client_idle, client);
+}
+
 static void on_ready_send_content(void *arg)
 {
     http_client_t *client = (http_client_t *)arg;
@@ -506,7 +787,7 @@ static void on_ready_send_content(void *arg)
     client->chunk_left -= send_size;
 
     if(client->chunk_left == 0)
-        on_client_close(client);
+        on_client_finish(client);
 }
 
 /* Stack: 1 - server, 2 - client, 3 - response */
@@ -614,7 +895,7 @@ static void on_ready_send_response(void *arg)
             return;
         }
 
-        on_client_close(client);
+        on_client_finish(client);
     }
 }
 
@@ -657,6 +938,11 @@ void http_response_code(http_client_t *client, int code, const char *message)
                                    , HTTP_BUFFER_SIZE - client->chunk_left
                                    , "Server: %s\r\n"
                                    , client->mod->server_name);
+
+    // response without body
+    client->is_response_framed = (   code < 200 || code == 204 || code == 304
+                                  || client->is_head);
+    client->is_response_connection = false;
 }
 
 void http_response_header(http_client_t *client, const char *header, ...)
@@ -664,9 +950,22 @@ void http_response_header(http_client_t *client, const char *header, ...)
     va_list ap;
     va_start(ap, header);
 
+    const char *line = &client->buffer[client->chunk_left];
     client->chunk_left += vsnprintf(&client->buffer[client->chunk_left]
                                     , HTTP_BUFFER_SIZE - client->chunk_left
                                     , header, ap);
+
+    if(!strncasecmp(line, __content_length, sizeof(__content_length) - 2))
+    {
+        client->is_response_framed = true;
+    }
+    else if(!strncasecmp(line, "Connection:", 11))
+    {
+        client->is_response_connection = true;
+        if(header_has(&line[11], "close"))
+            client->is_keep_alive = false;
+    }
+
     client->buffer[client->chunk_left + 0] = '\r';
     client->buffer[client->chunk_left + 1] = '\n';
     client->chunk_left += 2;
@@ -676,6 +975,18 @@ void http_response_header(http_client_t *client, const char *header, ...)
 
 void http_response_send(http_client_t *client)
 {
+    // end of the response without length is the end of the connection
+    if(!client->is_response_framed)
+        client->is_keep_alive = false;
+
+    if(!client->is_response_connection)
+    {
+        if(!client->is_keep_alive)
+            http_response_header(client, __connection_close);
+        else if(client->is_http_1_0)
+            http_response_header(client, __connection_keep_alive);
+    }
+
     client->buffer[client->chunk_left + 0] = '\r';
     client->buffer[client->chunk_left + 1] = '\n';
     client->chunk_left += 2;
@@ -686,6 +997,11 @@ void http_response_send(http_client_t *client)
     asc_socket_set_on_ready(client->sock, on_ready_send_response);
 }
 
+void http_response_done(http_client_t *client)
+{
+    on_client_finish(client);
+}
+
 void http_client_warning(http_client_t *client, const char *message, ...)
 {
     module_data_t *mod = client->mod;
@@ -862,6 +1178,10 @@ static void on_server_accept(void *arg)
                       , asc_socket_port(client->sock)
                       , asc_list_size(mod->clients));
 
+    // responses on the persistent connection are not delayed by Nagle
+    if(mod->keep_alive > 0)
+        asc_socket_set_non_delay(client->sock, 1);
+
     asc_socket_set_on_read(client->sock, on_client_read);
     asc_socket_set_on_close(client->sock, on_client_close);
 }
@@ -889,6 +1209,19 @@ static int method_data(module_data_t *mod)
     return 1;
 }
 
+static int method_stat(module_data_t *mod)
+{
+    asc_assert(lua_islightuserdata(lua, 2), MSG(":stat() client instance required"));
+    http_client_t *client = (http_client_t *)lua_touserdata(lua, 2);
+
+    if(client->on_stat)
+        client->on_stat(client);
+    else
+        lua_pushnil(lua);
+
+    return 1;
+}
+
 static int method_close(module_data_t *mod)
 {
     if(lua_gettop(lua) == 1)
@@ -958,6 +1291,9 @@ static void module_init(module_data_t *mod)
     mod->http_version = "HTTP/1.1";
     module_option_string("http_version", &mod->http_version, NULL);
 
+    mod->keep_alive = 15;
+    module_option_number("keep_alive", &mod->keep_alive);
+
     // store routes in registry
     mod->routes = asc_list_init();
     lua_getfield(lua, MODULE_OPTIONS_IDX, "route");
@@ -1006,6 +1342,12 @@ static void module_init(module_data_t *mod)
         mod->sock = asc_socket_open_tcp4(mod);
 
     asc_socket_set_reuseaddr(mod->sock, 1);
+
+    bool reuseport = false;
+    module_option_boolean("reuseport", &reuseport);
+    if(reuseport)
+        asc_socket_set_reuseport(mod->sock, 1);
+
     if(!asc_socket_bind(mod->sock, mod->addr, mod->port))
     {
         on_server_close(mod);
@@ -1027,6 +1369,7 @@ MODULE_LUA_METHODS()
     { "send", method_send },
     { "close", method_close },
     { "data", method_data },
+    { "stat", method_stat },
     { "redirect", method_redirect },
     { "abort", method_abort }
 };
@@ -113,7 +113,7 @@ static void callback(module_data_t *mod)
 
     lua_rawgeti(lua, LUA_REGISTRYINDEX, mod->idx_callback);
     lua_pushvalue(lua, -2);
-    lua_call(lua, 1, 0);
+    module_lua_call(1, 0);
 
     lua_pop(lua, 1); // data
 }
@@ -807,6 +807,7 @@ static void module_init(module_data_t *mod)
 {
     module_stream_init(mod, on_ts);
     module_stream_demux_set(mod, NULL, NULL);
+    module_stream_demux_filter(mod);
 
     module_option_string("name", &mod->config.name, NULL);
     asc_assert(mod->config.name != NULL, "[channel] option 'name' is required");
@@ -45,9 +45,15 @@ static void on_ts(module_data_t *mod, const uint8_t *ts)
     module_stream_send(mod, ts);
 }
 
+static void on_ts_batch(module_data_t *mod, const uint8_t *ts, size_t count)
+{
+    module_stream_send_slab(mod, module_stream_slab(mod), ts, count);
+}
+
 static void module_init(module_data_t *mod)
 {
     module_stream_init(mod, on_ts);
+    module_stream_batch_set(mod, on_ts_batch);
 }
 
 static void module_destroy(module_data_t *mod)
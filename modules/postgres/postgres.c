@@ -158,7 +158,7 @@ static void process_query(module_data_t *mod)
                     lua_rawgeti(lua, LUA_REGISTRYINDEX, mod->current_task->callback);
                     lua_pushvalue(lua, -2);
 
-                    lua_call(lua, 1, 0);
+                    module_lua_call(1, 0);
 
                     lua_pop(lua, 1);
 
@@ -0,0 +1,349 @@
+/*
+ * Astra Module: UDP (SMPTE 2022-1 FEC)
+ * http://cesbo.com/astra
+ *
+ * Copyright (C) 2012-2015, Andrey Dyldin <and@cesbo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fec.h"
+
+#ifdef __SSE2__
+#   include <emmintrin.h>
+#endif
+
+void fec_xor(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    for(; i + 64 <= size; i += 64)
+    {
+        const __m128i a0 = _mm_loadu_si128((const __m128i *)&dst[i]);
+        const __m128i a1 = _mm_loadu_si128((const __m128i *)&dst[i + 16]);
+        const __m128i a2 = _mm_loadu_si128((const __m128i *)&dst[i + 32]);
+        const __m128i a3 = _mm_loadu_si128((const __m128i *)&dst[i + 48]);
+        const __m128i b0 = _mm_loadu_si128((const __m128i *)&src[i]);
+        const __m128i b1 = _mm_loadu_si128((const __m128i *)&src[i + 16]);
+        const __m128i b2 = _mm_loadu_si128((const __m128i *)&src[i + 32]);
+        const __m128i b3 = _mm_loadu_si128((const __m128i *)&src[i + 48]);
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_xor_si128(a0, b0));
+        _mm_storeu_si128((__m128i *)&dst[i + 16], _mm_xor_si128(a1, b1));
+        _mm_storeu_si128((__m128i *)&dst[i + 32], _mm_xor_si128(a2, b2));
+        _mm_storeu_si128((__m128i *)&dst[i + 48], _mm_xor_si128(a3, b3));
+    }
+
+    for(; i + 16 <= size; i += 16)
+    {
+        const __m128i a = _mm_loadu_si128((const __m128i *)&dst[i]);
+        const __m128i b = _mm_loadu_si128((const __m128i *)&src[i]);
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_xor_si128(a, b));
+    }
+#endif
+
+    for(; i + 8 <= size; i += 8)
+    {
+        uint64_t a, b;
+        memcpy(&a, &dst[i], 8);
+        memcpy(&b, &src[i], 8);
+        a ^= b;
+        memcpy(&dst[i], &a, 8);
+    }
+
+    for(; i < size; ++i)
+        dst[i] ^= src[i];
+}
+
+/*
+ * oooooooooo  ooooooooooo  oooooooo8    ooooooo  ooooo  oooo ooooooooooo oooooooooo
+ *  888    888  888    88 o888     88 o888   888o 888    88   888    88   888    888
+ *  888oooo88   888ooo8   888         888     888  888  88    888ooo8     888oooo88
+ *  888  88o    888    oo 888o     oo 888o   o888   88888     888    oo   888  88o
+ * o888o  88o8 o888ooo8888 888oooo88    88ooo88      888     o888ooo8888 o888o  88o8
+ *
+ */
+
+bool fec_recovery_push(fec_recovery_t *fec, const uint8_t *data, size_t size)
+{
+    const size_t skip = rtp_header_size(data, size);
+    if(skip == 0 || skip + FEC_HEADER_SIZE > size)
+        return false;
+
+    const uint8_t *header = &data[skip];
+    const uint8_t offset = header[13];
+    const uint8_t na = header[14];
+    const size_t payload_size = size - skip - FEC_HEADER_SIZE;
+
+    if(offset == 0 || na == 0 || na > FEC_MATRIX_MAX || payload_size > FEC_PAYLOAD_SIZE)
+        return false;
+
+    /* free slot or the oldest one */
+    fec_packet_t *packet = NULL;
+    for(uint32_t i = 0; i < FEC_LIST_SIZE; ++i)
+    {
+        fec_packet_t *item = &fec->list[i];
+        if(!item->is_set)
+        {
+            packet = item;
+            break;
+        }
+        if(!packet || item->order < packet->order)
+            packet = item;
+    }
+
+    if(!packet->is_set)
+        ++fec->count;
+
+    packet->is_set = true;
+    packet->sn_base = (header[0] << 8) | header[1];
+    packet->length = (header[2] << 8) | header[3];
+    packet->offset = offset;
+    packet->na = na;
+    packet->size = payload_size;
+    packet->order = ++fec->order;
+    memcpy(packet->payload, &header[FEC_HEADER_SIZE], payload_size);
+
+    return true;
+}
+
+static void fec_packet_drop(fec_recovery_t *fec, fec_packet_t *packet)
+{
+    packet->is_set = false;
+    --fec->count;
+}
+
+/* returns true if datagram is recovered */
+static bool fec_packet_check(  fec_recovery_t *fec, fec_packet_t *packet
+                             , rtp_reorder_t *reorder, uint64_t time)
+{
+    int missing = 0;
+    uint16_t missing_seq = 0;
+
+    for(int i = 0; i < packet->na; ++i)
+    {
+        const uint16_t seq = packet->sn_base + i * packet->offset;
+        if(rtp_reorder_lookup(reorder, seq))
+            continue;
+
+        if(!rtp_reorder_is_pending(reorder, seq))
+        {
+            /* already skipped as lost or out of the buffer */
+            fec_packet_drop(fec, packet);
+            return false;
+        }
+
+        ++missing;
+        if(missing > 1)
+            return false;
+        missing_seq = seq;
+    }
+
+    if(missing == 0)
+    {
+        fec_packet_drop(fec, packet);
+        return false;
+    }
+
+    uint8_t payload[FEC_PAYLOAD_SIZE];
+    memcpy(payload, packet->payload, packet->size);
+    uint16_t length = packet->length;
+
+    for(int i = 0; i < packet->na; ++i)
+    {
+        const uint16_t seq = packet->sn_base + i * packet->offset;
+        if(seq == missing_seq)
+            continue;
+
+        const rtp_slot_t *slot = rtp_reorder_lookup(reorder, seq);
+        fec_xor(payload, slot->payload, (slot->size < packet->size) ? slot->size : packet->size);
+        length ^= slot->size;
+    }
+
+    fec_packet_drop(fec, packet);
+
+    size_t size = (length < packet->size) ? length : packet->size;
+    size -= size % TS_PACKET_SIZE;
+    if(size == 0)
+        return false;
+
+    return rtp_reorder_recover(reorder, missing_seq, payload, size, time);
+}
+
+/* restores missing datagrams. row and column FEC are checked until no progress */
+void fec_recovery_run(fec_recovery_t *fec, rtp_reorder_t *reorder, uint64_t time)
+{
+    bool is_recovered = true;
+    while(is_recovered && fec->count > 0)
+    {
+        is_recovered = false;
+        for(uint32_t i = 0; i < FEC_LIST_SIZE; ++i)
+        {
+            fec_packet_t *packet = &fec->list[i];
+            if(packet->is_set && fec_packet_check(fec, packet, reorder, time))
+                is_recovered = true;
+        }
+    }
+}
+
+/*
+ * ooooooooooo oooo   oooo  oooooooo8    ooooooo  ooooooooo  ooooooooooo oooooooooo
+ *  888    88   8888o  88 o888     88 o888   888o 888    88o 888    88   888    888
+ *  888ooo8     88 888o88 888         888     888 888    888 888ooo8     888oooo88
+ *  888    oo   88   8888 888o     oo 888o   o888 888    888 888    oo   888  88o
+ * o888ooo8888 o88o    88  888oooo88    88ooo88  o888ooo88  o888ooo8888 o888o  88o8
+ *
+ */
+
+void fec_encoder_init(  fec_encoder_t *fec, int columns, int rows
+                      , fec_send_t send, void *arg)
+{
+    memset(fec, 0, sizeof(fec_encoder_t));
+
+    fec->columns = columns;
+    fec->rows = rows;
+    fec->send = send;
+    fec->arg = arg;
+    fec->column_list = (fec_accum_t *)calloc(columns, sizeof(fec_accum_t));
+}
+
+void fec_encoder_destroy(fec_encoder_t *fec)
+{
+    ASC_FREE(fec->column_list, free);
+}
+
+/* XOR of the RTP datagram: header fields and payload */
+static void fec_accum_push(  fec_accum_t *accum, bool is_first
+                           , const struct iovec *iov, int iov_count)
+{
+    const uint8_t *header = (const uint8_t *)iov[0].iov_base;
+
+    if(is_first)
+    {
+        accum->length = 0;
+        accum->pt = 0;
+        accum->ts = 0;
+        accum->size = 0;
+    }
+
+    accum->pt ^= header[1] & 0x7F;
+    accum->ts ^= (header[4] << 24) | (header[5] << 16) | (header[6] << 8) | header[7];
+
+    /* first iov starts with the RTP header */
+    size_t skip = RTP_HEADER_SIZE;
+    size_t offset = 0;
+    for(int i = 0; i < iov_count; ++i)
+    {
+        const uint8_t *data = (const uint8_t *)iov[i].iov_base;
+        size_t size = iov[i].iov_len;
+        if(skip > 0)
+        {
+            const size_t n = (skip < size) ? skip : size;
+            data += n;
+            size -= n;
+            skip -= n;
+        }
+
+        if(offset + size > FEC_PAYLOAD_SIZE)
+            size = FEC_PAYLOAD_SIZE - offset;
+        if(size == 0)
+            continue;
+
+        if(offset + size > accum->size)
+        {
+            /* payload of the shorter datagrams is padded with zeros */
+            memset(&accum->payload[accum->size], 0, offset + size - accum->size);
+            accum->size = offset + size;
+        }
+
+        fec_xor(&accum->payload[offset], data, size);
+        offset += size;
+    }
+
+    accum->length ^= offset;
+}
+
+static void fec_encoder_send(  fec_encoder_t *fec, const fec_accum_t *accum
+                             , uint16_t sn_base, bool is_row)
+{
+    uint8_t *packet = fec->packet;
+    const uint16_t seq = (is_row) ? fec->row_seq++ : fec->column_seq++;
+
+    /* RTP header */
+    packet[0] = 0x80;
+    packet[1] = FEC_PT;
+    packet[2] = (seq >> 8) & 0xFF;
+    packet[3] = (seq     ) & 0xFF;
+    memset(&packet[4], 0, 8);
+
+    /* FEC header */
+    uint8_t *header = &packet[RTP_HEADER_SIZE];
+    header[0] = (sn_base >> 8) & 0xFF;
+    header[1] = (sn_base     ) & 0xFF;
+    header[2] = (accum->length >> 8) & 0xFF;
+    header[3] = (accum->length     ) & 0xFF;
+    header[4] = 0x80 | accum->pt; // E
+    header[5] = 0;
+    header[6] = 0;
+    header[7] = 0;
+    header[8] = (accum->ts >> 24) & 0xFF;
+    header[9] = (accum->ts >> 16) & 0xFF;
+    header[10] = (accum->ts >> 8) & 0xFF;
+    header[11] = (accum->ts     ) & 0xFF;
+    header[12] = (is_row) ? 0x40 : 0x00; // D
+    header[13] = (is_row) ? 1 : fec->columns; // offset
+    header[14] = (is_row) ? fec->columns : fec->rows; // NA
+    header[15] = 0;
+
+    memcpy(&header[FEC_HEADER_SIZE], accum->payload, accum->size);
+
+    fec->send(  fec->arg, is_row, packet
+              , RTP_HEADER_SIZE + FEC_HEADER_SIZE + accum->size);
+}
+
+/* iov - completed RTP datagram */
+void fec_encoder_push(fec_encoder_t *fec, const struct iovec *iov, int iov_count)
+{
+    const uint8_t *header = (const uint8_t *)iov[0].iov_base;
+    const uint16_t seq = RTP_GET_SEQ(header);
+
+    if(fec->index == 0)
+        fec->sn_base = seq;
+
+    const int column = fec->index % fec->columns;
+    const int row = fec->index / fec->columns;
+
+    if(fec->columns > 1)
+    {
+        fec_accum_push(&fec->row, (column == 0), iov, iov_count);
+        if(column == fec->columns - 1)
+            fec_encoder_send(fec, &fec->row, seq - column, true);
+    }
+
+    if(fec->rows > 1)
+        fec_accum_push(&fec->column_list[column], (row == 0), iov, iov_count);
+
+    ++fec->index;
+    if(fec->index < fec->columns * fec->rows)
+        return;
+
+    fec->index = 0;
+
+    /* columns are completed with the last row */
+    if(fec->rows > 1)
+    {
+        for(int i = 0; i < fec->columns; ++i)
+            fec_encoder_send(fec, &fec->column_list[i], fec->sn_base + i, false);
+    }
+}
@@ -0,0 +1,131 @@
+/*
+ * Astra Module: UDP (SMPTE 2022-1 FEC)
+ * http://cesbo.com/astra
+ *
+ * Copyright (C) 2012-2015, Andrey Dyldin <and@cesbo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FEC_H_
+#define _FEC_H_ 1
+
+#include "rtp.h"
+
+/*
+ * FEC packet: RTP header, FEC header and XOR of the media payloads.
+ * column FEC is sent to the media port + 2, row FEC to the port + 4
+ */
+
+#define FEC_HEADER_SIZE 16
+#define FEC_PAYLOAD_SIZE 1500
+
+#define FEC_COLUMN_PORT 2
+#define FEC_ROW_PORT 4
+
+/* 2022-1 limits: L*D <= 100, L and D <= 20 */
+#define FEC_MATRIX_MAX 100
+#define FEC_SIZE_MAX 20
+
+void fec_xor(uint8_t *dst, const uint8_t *src, size_t size);
+
+/*
+ * oooooooooo  ooooooooooo  oooooooo8    ooooooo  ooooo  oooo ooooooooooo oooooooooo
+ *  888    888  888    88 o888     88 o888   888o 888    88   888    88   888    888
+ *  888oooo88   888ooo8   888         888     888  888  88    888ooo8     888oooo88
+ *  888  88o    888    oo 888o     oo 888o   o888   88888     888    oo   888  88o
+ * o888o  88o8 o888ooo8888 888oooo88    88ooo88      888     o888ooo8888 o888o  88o8
+ *
+ */
+
+#define FEC_LIST_SIZE 64
+
+typedef struct
+{
+    bool is_set;
+    uint16_t sn_base;
+    uint16_t length; // length recovery
+    uint8_t offset;
+    uint8_t na;
+    uint32_t size;
+    uint64_t order;
+    uint8_t payload[FEC_PAYLOAD_SIZE];
+} fec_packet_t;
+
+/* received FEC packets waiting for the loss in the protected datagrams */
+typedef struct
+{
+    fec_packet_t list[FEC_LIST_SIZE];
+    uint32_t count;
+    uint64_t order;
+} fec_recovery_t;
+
+bool fec_recovery_push(fec_recovery_t *fec, const uint8_t *data, size_t size);
+void fec_recovery_run(fec_recovery_t *fec, rtp_reorder_t *reorder, uint64_t time);
+
+/*
+ * ooooooooooo oooo   oooo  oooooooo8    ooooooo  ooooooooo  ooooooooooo oooooooooo
+ *  888    88   8888o  88 o888     88 o888   888o 888    88o 888    88   888    888
+ *  888ooo8     88 888o88 888         888     888 888    888 888ooo8     888oooo88
+ *  888    oo   88   8888 888o     oo 888o   o888 888    888 888    oo   888  88o
+ * o888ooo8888 o88o    88  888oooo88    88ooo88  o888ooo88  o888ooo8888 o888o  88o8
+ *
+ */
+
+#define FEC_PACKET_SIZE (RTP_HEADER_SIZE + FEC_HEADER_SIZE + FEC_PAYLOAD_SIZE)
+#define FEC_PT 96
+
+typedef struct
+{
+    uint16_t length;
+    uint8_t pt;
+    uint32_t ts;
+    uint32_t size;
+    uint8_t payload[FEC_PAYLOAD_SIZE];
+} fec_accum_t;
+
+/* is_row - row FEC (port + 4), otherwise column FEC (port + 2) */
+typedef void (*fec_send_t)(void *arg, bool is_row, const uint8_t *data, size_t size);
+
+/*
+ * XOR of the media datagrams is accumulated for each row and each column
+ * of the L (columns) x D (rows) matrix. row FEC is sent when the row is
+ * completed, column FEC - after the last datagram of the matrix.
+ * with L = 1 only column FEC is sent (1D FEC), with D = 1 only row FEC
+ */
+typedef struct
+{
+    int columns; // L
+    int rows; // D
+    int index; // position of the next datagram in the matrix
+    uint16_t sn_base; // first datagram of the matrix
+
+    fec_accum_t row;
+    fec_accum_t *column_list;
+
+    uint16_t row_seq;
+    uint16_t column_seq;
+
+    fec_send_t send;
+    void *arg;
+
+    uint8_t packet[FEC_PACKET_SIZE];
+} fec_encoder_t;
+
+void fec_encoder_init(  fec_encoder_t *fec, int columns, int rows
+                      , fec_send_t send, void *arg);
+void fec_encoder_destroy(fec_encoder_t *fec);
+void fec_encoder_push(fec_encoder_t *fec, const struct iovec *iov, int iov_count);
+
+#endif /* _FEC_H_ */
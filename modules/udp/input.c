@@ -29,22 +29,93 @@
  *      socket_size - number, socket buffer size
  *      renew       - number, renewing multicast subscription interval in seconds
  *      rtp         - boolean, use RTP instead RAW UDP
+ *      batch       - number, maximum datagrams received on each wakeup. default: 16
+ *      reorder     - number, RTP reorder buffer depth in datagrams. default: 0 - disabled
+ *      reorder_delay
+ *                  - number, maximum time in milliseconds to wait for the missing
+ *                    datagram. default: 50. if defined without reorder,
+ *                    the buffer depth is 128
+ *      fec         - boolean, SMPTE 2022-1 FEC recovery. column FEC is received on
+ *                    the port + 2, row FEC on the port + 4. requires the reorder buffer,
+ *                    default depth: 256, default delay: 500
+ *      merge       - list, redundant sources of the same stream (SMPTE 2022-7):
+ *                    { { addr = "...", port = N, localaddr = "..." }, ... }
+ *                    port and localaddr are the same as for the main source if not defined.
+ *                    RTP datagrams are merged by the sequence number with the reorder
+ *                    buffer (default depth: 128, default delay: skew).
+ *                    RAW UDP is merged by the TS packet hash, the first copy is delivered
+ *      skew        - number, maximum delay in milliseconds between the sources. default: 50
+ *      groups      - list, multicast groups received with one socket on the port:
+ *                    { "239.0.0.1", "239.0.0.2", ... }. addr is not required.
+ *                    datagrams are dispatched by the destination address (IP_PKTINFO).
+ *                    RTP header is removed, reorder, fec and merge are not used.
+ *                    number of groups on the socket is limited by the system
+ *                    (net.ipv4.igmp_max_memberships)
+ *      ifname      - string, receive with the AF_PACKET memory-mapped ring (TPACKET_V3)
+ *                    on the interface instead of the UDP socket. datagrams are selected
+ *                    with BPF filter by addr and port, TS packets are sent downstream
+ *                    from the ring without copying. requires CAP_NET_RAW.
+ *                    merge and groups are not used
+ *      ring_size   - number, size of the ring in megabytes. default: 16
+ *      iat         - boolean, collect inter-arrival time of the datagrams
+ *                    to measure the jitter of the source. kernel receive time
+ *                    of the last datagram is taken on each read, so datagrams
+ *                    of one batch have the same time (use batch = 1)
  *
  * Module Methods:
+ *      stream([addr])
+ *                  - return stream. with groups, addr - stream of the group
  *      port()      - return number, random port number
+ *      status()    - return table, RTP counters:
+ *                    packets, lost, reordered, late, duplicate, recovered.
+ *                    with FEC, lost is the number of unrecoverable datagrams.
+ *                    with merge, legs - list of the counters for each source:
+ *                    addr, port, packets, lost, duplicate (RAW UDP - in TS packets)
+ *                    with iat, iat - inter-arrival time and jitter - deviation
+ *                    of the inter-arrival time from the average, in microseconds:
+ *                    count, avg, p50, p99, p999, max
  */
 
-#include <astra.h>
+#include "fec.h"
+#include "merge.h"
+#include "packet.h"
 
-#define UDP_BUFFER_SIZE 1460
-#define RTP_HEADER_SIZE 12
-
-#define RTP_IS_EXT(_data) ((_data[0] & 0x10))
-#define RTP_EXT_SIZE(_data) \
-    (((_data[RTP_HEADER_SIZE + 2] << 8) | _data[RTP_HEADER_SIZE + 3]) * 4 + 4)
+#define UDP_BUFFER_SIZE 1500
+#define UDP_BUFFER_MAX 65536
+#define UDP_BATCH_SIZE 16
+#define UDP_BATCH_MAX 1024
+#define UDP_SLAB_POOL 8
+#define RTP_REORDER_DEPTH 128
+#define RTP_REORDER_DELAY 50
+#define RTP_FEC_DEPTH 256
+#define RTP_FEC_DELAY 500
+#define RTP_REORDER_MAX 4096
+#define UDP_MERGE_SKEW 50
+#define UDP_GROUP_NONE 0xFFFFFFFF
 
 #define MSG(_msg) "[udp_input %s:%d] " _msg, mod->config.addr, mod->config.port
 
+typedef struct
+{
+    module_data_t *mod;
+    uint32_t id;
+
+    const char *addr;
+    int port;
+    const char *localaddr;
+
+    asc_socket_t *sock;
+    rtp_reorder_t rtp; // counters of the source only
+} udp_leg_t;
+
+typedef struct
+{
+    const char *addr;
+    uint32_t s_addr; // network byte order
+    bool is_joined;
+    module_stream_t stream;
+} udp_group_t;
+
 struct module_data_t
 {
     MODULE_STREAM_DATA();
@@ -55,113 +126,985 @@ struct module_data_t
         int port;
         const char *localaddr;
         bool rtp;
+        int batch;
+        int reorder;
+        int reorder_delay;
+        bool fec;
+        int skew;
+        bool iat;
     } config;
 
     bool is_error_message;
 
-    asc_socket_t *sock;
+    /* main source and the redundant sources */
+    udp_leg_t leg_list[MERGE_LEG_MAX];
+    uint32_t leg_count;
+    merge_window_t *merge;
+
+    /* groups received with the main socket */
+    udp_group_t *group_list;
+    uint32_t group_count;
+    udp_group_t **group_table; // hash table by the destination address
+    uint32_t group_table_size;
+    uint32_t *dst_list;
+
+    packet_ring_t *ring;
+    uint64_t ring_time; // time of the current ring read
+
     asc_timer_t *timer_renew;
+    asc_timer_t *timer_reorder;
 
-    uint8_t buffer[UDP_BUFFER_SIZE];
+    /* datagrams are received with the buffer_size step */
+    size_t buffer_size;
+    size_t *len_list;
+    stream_slab_pool_t *slab_pool; // slabs of the buffer_size * batch
+    stream_slab_t *slab;
+
+    rtp_reorder_t rtp;
+    stream_slab_t *rtp_slab; // copies of the datagrams released by the reorder buffer
+
+    asc_socket_t *fec_column;
+    asc_socket_t *fec_row;
+    fec_recovery_t *fec;
+
+    /* TS payload to send downstream */
+    stream_slab_t *send_slab;
+    uint8_t *send_buffer;
+    size_t send_skip;
+
+    /* inter-arrival time, microseconds */
+    uint64_t iat_last;
+    asc_histogram_t *iat;
+    asc_histogram_t *jitter;
 };
 
+static void udp_socket_close(asc_socket_t **sock)
+{
+    if(*sock)
+    {
+        asc_socket_multicast_leave(*sock);
+        asc_socket_close(*sock);
+        *sock = NULL;
+    }
+}
+
 static void on_close(void *arg)
 {
     module_data_t *mod = (module_data_t *)arg;
 
-    if(mod->sock)
-    {
-        asc_socket_multicast_leave(mod->sock);
-        asc_socket_close(mod->sock);
-        mod->sock = NULL;
-    }
+    for(uint32_t i = 0; i < mod->leg_count; ++i)
+        udp_socket_close(&mod->leg_list[i].sock);
+
+    ASC_FREE(mod->ring, packet_ring_destroy);
+
+    udp_socket_close(&mod->fec_column);
+    udp_socket_close(&mod->fec_row);
 
     if(mod->timer_renew)
     {
         asc_timer_destroy(mod->timer_renew);
         mod->timer_renew = NULL;
     }
+
+    if(mod->timer_reorder)
+    {
+        asc_timer_destroy(mod->timer_reorder);
+        mod->timer_reorder = NULL;
+    }
 }
 
-static void on_read(void *arg)
+static void send_begin(module_data_t *mod)
+{
+    mod->send_slab = mod->slab;
+    if(mod->rtp.depth > 0)
+    {
+        /*
+         * reorder buffer keeps datagrams in own storage,
+         * released datagrams are copied to the slab
+         */
+        if(stream_slab_is_shared(mod->rtp_slab))
+        {
+            stream_slab_unref(mod->rtp_slab);
+            mod->rtp_slab = stream_slab_pool_get(mod->slab_pool);
+        }
+        mod->send_slab = mod->rtp_slab;
+    }
+
+    mod->send_buffer = mod->send_slab->buffer;
+    mod->send_skip = 0;
+}
+
+static void send_flush(module_data_t *mod)
+{
+    if(mod->send_skip > 0)
+    {
+        module_stream_send_slab(  mod, mod->send_slab, mod->send_buffer
+                                , mod->send_skip / TS_PACKET_SIZE);
+        mod->send_skip = 0;
+    }
+}
+
+static void send_end(module_data_t *mod, uint64_t lost)
+{
+    if(mod->rtp.stat.lost > lost)
+        asc_log_debug(MSG("rtp: lost %d datagrams"), (int)(mod->rtp.stat.lost - lost));
+
+    send_flush(mod);
+}
+
+static void on_payload(void *arg, const uint8_t *payload, size_t size)
+{
+    module_data_t *mod = (module_data_t *)arg;
+
+    if(!mod->send_buffer)
+    {
+        /* AF_PACKET ring: sent in place */
+        module_stream_send_batch(mod, payload, size / TS_PACKET_SIZE);
+        return;
+    }
+
+    if(mod->send_skip + size > mod->send_slab->size)
+    {
+        /* reorder buffer releases more datagrams than the slab holds */
+        send_flush(mod);
+        send_begin(mod);
+    }
+
+    uint8_t *dst = &mod->send_buffer[mod->send_skip];
+    if(dst != payload)
+        memmove(dst, payload, size);
+    mod->send_skip += size;
+}
+
+/* releases the reorder buffer if the stream is interrupted */
+static void timer_reorder_callback(void *arg)
 {
     module_data_t *mod = (module_data_t *)arg;
+    if(mod->rtp.count == 0)
+        return;
+
+    const uint64_t lost = mod->rtp.stat.lost;
+    send_begin(mod);
+    rtp_reorder_timeout(&mod->rtp, asc_utime());
+    send_end(mod, lost);
+}
+
+static void on_leg_close(void *arg)
+{
+    udp_leg_t *leg = (udp_leg_t *)arg;
+    module_data_t *mod = leg->mod;
 
-    int len = asc_socket_recv(mod->sock, mod->buffer, UDP_BUFFER_SIZE);
-    if(len <= 0)
+    udp_socket_close(&leg->sock);
+
+    for(uint32_t i = 0; i < mod->leg_count; ++i)
     {
-        if(len == 0 || errno == EAGAIN || errno == EWOULDBLOCK)
+        if(mod->leg_list[i].sock)
+        {
+            asc_log_error(MSG("source %s:%d is closed"), leg->addr, leg->port);
             return;
+        }
+    }
+
+    on_close(mod);
+}
+
+static void on_leg_payload(void *arg, const uint8_t *payload, size_t size)
+{
+    __uarg(arg);
+    __uarg(payload);
+    __uarg(size);
+}
+
+/* RAW UDP: sends TS packets received first time */
+static void merge_payload(  module_data_t *mod, udp_leg_t *leg
+                          , const uint8_t *data, size_t size, uint64_t time)
+{
+    for(size_t i = 0; i < size; i += TS_PACKET_SIZE)
+    {
+        if(merge_window_push(mod->merge, leg->id, &data[i], time))
+            on_payload(mod, &data[i], TS_PACKET_SIZE);
+    }
+}
 
-        on_close(mod);
+/* datagram is truncated. increase the receiving buffer */
+static void buffer_resize(module_data_t *mod, size_t truncated)
+{
+    if(mod->buffer_size >= UDP_BUFFER_MAX)
         return;
+
+    asc_log_warning(MSG("datagram size %d is greater than buffer. increase buffer")
+                    , (int)truncated);
+
+    mod->buffer_size = (truncated + 3) & ~(size_t)3;
+    if(mod->buffer_size > UDP_BUFFER_MAX)
+        mod->buffer_size = UDP_BUFFER_MAX;
+
+    stream_slab_unref(mod->slab);
+    stream_slab_pool_destroy(mod->slab_pool);
+    mod->slab_pool = stream_slab_pool_init(mod->buffer_size * mod->config.batch, UDP_SLAB_POOL);
+    mod->slab = stream_slab_pool_get(mod->slab_pool);
+
+    if(mod->rtp_slab)
+    {
+        stream_slab_unref(mod->rtp_slab);
+        mod->rtp_slab = stream_slab_pool_get(mod->slab_pool);
     }
+}
+
+static void datagram_push(  module_data_t *mod, udp_leg_t *leg
+                          , const uint8_t *data, size_t len, uint64_t now)
+{
+    size_t i = 0;
+
+    if(mod->config.rtp)
+    {
+        i = rtp_header_size(data, len);
+        if(i == 0)
+            return;
+    }
+
+    const size_t size = ((len - i) / TS_PACKET_SIZE) * TS_PACKET_SIZE;
 
-    int i = 0;
+    if(i + size != len && !mod->is_error_message)
+    {
+        asc_log_error(MSG("wrong stream format. drop %d bytes"), (int)(len - i - size));
+        mod->is_error_message = true;
+    }
 
     if(mod->config.rtp)
     {
-        i = RTP_HEADER_SIZE;
-        if(RTP_IS_EXT(mod->buffer))
+        const uint16_t seq = RTP_GET_SEQ(data);
+        if(mod->leg_count > 1)
+            rtp_reorder_push(&leg->rtp, seq, &data[i], size, now);
+        rtp_reorder_push(&mod->rtp, seq, &data[i], size, now);
+    }
+    else if(mod->merge)
+        merge_payload(mod, leg, &data[i], size, now);
+    else if(size > 0)
+        on_payload(mod, &data[i], size);
+}
+
+/* after the received datagrams */
+static void datagram_end(module_data_t *mod, uint64_t now)
+{
+    if(mod->config.rtp)
+    {
+        if(mod->fec && mod->fec->count > 0 && mod->rtp.count > 0)
+            fec_recovery_run(mod->fec, &mod->rtp, now);
+
+        rtp_reorder_timeout(&mod->rtp, now);
+    }
+}
+
+static void iat_push(module_data_t *mod, udp_leg_t *leg, int count)
+{
+    /* kernel time excludes the delay of the main loop */
+    uint64_t now = asc_socket_recv_time(leg->sock);
+    if(now == 0)
+        now = asc_utime();
+
+    for(int i = 0; i < count; ++i)
+    {
+        if(mod->iat_last > 0)
         {
-            if(len < RTP_HEADER_SIZE + 4)
-                return;
-            i += RTP_EXT_SIZE(mod->buffer);
+            const uint64_t iat = (i == 0 && now > mod->iat_last) ? (now - mod->iat_last) : 0;
+            asc_histogram_add(mod->iat, iat);
+
+            const uint64_t avg = mod->iat->total / mod->iat->count;
+            asc_histogram_add(mod->jitter, (iat > avg) ? (iat - avg) : (avg - iat));
         }
+        mod->iat_last = now;
     }
+}
 
-    for(; i <= len - TS_PACKET_SIZE; i += TS_PACKET_SIZE)
-        module_stream_send(mod, &mod->buffer[i]);
+static void on_read(void *arg)
+{
+    udp_leg_t *leg = (udp_leg_t *)arg;
+    module_data_t *mod = leg->mod;
 
-    if(i != len && !mod->is_error_message)
+    if(stream_slab_is_shared(mod->slab))
     {
-        asc_log_error(MSG("wrong stream format. drop %d bytes"), len - i);
-        mod->is_error_message = true;
+        /* previous datagrams are still referenced by the stream children */
+        stream_slab_unref(mod->slab);
+        mod->slab = stream_slab_pool_get(mod->slab_pool);
+    }
+    uint8_t *buffer = mod->slab->buffer;
+
+    const int ret = asc_socket_recv_batch(  leg->sock, buffer, mod->buffer_size
+                                          , mod->len_list, mod->config.batch);
+    if(ret <= 0)
+    {
+        if(ret == 0 || errno == EAGAIN || errno == EWOULDBLOCK)
+            return;
+
+        on_leg_close(leg);
+        return;
     }
+
+    /* TS packets are moved together to send them downstream at once */
+    send_begin(mod);
+
+    const uint64_t lost = mod->rtp.stat.lost;
+    const uint64_t now = (mod->rtp.delay > 0 || mod->merge) ? asc_utime() : 0;
+    size_t truncated = 0;
+
+    for(int n = 0; n < ret; ++n)
+    {
+        const uint8_t *data = &buffer[n * mod->buffer_size];
+        size_t len = mod->len_list[n];
+
+        if(len > mod->buffer_size)
+        {
+            if(len > truncated)
+                truncated = len;
+            len = mod->buffer_size;
+        }
+
+        datagram_push(mod, leg, data, len, now);
+    }
+
+    datagram_end(mod, now);
+    send_end(mod, lost);
+
+    if(mod->iat)
+        iat_push(mod, leg, ret);
+
+    if(truncated > 0)
+        buffer_resize(mod, truncated);
+}
+
+/*
+ * groups: one socket joins many multicast groups on the same port.
+ * datagrams are dispatched to the group stream by the destination address
+ */
+
+static udp_group_t * group_find(module_data_t *mod, uint32_t s_addr)
+{
+    const uint32_t mask = mod->group_table_size - 1;
+    uint32_t i = (s_addr ^ (s_addr >> 16)) * 0x9E3779B1U;
+    for(i &= mask; mod->group_table[i]; i = (i + 1) & mask)
+    {
+        if(mod->group_table[i]->s_addr == s_addr)
+            return mod->group_table[i];
+    }
+    return NULL;
+}
+
+static void on_read_group(void *arg)
+{
+    udp_leg_t *leg = (udp_leg_t *)arg;
+    module_data_t *mod = leg->mod;
+
+    if(stream_slab_is_shared(mod->slab))
+    {
+        stream_slab_unref(mod->slab);
+        mod->slab = stream_slab_pool_get(mod->slab_pool);
+    }
+    uint8_t *buffer = mod->slab->buffer;
+
+    const int ret = asc_socket_recv_batch_dst(  leg->sock, buffer, mod->buffer_size
+                                              , mod->len_list, mod->dst_list
+                                              , mod->config.batch);
+    if(ret <= 0)
+    {
+        if(ret == 0 || errno == EAGAIN || errno == EWOULDBLOCK)
+            return;
+
+        on_leg_close(leg);
+        return;
+    }
+
+    size_t truncated = 0;
+
+    for(int n = 0; n < ret; ++n)
+    {
+        udp_group_t *group = group_find(mod, mod->dst_list[n]);
+        if(!group)
+            continue;
+
+        const uint8_t *data = &buffer[n * mod->buffer_size];
+        size_t len = mod->len_list[n];
+
+        if(len > mod->buffer_size)
+        {
+            if(len > truncated)
+                truncated = len;
+            len = mod->buffer_size;
+        }
+
+        size_t i = 0;
+
+        if(mod->config.rtp)
+        {
+            i = rtp_header_size(data, len);
+            if(i == 0)
+                continue;
+        }
+
+        const size_t count = (len - i) / TS_PACKET_SIZE;
+
+        if(i + count * TS_PACKET_SIZE != len && !mod->is_error_message)
+        {
+            asc_log_error(MSG("wrong stream format in the group %s"), group->addr);
+            mod->is_error_message = true;
+        }
+
+        if(count > 0)
+            __module_stream_send_slab(&group->stream, mod->slab, &data[i], count);
+    }
+
+    if(truncated > 0)
+        buffer_resize(mod, truncated);
+}
+
+static uint32_t group_parse_addr(const char *addr)
+{
+    unsigned int a[4];
+    char tail;
+    if(sscanf(addr, "%u.%u.%u.%u%c", &a[0], &a[1], &a[2], &a[3], &tail) != 4)
+        return UDP_GROUP_NONE;
+    if(a[0] > 255 || a[1] > 255 || a[2] > 255 || a[3] > 255)
+        return UDP_GROUP_NONE;
+
+    /* network byte order */
+    const uint8_t octets[4] = { (uint8_t)a[0], (uint8_t)a[1], (uint8_t)a[2], (uint8_t)a[3] };
+    uint32_t s_addr;
+    memcpy(&s_addr, octets, sizeof(s_addr));
+    return s_addr;
+}
+
+static void group_init(module_data_t *mod)
+{
+    mod->group_count = luaL_len(lua, -1);
+    mod->group_list = (udp_group_t *)calloc(mod->group_count, sizeof(udp_group_t));
+
+    mod->group_table_size = 16;
+    while(mod->group_table_size < mod->group_count * 2)
+        mod->group_table_size <<= 1;
+    mod->group_table = (udp_group_t **)calloc(mod->group_table_size, sizeof(udp_group_t *));
+
+    uint32_t count = 0;
+    lua_foreach(lua, -2)
+    {
+        const char *addr = lua_tostring(lua, -1);
+        asc_assert((addr != NULL), "[udp_input] option 'groups': wrong type");
+
+        const uint32_t s_addr = group_parse_addr(addr);
+        asc_assert((s_addr != UDP_GROUP_NONE)
+                   , "[udp_input] option 'groups': wrong address %s", addr);
+        if(group_find(mod, s_addr))
+            continue;
+
+        udp_group_t *group = &mod->group_list[count++];
+        group->addr = addr;
+        group->s_addr = s_addr;
+
+        group->stream.self = mod;
+        __module_stream_init(&group->stream);
+
+        char name[128];
+        snprintf(name, sizeof(name), "udp_input %s:%d", addr, mod->config.port);
+        group->stream.name = strdup(name);
+
+        const uint32_t mask = mod->group_table_size - 1;
+        uint32_t i = (s_addr ^ (s_addr >> 16)) * 0x9E3779B1U;
+        for(i &= mask; mod->group_table[i]; i = (i + 1) & mask)
+            ;
+        mod->group_table[i] = group;
+    }
+    mod->group_count = count;
+
+    mod->dst_list = (uint32_t *)calloc(mod->config.batch, sizeof(uint32_t));
+}
+
+static bool group_open(module_data_t *mod, udp_leg_t *leg, int socket_size)
+{
+    leg->sock = asc_socket_open_udp4(leg);
+    asc_socket_set_reuseaddr(leg->sock, 1);
+    if(!asc_socket_bind(leg->sock, NULL, leg->port))
+    {
+        asc_socket_close(leg->sock);
+        leg->sock = NULL;
+        return false;
+    }
+
+    if(!asc_socket_set_pktinfo(leg->sock, true))
+    {
+        asc_log_error(MSG("groups are not supported"));
+        asc_socket_close(leg->sock);
+        leg->sock = NULL;
+        return false;
+    }
+
+    if(socket_size > 0)
+        asc_socket_set_buffer(leg->sock, socket_size, 0);
+
+    asc_socket_set_on_read(leg->sock, on_read_group);
+    asc_socket_set_on_close(leg->sock, on_leg_close);
+
+    for(uint32_t i = 0; i < mod->group_count; ++i)
+    {
+        udp_group_t *group = &mod->group_list[i];
+        group->is_joined = asc_socket_multicast_group(  leg->sock, group->addr
+                                                      , leg->localaddr, true);
+    }
+
+    return true;
+}
+
+static void group_renew(module_data_t *mod)
+{
+    asc_socket_t *sock = mod->leg_list[0].sock;
+    for(uint32_t i = 0; i < mod->group_count; ++i)
+    {
+        udp_group_t *group = &mod->group_list[i];
+        if(group->is_joined)
+            asc_socket_multicast_group(sock, group->addr, mod->config.localaddr, false);
+        group->is_joined = asc_socket_multicast_group(  sock, group->addr
+                                                      , mod->config.localaddr, true);
+    }
+}
+
+static void group_destroy(module_data_t *mod)
+{
+    asc_socket_t *sock = mod->leg_list[0].sock;
+    for(uint32_t i = 0; i < mod->group_count; ++i)
+    {
+        udp_group_t *group = &mod->group_list[i];
+        if(sock && group->is_joined)
+            asc_socket_multicast_group(sock, group->addr, mod->config.localaddr, false);
+        __module_stream_destroy(&group->stream);
+    }
+
+    ASC_FREE(mod->group_list, free);
+    ASC_FREE(mod->group_table, free);
+    ASC_FREE(mod->dst_list, free);
+    mod->group_count = 0;
+}
+
+/*
+ * AF_PACKET ring: datagrams of the main source are received on the interface
+ */
+
+static void on_ring_datagram(void *arg, const uint8_t *data, size_t size)
+{
+    module_data_t *mod = (module_data_t *)arg;
+    datagram_push(mod, &mod->leg_list[0], data, size, mod->ring_time);
+}
+
+static void on_read_ring(void *arg)
+{
+    module_data_t *mod = (module_data_t *)arg;
+
+    /* payload is sent from the ring without copying */
+    mod->send_slab = NULL;
+    mod->send_buffer = NULL;
+    mod->send_skip = 0;
+
+    const uint64_t lost = mod->rtp.stat.lost;
+    mod->ring_time = (mod->rtp.delay > 0) ? asc_utime() : 0;
+
+    if(packet_ring_read(mod->ring, on_ring_datagram) > 0)
+        datagram_end(mod, mod->ring_time);
+
+    send_end(mod, lost);
+}
+
+static bool ring_open(module_data_t *mod, const char *ifname, int ring_size)
+{
+    udp_leg_t *leg = &mod->leg_list[0];
+    const uint32_t addr = group_parse_addr(leg->addr);
+    const uint8_t first = ((const uint8_t *)&addr)[0]; // network byte order
+    const bool is_multicast = (addr != UDP_GROUP_NONE) && ((first >> 4) == 0xE);
+
+    /*
+     * socket for the multicast subscription. bound to the other port,
+     * datagrams are not queued. with unicast the socket is bound to the port
+     * to prevent ICMP port unreachable
+     */
+    leg->sock = asc_socket_open_udp4(leg);
+    asc_socket_set_reuseaddr(leg->sock, 1);
+    if(!asc_socket_bind(leg->sock, NULL, (is_multicast) ? 0 : leg->port))
+    {
+        asc_socket_close(leg->sock);
+        leg->sock = NULL;
+        return false;
+    }
+    if(is_multicast)
+        asc_socket_multicast_join(leg->sock, leg->addr, leg->localaddr);
+    else
+        asc_socket_set_buffer(leg->sock, 1, 0);
+
+    mod->ring = packet_ring_init(  ifname, (addr == UDP_GROUP_NONE) ? 0 : addr, leg->port
+                                 , (size_t)ring_size << 20, mod);
+    if(!mod->ring)
+        return false;
+
+    packet_ring_set_on_read(mod->ring, on_read_ring);
+    return true;
+}
+
+/*
+ * ooooooooooo ooooooooooo  oooooooo8
+ *  888    88   888    88 o888     88
+ *  888ooo8     888ooo8   888
+ *  888         888    oo 888o     oo
+ * o888o       o888ooo8888 888oooo88
+ *
+ */
+
+static void fec_read(module_data_t *mod, asc_socket_t *sock)
+{
+    uint8_t buffer[RTP_HEADER_SIZE + FEC_HEADER_SIZE + FEC_PAYLOAD_SIZE];
+
+    for(int i = 0; i < mod->config.batch; ++i)
+    {
+        const ssize_t len = asc_socket_recv(sock, buffer, sizeof(buffer));
+        if(len <= 0)
+            break;
+
+        if(!fec_recovery_push(mod->fec, buffer, len) && !mod->is_error_message)
+        {
+            asc_log_error(MSG("wrong FEC packet format"));
+            mod->is_error_message = true;
+        }
+    }
+
+    if(mod->rtp.count == 0)
+        return;
+
+    const uint64_t lost = mod->rtp.stat.lost;
+    send_begin(mod);
+    fec_recovery_run(mod->fec, &mod->rtp, asc_utime());
+    send_end(mod, lost);
+}
+
+static void on_read_fec_column(void *arg)
+{
+    module_data_t *mod = (module_data_t *)arg;
+    fec_read(mod, mod->fec_column);
+}
+
+static void on_read_fec_row(void *arg)
+{
+    module_data_t *mod = (module_data_t *)arg;
+    fec_read(mod, mod->fec_row);
+}
+
+static asc_socket_t * fec_socket_open(module_data_t *mod, int port, event_callback_t on_read)
+{
+    asc_socket_t *sock = asc_socket_open_udp4(mod);
+    asc_socket_set_reuseaddr(sock, 1);
+#ifdef _WIN32
+    if(!asc_socket_bind(sock, NULL, port))
+#else
+    if(!asc_socket_bind(sock, mod->config.addr, port))
+#endif
+    {
+        asc_log_error(MSG("failed to open FEC port %d [%s]"), port, asc_socket_error());
+        asc_socket_close(sock);
+        return NULL;
+    }
+
+    asc_socket_set_on_read(sock, on_read);
+    asc_socket_multicast_join(sock, mod->config.addr, mod->config.localaddr);
+    return sock;
 }
 
 static void timer_renew_callback(void *arg)
 {
     module_data_t *mod = (module_data_t *)arg;
-    asc_socket_multicast_renew(mod->sock);
+    for(uint32_t i = 0; i < mod->leg_count; ++i)
+    {
+        if(mod->leg_list[i].sock)
+            asc_socket_multicast_renew(mod->leg_list[i].sock);
+    }
+    if(mod->group_count > 0 && mod->leg_list[0].sock)
+        group_renew(mod);
+    if(mod->fec_column)
+        asc_socket_multicast_renew(mod->fec_column);
+    if(mod->fec_row)
+        asc_socket_multicast_renew(mod->fec_row);
+}
+
+MODULE_STREAM_METHODS()
+
+static int method_stream(module_data_t *mod)
+{
+    if(lua_type(lua, 2) != LUA_TSTRING)
+        return module_stream_stream(mod);
+
+    const char *addr = lua_tostring(lua, 2);
+    udp_group_t *group = (mod->group_count > 0) ? group_find(mod, group_parse_addr(addr)) : NULL;
+    if(!group)
+    {
+        asc_log_error(MSG("group %s is not found"), addr);
+        lua_pushnil(lua);
+        return 1;
+    }
+
+    lua_pushlightuserdata(lua, &group->stream);
+    return 1;
 }
 
 static int method_port(module_data_t *mod)
 {
-    const int port = asc_socket_port(mod->sock);
+    const int port = asc_socket_port(mod->leg_list[0].sock);
     lua_pushnumber(lua, port);
     return 1;
 }
 
+static int method_status(module_data_t *mod)
+{
+    rtp_stat_push(&mod->rtp.stat);
+
+    if(mod->leg_count > 1)
+    {
+        lua_newtable(lua);
+        for(uint32_t i = 0; i < mod->leg_count; ++i)
+        {
+            const udp_leg_t *leg = &mod->leg_list[i];
+            rtp_stat_push((mod->merge) ? &mod->merge->stat[i] : &leg->rtp.stat);
+            lua_pushstring(lua, leg->addr);
+            lua_setfield(lua, -2, "addr");
+            lua_pushnumber(lua, leg->port);
+            lua_setfield(lua, -2, "port");
+            lua_rawseti(lua, -2, i + 1);
+        }
+        lua_setfield(lua, -2, "legs");
+    }
+
+    if(mod->iat)
+    {
+        udp_histogram_push(mod->iat, "iat");
+        udp_histogram_push(mod->jitter, "jitter");
+    }
+
+    return 1;
+}
+
+static bool leg_open(module_data_t *mod, udp_leg_t *leg, int socket_size)
+{
+    leg->sock = asc_socket_open_udp4(leg);
+    asc_socket_set_reuseaddr(leg->sock, 1);
+#ifdef _WIN32
+    if(!asc_socket_bind(leg->sock, NULL, leg->port))
+#else
+    if(!asc_socket_bind(leg->sock, leg->addr, leg->port))
+#endif
+    {
+        asc_socket_close(leg->sock);
+        leg->sock = NULL;
+        return false;
+    }
+
+    if(socket_size > 0)
+        asc_socket_set_buffer(leg->sock, socket_size, 0);
+
+    if(mod->leg_count > 1 && mod->config.rtp)
+        rtp_reorder_init(&leg->rtp, 0, 0, 0, on_leg_payload, leg);
+
+    if(mod->iat)
+        asc_socket_recv_time(leg->sock); /* enable timestamping */
+
+    asc_socket_set_on_read(leg->sock, on_read);
+    asc_socket_set_on_close(leg->sock, on_leg_close);
+    asc_socket_multicast_join(leg->sock, leg->addr, leg->localaddr);
+
+    return true;
+}
+
 static void module_init(module_data_t *mod)
 {
     module_stream_init(mod, NULL);
 
     module_option_string("addr", &mod->config.addr, NULL);
+
+    lua_getfield(lua, MODULE_OPTIONS_IDX, "groups");
+    const bool is_groups = lua_istable(lua, -1);
+    lua_pop(lua, 1);
+    if(is_groups && !mod->config.addr)
+        mod->config.addr = "0.0.0.0";
+
     asc_assert(mod->config.addr != NULL, "[udp_input] option 'addr' is required");
 
     module_option_number("port", &mod->config.port);
+    module_option_string("localaddr", &mod->config.localaddr, NULL);
 
-    mod->sock = asc_socket_open_udp4(mod);
-    asc_socket_set_reuseaddr(mod->sock, 1);
-#ifdef _WIN32
-    if(!asc_socket_bind(mod->sock, NULL, mod->config.port))
-#else
-    if(!asc_socket_bind(mod->sock, mod->config.addr, mod->config.port))
-#endif
-        return;
+    udp_leg_t *leg = &mod->leg_list[0];
+    leg->addr = mod->config.addr;
+    leg->port = mod->config.port;
+    leg->localaddr = mod->config.localaddr;
+    mod->leg_count = 1;
+
+    lua_getfield(lua, MODULE_OPTIONS_IDX, "merge");
+    if(lua_istable(lua, -1))
+    {
+        lua_foreach(lua, -2)
+        {
+            asc_assert((lua_type(lua, -1) == LUA_TTABLE)
+                       , "[udp_input] option 'merge': wrong type");
+            asc_assert((mod->leg_count < MERGE_LEG_MAX)
+                       , "[udp_input] option 'merge': too many sources");
+
+            leg = &mod->leg_list[mod->leg_count];
+
+            lua_getfield(lua, -1, "addr");
+            leg->addr = lua_tostring(lua, -1);
+            lua_pop(lua, 1);
+            asc_assert((leg->addr != NULL), "[udp_input] option 'merge': 'addr' is required");
+
+            lua_getfield(lua, -1, "port");
+            leg->port = (lua_isnil(lua, -1)) ? mod->config.port : lua_tonumber(lua, -1);
+            lua_pop(lua, 1);
+
+            lua_getfield(lua, -1, "localaddr");
+            leg->localaddr = (lua_isnil(lua, -1)) ? mod->config.localaddr : lua_tostring(lua, -1);
+            lua_pop(lua, 1);
+
+            ++mod->leg_count;
+        }
+    }
+    lua_pop(lua, 1); // merge
+
+    for(uint32_t i = 0; i < mod->leg_count; ++i)
+    {
+        mod->leg_list[i].mod = mod;
+        mod->leg_list[i].id = i;
+    }
+
+    mod->config.skew = UDP_MERGE_SKEW;
+    module_option_number("skew", &mod->config.skew);
+    if(mod->config.skew < 1)
+        mod->config.skew = 1;
 
     int value;
-    if(module_option_number("socket_size", &value))
-        asc_socket_set_buffer(mod->sock, value, 0);
+    int socket_size = 0;
+    module_option_number("socket_size", &socket_size);
+
+    const char *ifname = NULL;
+    module_option_string("ifname", &ifname, NULL);
+    if(ifname && mod->leg_count > 1)
+    {
+        asc_log_warning(MSG("option 'merge' is not used with 'ifname'"));
+        mod->leg_count = 1;
+    }
 
     module_option_boolean("rtp", &mod->config.rtp);
 
-    asc_socket_set_on_read(mod->sock, on_read);
-    asc_socket_set_on_close(mod->sock, on_close);
+    mod->config.batch = UDP_BATCH_SIZE;
+    module_option_number("batch", &mod->config.batch);
+    if(mod->config.batch < 1)
+        mod->config.batch = 1;
+    else if(mod->config.batch > UDP_BATCH_MAX)
+        mod->config.batch = UDP_BATCH_MAX;
 
-    module_option_string("localaddr", &mod->config.localaddr, NULL);
-    asc_socket_multicast_join(mod->sock, mod->config.addr, mod->config.localaddr);
+    mod->buffer_size = UDP_BUFFER_SIZE;
+    mod->len_list = (size_t *)calloc(mod->config.batch, sizeof(size_t));
+    mod->slab_pool = stream_slab_pool_init(mod->buffer_size * mod->config.batch, UDP_SLAB_POOL);
+    mod->slab = stream_slab_pool_get(mod->slab_pool);
+
+    module_option_boolean("iat", &mod->config.iat);
+    if(mod->config.iat)
+    {
+        mod->iat = (asc_histogram_t *)calloc(1, sizeof(asc_histogram_t));
+        mod->jitter = (asc_histogram_t *)calloc(1, sizeof(asc_histogram_t));
+    }
+
+    if(is_groups)
+    {
+        lua_getfield(lua, MODULE_OPTIONS_IDX, "groups");
+        group_init(mod);
+        lua_pop(lua, 1);
+
+        if(group_open(mod, &mod->leg_list[0], socket_size))
+        {
+            if(module_option_number("renew", &value))
+                mod->timer_renew = asc_timer_init(value * 1000, timer_renew_callback, mod);
+        }
+        return;
+    }
+
+    if(mod->config.rtp)
+    {
+        module_option_number("reorder", &mod->config.reorder);
+        module_option_boolean("fec", &mod->config.fec);
+
+        mod->config.reorder_delay = RTP_REORDER_DELAY;
+        if(mod->leg_count > 1)
+        {
+            /* redundant sources are merged with the reorder buffer */
+            mod->config.reorder_delay = mod->config.skew;
+            if(mod->config.reorder <= 0)
+                mod->config.reorder = RTP_REORDER_DEPTH;
+        }
+        if(mod->config.fec)
+        {
+            mod->config.reorder_delay = RTP_FEC_DELAY;
+            if(mod->config.reorder <= 0)
+                mod->config.reorder = RTP_FEC_DEPTH;
+        }
+
+        if(module_option_number("reorder_delay", &mod->config.reorder_delay))
+        {
+            if(mod->config.reorder <= 0)
+                mod->config.reorder = RTP_REORDER_DEPTH;
+        }
+        if(mod->config.reorder_delay < 1)
+            mod->config.reorder_delay = 1;
+
+        if(mod->config.reorder < 0)
+            mod->config.reorder = 0;
+        else if(mod->config.reorder > RTP_REORDER_MAX)
+            mod->config.reorder = RTP_REORDER_MAX;
+
+        rtp_reorder_init(  &mod->rtp, mod->config.reorder, UDP_BUFFER_SIZE
+                         , mod->config.reorder_delay, on_payload, mod);
+        if(mod->rtp.depth > 0)
+        {
+            mod->rtp_slab = stream_slab_pool_get(mod->slab_pool);
+            mod->timer_reorder = asc_timer_init(  mod->config.reorder_delay
+                                                , timer_reorder_callback, mod);
+        }
+    }
+
+    else if(mod->leg_count > 1)
+    {
+        mod->merge = (merge_window_t *)malloc(sizeof(merge_window_t));
+        merge_window_init(mod->merge, mod->leg_count, mod->config.skew);
+    }
+
+    if(ifname)
+    {
+        int ring_size = PACKET_RING_SIZE;
+        module_option_number("ring_size", &ring_size);
+        if(ring_size < 1)
+            ring_size = 1;
+
+        if(!ring_open(mod, ifname, ring_size))
+            return;
+    }
+    else
+    {
+        if(!leg_open(mod, &mod->leg_list[0], socket_size))
+            return;
+
+        for(uint32_t i = 1; i < mod->leg_count; ++i)
+        {
+            leg = &mod->leg_list[i];
+            if(!leg_open(mod, leg, socket_size))
+                asc_log_error(MSG("failed to open source %s:%d"), leg->addr, leg->port);
+        }
+    }
+
+    if(mod->config.fec)
+    {
+        mod->fec = (fec_recovery_t *)calloc(1, sizeof(fec_recovery_t));
+        mod->fec_column = fec_socket_open(  mod, mod->config.port + FEC_COLUMN_PORT
+                                          , on_read_fec_column);
+        mod->fec_row = fec_socket_open(  mod, mod->config.port + FEC_ROW_PORT
+                                       , on_read_fec_row);
+    }
 
     if(module_option_number("renew", &value))
         mod->timer_renew = asc_timer_init(value * 1000, timer_renew_callback, mod);
@@ -171,14 +1114,32 @@ static void module_destroy(module_data_t *mod)
 {
     module_stream_destroy(mod);
 
+    if(mod->group_list)
+        group_destroy(mod);
+
     on_close(mod);
-}
 
-MODULE_STREAM_METHODS()
+    ASC_FREE(mod->slab, stream_slab_unref);
+    ASC_FREE(mod->len_list, free);
+    ASC_FREE(mod->rtp_slab, stream_slab_unref);
+    ASC_FREE(mod->slab_pool, stream_slab_pool_destroy);
+    rtp_reorder_destroy(&mod->rtp);
+    ASC_FREE(mod->fec, free);
+    ASC_FREE(mod->iat, free);
+    ASC_FREE(mod->jitter, free);
+
+    if(mod->merge)
+    {
+        merge_window_destroy(mod->merge);
+        ASC_FREE(mod->merge, free);
+    }
+}
 
 MODULE_LUA_METHODS()
 {
-    MODULE_STREAM_METHODS_REF(),
+    { "stream", method_stream },
+    { "stats", module_stream_stats },
     { "port", method_port },
+    { "status", method_status },
 };
 MODULE_LUA_REGISTER(udp_input)
@@ -0,0 +1,120 @@
+/*
+ * Astra Module: UDP (Merge)
+ * http://cesbo.com/astra
+ *
+ * Copyright (C) 2012-2015, Andrey Dyldin <and@cesbo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "merge.h"
+
+void merge_window_init(merge_window_t *merge, uint32_t leg_count, uint32_t delay_ms)
+{
+    memset(merge, 0, sizeof(merge_window_t));
+
+    merge->leg_count = leg_count;
+    merge->delay = (uint64_t)delay_ms * 1000;
+
+    const uint64_t count = (uint64_t)MERGE_RATE_MAX * delay_ms / 1000;
+    merge->size = 1024;
+    while(merge->size < count && merge->size < (1U << 20))
+        merge->size <<= 1;
+
+    merge->item_list = (merge_item_t *)calloc(merge->size, sizeof(merge_item_t));
+    merge->bucket_list = (uint64_t *)calloc(merge->size, sizeof(uint64_t));
+}
+
+void merge_window_destroy(merge_window_t *merge)
+{
+    ASC_FREE(merge->item_list, free);
+    ASC_FREE(merge->bucket_list, free);
+}
+
+static uint64_t merge_hash(const uint8_t *ts)
+{
+    uint64_t hash = 0x9E3779B97F4A7C15ULL;
+    uint64_t word;
+
+    size_t i = 0;
+    for(; i + 8 <= TS_PACKET_SIZE; i += 8)
+    {
+        memcpy(&word, &ts[i], 8);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+
+    word = 0;
+    memcpy(&word, &ts[i], TS_PACKET_SIZE - i);
+    hash = (hash ^ word) * 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 29;
+
+    return hash;
+}
+
+/* drops the oldest packet. sources without the packet are counted as lost */
+static void merge_window_drop(merge_window_t *merge)
+{
+    const merge_item_t *item = &merge->item_list[merge->tail & (merge->size - 1)];
+    for(uint32_t i = 0; i < merge->leg_count; ++i)
+    {
+        if(!(item->mask & (1U << i)))
+            ++merge->stat[i].lost;
+    }
+    ++merge->tail;
+}
+
+bool merge_window_push(merge_window_t *merge, uint32_t leg, const uint8_t *ts, uint64_t time)
+{
+    const uint32_t bit = 1U << leg;
+    const uint32_t mask = merge->size - 1;
+
+    ++merge->stat[leg].packets;
+
+    while(merge->tail < merge->head)
+    {
+        const merge_item_t *item = &merge->item_list[merge->tail & mask];
+        if(merge->head - merge->tail < merge->size && item->time + merge->delay >= time)
+            break;
+        merge_window_drop(merge);
+    }
+
+    const uint64_t hash = merge_hash(ts);
+    uint64_t *bucket = &merge->bucket_list[hash & mask];
+
+    /* packets in the bucket from the newest to the oldest */
+    uint64_t link = *bucket;
+    while(link > merge->tail)
+    {
+        merge_item_t *item = &merge->item_list[(link - 1) & mask];
+        if(item->hash == hash && !(item->mask & bit))
+        {
+            item->mask |= bit;
+            ++merge->stat[leg].duplicate;
+            return false;
+        }
+        link = item->next;
+    }
+
+    /* new packet. same packet from the same source is not a duplicate (e.g. null packets) */
+    merge_item_t *item = &merge->item_list[merge->head & mask];
+    item->hash = hash;
+    item->time = time;
+    item->mask = bit;
+    item->next = *bucket;
+    ++merge->head;
+    *bucket = merge->head;
+
+    return true;
+}
@@ -0,0 +1,67 @@
+/*
+ * Astra Module: UDP (Merge)
+ * http://cesbo.com/astra
+ *
+ * Copyright (C) 2012-2015, Andrey Dyldin <and@cesbo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MERGE_H_
+#define _MERGE_H_ 1
+
+#include "rtp.h"
+
+/*
+ * RAW UDP has no sequence numbers. TS packets of the redundant sources are
+ * compared by hash: the first copy is delivered, copies from the other
+ * sources received within the skew window are dropped
+ */
+
+#define MERGE_LEG_MAX 8
+
+/* TS packets per second to allocate the window. about 150 Mbit/s */
+#define MERGE_RATE_MAX 100000
+
+typedef struct
+{
+    uint64_t hash;
+    uint64_t time;
+    uint64_t next; // index + 1 of the previous packet in the same bucket, 0 - none
+    uint32_t mask; // sources delivered the packet
+} merge_item_t;
+
+typedef struct
+{
+    uint32_t size; // power of 2
+    uint64_t delay; // us
+    uint32_t leg_count;
+
+    merge_item_t *item_list;
+    uint64_t *bucket_list; // index + 1 of the last packet in the bucket, 0 - empty
+    uint64_t head; // index of the next packet
+    uint64_t tail; // index of the oldest packet
+
+    /* for each source. packets, lost - received by the other sources only,
+     * duplicate - received by the other source first */
+    rtp_stat_t stat[MERGE_LEG_MAX];
+} merge_window_t;
+
+void merge_window_init(merge_window_t *merge, uint32_t leg_count, uint32_t delay_ms);
+void merge_window_destroy(merge_window_t *merge);
+
+/* returns true if the packet is received first time */
+bool merge_window_push(merge_window_t *merge, uint32_t leg, const uint8_t *ts, uint64_t time);
+
+#endif /* _MERGE_H_ */
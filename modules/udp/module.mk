@@ -1,2 +1,2 @@
-SOURCES="input.c output.c"
+SOURCES="rtp.c fec.c merge.c packet.c input.c output.c"
 MODULES="udp_input udp_output"
@@ -33,13 +33,59 @@
  *      sync        - number, if greater then 0, then use MPEG-TS syncing.
  *                            average value of the stream bitrate in megabit per second
  *      cbr         - number, constant bitrate
+ *      txtime      - boolean, sync mode: pass departure time of each datagram
+ *                            to the kernel (SO_TXTIME). requires fq or etf qdisc
+ *      batch       - number, datagrams sent with one system call. default: 16, max: 64.
+ *                            datagrams are sent at the end of the event loop iteration
+ *                            or when the batch is full. not used with the sync option
+ *      gso         - boolean, use UDP segmentation offload if supported. default: true
+ *      fec_columns - number, RTP only. SMPTE 2022-1 FEC matrix columns (L).
+ *                            row FEC is sent to the port + 4
+ *      fec_rows    - number, FEC matrix rows (D). if greater than 1,
+ *                            column FEC is sent to the port + 2. L * D <= 100.
+ *                            default: 1 - 1D FEC, one FEC packet for each
+ *                            fec_columns datagrams is sent to the port + 2
+ *      loss        - number, drop each Nth datagram after the FEC calculation.
+ *                            to test the FEC recovery. default: 0 - disabled.
+ *                            only if built with -DUDP_OUTPUT_LOSS
+ *
+ * Module Methods:
+ *      status()    - return table, with sync: late - delay of the datagram sending
+ *                    after the wakeup time of the thread in microseconds:
+ *                    count, avg, p50, p99, p999, max
  */
 
-#include <astra.h>
+#include "fec.h"
+
+#ifdef __linux__
+#   include <sys/prctl.h>
+#endif
 
 #define MSG(_msg) "[udp_output %s:%d] " _msg, mod->addr, mod->port
 
 #define UDP_BUFFER_SIZE 1460
+#define UDP_TS_COUNT (UDP_BUFFER_SIZE / TS_PACKET_SIZE)
+
+#define UDP_BATCH_SIZE 16
+#define UDP_BATCH_MAX 64
+
+// SO_TXTIME: datagram is passed to the kernel before the departure time
+#define UDP_TXTIME_LEAD 2000
+
+typedef struct
+{
+    uint8_t buffer[UDP_BUFFER_SIZE]; // RTP header and copied packets
+
+    // datagram parts. packets of the upstream slab are not copied
+    struct iovec iov[UDP_TS_COUNT + 1];
+    int iov_count;
+    stream_slab_t *slab[UDP_TS_COUNT];
+    int slab_count;
+
+#ifdef UDP_OUTPUT_LOSS
+    bool is_drop; // see loss option
+#endif
+} udp_packet_t;
 
 struct module_data_t
 {
@@ -52,13 +98,32 @@ struct module_data_t
     bool is_rtp;
     uint16_t rtpseq;
 
+#ifdef UDP_OUTPUT_LOSS
+    uint32_t loss;
+    uint32_t loss_count;
+#endif
+
     asc_socket_t *sock;
 
-    struct
-    {
-        uint32_t skip;
-        uint8_t buffer[UDP_BUFFER_SIZE];
-    } packet;
+    // FEC packets are queued to send them after the media datagrams
+    fec_encoder_t *fec;
+    asc_socket_t *fec_row;
+    asc_socket_t *fec_column;
+    uint8_t *fec_buffer;
+    struct iovec *fec_iov;
+    asc_socket_datagram_t *fec_list;
+    bool *fec_is_row;
+    int fec_count;
+    int fec_size;
+
+    // ring of datagrams: packet_count completed from packet_head, then the current one
+    udp_packet_t *packet_list;
+    asc_socket_datagram_t *datagram_list;
+    int packet_head;
+    int packet_count;
+    int batch;
+    uint32_t skip; // size of the current datagram
+    bool is_flush; // flush is deferred to the end of the loop iteration
 
     bool is_thread_started;
     asc_thread_t *thread;
@@ -73,6 +138,14 @@ struct module_data_t
         uint32_t buffer_write;
 
         bool reload;
+
+        bool is_txtime;
+        uint64_t txtime; // departure time of the next datagram, ns
+
+        // delay of the datagram sending after the wakeup time.
+        // written by the thread, status() reads without lock
+        uint64_t wake_time;
+        asc_histogram_t late;
     } sync;
 
     uint64_t pcr;
@@ -81,48 +154,236 @@ struct module_data_t
 
 static const uint8_t null_ts[TS_PACKET_SIZE] = { 0x47, 0x1F, 0xFF, 0x10, 0x00 };
 
-static void on_ts(module_data_t *mod, const uint8_t *ts)
+static void packet_append(udp_packet_t *packet, const uint8_t *data, size_t size)
+{
+    if(packet->iov_count > 0)
+    {
+        struct iovec *iov = &packet->iov[packet->iov_count - 1];
+        if((const uint8_t *)iov->iov_base + iov->iov_len == data)
+        {
+            iov->iov_len += size;
+            return;
+        }
+    }
+
+    struct iovec *iov = &packet->iov[packet->iov_count];
+    iov->iov_base = (void *)data;
+    iov->iov_len = size;
+    ++packet->iov_count;
+}
+
+static void packet_release(udp_packet_t *packet)
+{
+    for(int i = 0; i < packet->slab_count; ++i)
+        stream_slab_unref(packet->slab[i]);
+
+    packet->slab_count = 0;
+    packet->iov_count = 0;
+#ifdef UDP_OUTPUT_LOSS
+    packet->is_drop = false;
+#endif
+}
+
+static void fec_flush(module_data_t *mod)
 {
-    if(mod->is_rtp && mod->packet.skip == 0)
+    /* row FEC first, then column FEC */
+    int count = 0;
+    for(int n = 0; n < 2; ++n)
+    {
+        const bool is_row = (n == 0);
+        for(int i = 0; i < mod->fec_count; ++i)
+        {
+            if(mod->fec_is_row[i] != is_row)
+                continue;
+            mod->fec_list[count].iov = &mod->fec_iov[i];
+            mod->fec_list[count].iov_count = 1;
+            mod->fec_list[count].txtime = 0;
+            ++count;
+        }
+
+        if(count > 0)
+        {
+            asc_socket_t *sock = (is_row) ? mod->fec_row : mod->fec_column;
+            if(asc_socket_sendto_batch(sock, mod->fec_list, count) != count)
+                asc_log_warning(MSG("error on FEC send [%s]"), asc_socket_error());
+            count = 0;
+        }
+    }
+
+    mod->fec_count = 0;
+}
+
+static void on_fec(void *arg, bool is_row, const uint8_t *data, size_t size)
+{
+    module_data_t *mod = (module_data_t *)arg;
+
+    if(mod->fec_count == mod->fec_size)
+        fec_flush(mod);
+
+    const int i = mod->fec_count;
+    uint8_t *dst = &mod->fec_buffer[i * FEC_PACKET_SIZE];
+    memcpy(dst, data, size);
+    mod->fec_iov[i].iov_base = dst;
+    mod->fec_iov[i].iov_len = size;
+    mod->fec_is_row[i] = is_row;
+    ++mod->fec_count;
+}
+
+static void packet_flush(module_data_t *mod)
+{
+    const int count = mod->packet_count;
+    if(count == 0)
+        return;
+
+    int send_count = 0;
+    for(int i = 0; i < count; ++i)
+    {
+        const udp_packet_t *packet = &mod->packet_list[(mod->packet_head + i) % mod->batch];
+#ifdef UDP_OUTPUT_LOSS
+        if(packet->is_drop)
+            continue;
+#endif
+
+        mod->datagram_list[send_count].iov = (struct iovec *)packet->iov;
+        mod->datagram_list[send_count].iov_count = packet->iov_count;
+        mod->datagram_list[send_count].txtime = mod->sync.txtime;
+        ++send_count;
+    }
+
+    if(  send_count > 0
+       && asc_socket_sendto_batch(mod->sock, mod->datagram_list, send_count) != send_count)
+    {
+        asc_log_warning(MSG("error on send [%s]"), asc_socket_error());
+    }
+
+    if(mod->sync.wake_time > 0)
+    {
+        const uint64_t now = asc_utime();
+        const uint64_t wake_time = mod->sync.wake_time;
+        asc_histogram_add(&mod->sync.late, (now > wake_time) ? (now - wake_time) : 0);
+        mod->sync.wake_time = 0;
+    }
+
+    for(int i = 0; i < count; ++i)
+        packet_release(&mod->packet_list[(mod->packet_head + i) % mod->batch]);
+
+    mod->packet_head = (mod->packet_head + count) % mod->batch;
+    mod->packet_count = 0;
+
+    if(mod->fec_count > 0)
+        fec_flush(mod);
+}
+
+static void on_flush(void *arg)
+{
+    module_data_t *mod = (module_data_t *)arg;
+    mod->is_flush = false;
+    packet_flush(mod);
+}
+
+static void packet_push(module_data_t *mod, const uint8_t *ts, stream_slab_t *slab)
+{
+    const int current = (mod->packet_head + mod->packet_count) % mod->batch;
+    udp_packet_t *packet = &mod->packet_list[current];
+
+    if(mod->is_rtp && mod->skip == 0)
     {
         struct timeval tv;
         gettimeofday(&tv, NULL);
         const uint64_t msec = ((tv.tv_sec % 1000000) * 1000) + (tv.tv_usec / 1000);
 
-        mod->packet.buffer[2] = (mod->rtpseq >> 8) & 0xFF;
-        mod->packet.buffer[3] = (mod->rtpseq     ) & 0xFF;
+        packet->buffer[2] = (mod->rtpseq >> 8) & 0xFF;
+        packet->buffer[3] = (mod->rtpseq     ) & 0xFF;
 
-        mod->packet.buffer[4] = (msec >> 24) & 0xFF;
-        mod->packet.buffer[5] = (msec >> 16) & 0xFF;
-        mod->packet.buffer[6] = (msec >>  8) & 0xFF;
-        mod->packet.buffer[7] = (msec      ) & 0xFF;
+        packet->buffer[4] = (msec >> 24) & 0xFF;
+        packet->buffer[5] = (msec >> 16) & 0xFF;
+        packet->buffer[6] = (msec >>  8) & 0xFF;
+        packet->buffer[7] = (msec      ) & 0xFF;
 
         ++mod->rtpseq;
 
-        mod->packet.skip += 12;
+        mod->skip += 12;
+        packet_append(packet, packet->buffer, 12);
     }
 
-    memcpy(&mod->packet.buffer[mod->packet.skip], ts, TS_PACKET_SIZE);
-    mod->packet.skip += TS_PACKET_SIZE;
+    if(slab)
+    {
+        const int slab_count = packet->slab_count;
+        if(slab_count == 0 || packet->slab[slab_count - 1] != slab)
+        {
+            packet->slab[slab_count] = stream_slab_ref(slab);
+            ++packet->slab_count;
+        }
+        packet_append(packet, ts, TS_PACKET_SIZE);
+    }
+    else
+    {
+        uint8_t *dst = &packet->buffer[mod->skip];
+        memcpy(dst, ts, TS_PACKET_SIZE);
+        packet_append(packet, dst, TS_PACKET_SIZE);
+    }
+    mod->skip += TS_PACKET_SIZE;
 
-    if(mod->packet.skip > UDP_BUFFER_SIZE - TS_PACKET_SIZE)
+    if(mod->skip > UDP_BUFFER_SIZE - TS_PACKET_SIZE)
     {
-        if(asc_socket_sendto(mod->sock, mod->packet.buffer, mod->packet.skip) == -1)
-            asc_log_warning(MSG("error on send [%s]"), asc_socket_error());
-        mod->packet.skip = 0;
+        if(mod->fec)
+            fec_encoder_push(mod->fec, packet->iov, packet->iov_count);
+
+#ifdef UDP_OUTPUT_LOSS
+        if(mod->loss > 0)
+        {
+            ++mod->loss_count;
+            if(mod->loss_count == mod->loss)
+            {
+                mod->loss_count = 0;
+                packet->is_drop = true;
+            }
+        }
+#endif
+
+        mod->skip = 0;
+        ++mod->packet_count;
+
+        if(mod->packet_count >= mod->batch)
+        {
+            packet_flush(mod);
+        }
+        else if(!mod->is_flush)
+        {
+            mod->is_flush = true;
+            asc_main_loop_defer(on_flush, mod);
+        }
     }
 }
 
-static void thread_input_push(module_data_t *mod, const uint8_t *ts)
+static void on_ts(module_data_t *mod, const uint8_t *ts)
+{
+    packet_push(mod, ts, NULL);
+}
+
+static void on_ts_batch(module_data_t *mod, const uint8_t *ts, size_t count)
+{
+    stream_slab_t *slab = module_stream_slab(mod);
+    for(size_t i = 0; i < count; ++i)
+        packet_push(mod, &ts[i * TS_PACKET_SIZE], slab);
+}
+
+static void thread_input_push_batch(module_data_t *mod, const uint8_t *ts, size_t count)
 {
-    const ssize_t r = asc_thread_buffer_write(mod->thread_input, ts, TS_PACKET_SIZE);
-    if(r != TS_PACKET_SIZE)
+    const ssize_t size = count * TS_PACKET_SIZE;
+    const ssize_t r = asc_thread_buffer_write(mod->thread_input, ts, size);
+    if(r != size)
     {
         asc_log_debug(MSG("sync buffer overflow"));
         asc_thread_buffer_flush(mod->thread_input);
     }
 }
 
+static void thread_input_push(module_data_t *mod, const uint8_t *ts)
+{
+    thread_input_push_batch(mod, ts, 1);
+}
+
 static bool seek_pcr(module_data_t *mod,
     size_t *block_size, size_t *next_block, uint64_t *pcr)
 {
@@ -157,6 +418,28 @@ static bool seek_pcr(module_data_t *mod,
     return false;
 }
 
+// datagram is completed with the next packet
+static inline bool packet_is_last(module_data_t *mod)
+{
+    return (mod->skip + TS_PACKET_SIZE > UDP_BUFFER_SIZE - TS_PACKET_SIZE);
+}
+
+// with txtime the thread wakes ahead, datagram is delayed by the qdisc
+static inline uint64_t sync_wake_time(module_data_t *mod, uint64_t time)
+{
+    return (mod->sync.is_txtime) ? (time - UDP_TXTIME_LEAD) : time;
+}
+
+// wait for the departure time of the datagram
+static void sync_wait(module_data_t *mod, uint64_t time)
+{
+    if(mod->sync.is_txtime)
+        mod->sync.txtime = time * 1000;
+
+    mod->sync.wake_time = sync_wake_time(mod, time);
+    asc_usleep_until(mod->sync.wake_time);
+}
+
 static void on_thread_close(void *arg)
 {
     module_data_t *mod = (module_data_t *)arg;
@@ -182,6 +465,11 @@ static void thread_loop(void *arg)
 
     mod->is_thread_started = true;
 
+#ifdef __linux__
+    // default timer slack (50us) delays each wakeup
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+#endif
+
     while(mod->is_thread_started)
     {
         // block sync
@@ -273,8 +561,9 @@ static void thread_loop(void *arg)
             }
 
             system_time = asc_utime();
-            if(block_time_total > system_time + 100)
-                asc_usleep(block_time_total - system_time);
+            const uint64_t wake_time = sync_wake_time(mod, block_time_total);
+            if(wake_time > system_time + 100)
+                asc_usleep_until(wake_time);
 
             uint32_t ts_count = block_size / TS_PACKET_SIZE;
             if(mod->cbr > 0)
@@ -290,6 +579,11 @@ static void thread_loop(void *arg)
 
             for(uint32_t i = 0; mod->is_thread_started && i < ts_count; ++i)
             {
+                // packets are collected into the datagram without delay.
+                // datagram is sent at the time of its last packet
+                if(packet_is_last(mod))
+                    sync_wait(mod, block_time_total);
+
                 // sending
                 if(mod->sync.buffer_read != next_block)
                 {
@@ -319,9 +613,6 @@ static void thread_loop(void *arg)
                     break;
                 }
                 system_time_check = system_time;
-
-                if(block_time_total > system_time + 100)
-                    asc_usleep(block_time_total - system_time);
             }
             mod->sync.buffer_count -= block_size;
 
@@ -341,6 +632,22 @@ static void thread_loop(void *arg)
     }
 }
 
+static asc_socket_t * fec_socket_open(  module_data_t *mod, int port
+                                      , const char *localaddr, int ttl)
+{
+    asc_socket_t *sock = asc_socket_open_udp4(mod);
+    asc_socket_set_reuseaddr(sock, 1);
+    if(!asc_socket_bind(sock, NULL, 0))
+        astra_abort();
+
+    if(localaddr)
+        asc_socket_set_multicast_if(sock, localaddr);
+    asc_socket_set_multicast_ttl(sock, ttl);
+    asc_socket_set_sockaddr(sock, mod->addr, port);
+
+    return sock;
+}
+
 static void module_init(module_data_t *mod)
 {
     module_option_string("addr", &mod->addr, NULL);
@@ -349,6 +656,22 @@ static void module_init(module_data_t *mod)
     mod->port = 1234;
     module_option_number("port", &mod->port);
 
+    int value = 0;
+    module_option_number("sync", &value);
+    const int sync = value;
+
+    // sync thread sends each datagram immediately
+    mod->batch = UDP_BATCH_SIZE;
+    module_option_number("batch", &mod->batch);
+    if(sync > 0 || mod->batch < 1)
+        mod->batch = 1;
+    else if(mod->batch > UDP_BATCH_MAX)
+        mod->batch = UDP_BATCH_MAX;
+
+    mod->packet_list = (udp_packet_t *)calloc(mod->batch, sizeof(udp_packet_t));
+    mod->datagram_list =
+        (asc_socket_datagram_t *)calloc(mod->batch, sizeof(asc_socket_datagram_t));
+
     module_option_boolean("rtp", &mod->is_rtp);
     if(mod->is_rtp)
     {
@@ -357,12 +680,16 @@ static void module_init(module_data_t *mod)
 #define RTP_PT_H261     31      /* RFC2032 */
 #define RTP_PT_MP2T     33      /* RFC2250 */
 
-        mod->packet.buffer[0 ] = 0x80; // RTP version
-        mod->packet.buffer[1 ] = RTP_PT_MP2T;
-        mod->packet.buffer[8 ] = (rtpssrc >> 24) & 0xFF;
-        mod->packet.buffer[9 ] = (rtpssrc >> 16) & 0xFF;
-        mod->packet.buffer[10] = (rtpssrc >>  8) & 0xFF;
-        mod->packet.buffer[11] = (rtpssrc      ) & 0xFF;
+        for(int i = 0; i < mod->batch; ++i)
+        {
+            uint8_t *const buffer = mod->packet_list[i].buffer;
+            buffer[0 ] = 0x80; // RTP version
+            buffer[1 ] = RTP_PT_MP2T;
+            buffer[8 ] = (rtpssrc >> 24) & 0xFF;
+            buffer[9 ] = (rtpssrc >> 16) & 0xFF;
+            buffer[10] = (rtpssrc >>  8) & 0xFF;
+            buffer[11] = (rtpssrc      ) & 0xFF;
+        }
     }
 
     mod->sock = asc_socket_open_udp4(mod);
@@ -370,7 +697,6 @@ static void module_init(module_data_t *mod)
     if(!asc_socket_bind(mod->sock, NULL, 0))
         astra_abort();
 
-    int value;
     if(module_option_number("socket_size", &value))
         asc_socket_set_buffer(mod->sock, 0, value);
 
@@ -379,20 +705,73 @@ static void module_init(module_data_t *mod)
     if(localaddr)
         asc_socket_set_multicast_if(mod->sock, localaddr);
 
-    value = 32;
-    module_option_number("ttl", &value);
-    asc_socket_set_multicast_ttl(mod->sock, value);
+    int ttl = 32;
+    module_option_number("ttl", &ttl);
+    asc_socket_set_multicast_ttl(mod->sock, ttl);
 
     asc_socket_multicast_join(mod->sock, mod->addr, NULL);
     asc_socket_set_sockaddr(mod->sock, mod->addr, mod->port);
 
+    int fec_columns = 0;
+    int fec_rows = 0;
+    if(mod->is_rtp && module_option_number("fec_columns", &fec_columns) && fec_columns > 0)
+    {
+        module_option_number("fec_rows", &fec_rows);
+        if(fec_rows < 1)
+            fec_rows = 1;
+        if(   fec_columns > FEC_SIZE_MAX || fec_rows > FEC_SIZE_MAX
+           || fec_columns * fec_rows > FEC_MATRIX_MAX)
+        {
+            asc_log_error(MSG("wrong FEC matrix %dx%d"), fec_columns, fec_rows);
+            astra_abort();
+        }
+
+        // 1D FEC is the column FEC of the matrix with one column
+        if(fec_rows == 1)
+        {
+            fec_rows = fec_columns;
+            fec_columns = 1;
+        }
+
+        mod->fec = (fec_encoder_t *)malloc(sizeof(fec_encoder_t));
+        fec_encoder_init(mod->fec, fec_columns, fec_rows, on_fec, mod);
+
+        // FEC is sent after the media datagrams of the batch: row FEC for each
+        // completed row and column FEC for each completed matrix
+        const int matrix_count = mod->batch / (fec_columns * fec_rows) + 1;
+        mod->fec_size = mod->batch / fec_columns + 1 + fec_columns * matrix_count;
+        mod->fec_buffer = (uint8_t *)malloc(mod->fec_size * FEC_PACKET_SIZE);
+        mod->fec_iov = (struct iovec *)calloc(mod->fec_size, sizeof(struct iovec));
+        mod->fec_list =
+            (asc_socket_datagram_t *)calloc(mod->fec_size, sizeof(asc_socket_datagram_t));
+        mod->fec_is_row = (bool *)calloc(mod->fec_size, sizeof(bool));
+
+        if(fec_columns > 1)
+            mod->fec_row = fec_socket_open(mod, mod->port + FEC_ROW_PORT, localaddr, ttl);
+        if(fec_rows > 1)
+            mod->fec_column = fec_socket_open(mod, mod->port + FEC_COLUMN_PORT, localaddr, ttl);
+    }
+
+#ifdef UDP_OUTPUT_LOSS
     value = 0;
-    module_option_number("sync", &value);
+    module_option_number("loss", &value);
     if(value > 0)
+        mod->loss = value;
+#endif
+
+    if(mod->batch > 1)
+    {
+        bool is_gso = true;
+        module_option_boolean("gso", &is_gso);
+        asc_socket_set_gso(mod->sock, is_gso);
+    }
+
+    if(sync > 0)
     {
         module_stream_init(mod, thread_input_push);
+        module_stream_batch_set(mod, thread_input_push_batch);
 
-        mod->sync.buffer_size = value * 1024 * 1024;
+        mod->sync.buffer_size = sync * 1024 * 1024;
         mod->sync.buffer_size -= mod->sync.buffer_size % TS_PACKET_SIZE;
         mod->sync.buffer = (uint8_t *)malloc(mod->sync.buffer_size);
 
@@ -401,6 +780,11 @@ static void module_init(module_data_t *mod)
         if(value > 0)
             mod->cbr = (value * 1000 * 1000) / (8 * TS_PACKET_SIZE); // ts/s
 
+        bool is_txtime = false;
+        module_option_boolean("txtime", &is_txtime);
+        if(is_txtime)
+            mod->sync.is_txtime = asc_socket_set_txtime(mod->sock, true);
+
         mod->thread = asc_thread_init(mod);
         mod->thread_input = asc_thread_buffer_init(mod->sync.buffer_size * 2);
         asc_thread_start(mod->thread, thread_loop, NULL, NULL, on_thread_close);
@@ -408,6 +792,7 @@ static void module_init(module_data_t *mod)
     else
     {
         module_stream_init(mod, on_ts);
+        module_stream_batch_set(mod, on_ts_batch);
     }
 }
 
@@ -418,6 +803,47 @@ static void module_destroy(module_data_t *mod)
     if(mod->thread)
         on_thread_close(mod);
 
+    if(mod->is_flush)
+    {
+        asc_main_loop_defer_cancel(mod);
+        mod->is_flush = false;
+    }
+
+    if(mod->packet_list)
+    {
+        packet_flush(mod);
+        packet_release(&mod->packet_list[mod->packet_head]);
+        mod->skip = 0;
+
+        free(mod->packet_list);
+        mod->packet_list = NULL;
+        free(mod->datagram_list);
+        mod->datagram_list = NULL;
+    }
+
+    if(mod->fec)
+    {
+        fec_encoder_destroy(mod->fec);
+        ASC_FREE(mod->fec, free);
+        ASC_FREE(mod->fec_buffer, free);
+        ASC_FREE(mod->fec_iov, free);
+        ASC_FREE(mod->fec_list, free);
+        ASC_FREE(mod->fec_is_row, free);
+        mod->fec_count = 0;
+    }
+
+    if(mod->fec_row)
+    {
+        asc_socket_close(mod->fec_row);
+        mod->fec_row = NULL;
+    }
+
+    if(mod->fec_column)
+    {
+        asc_socket_close(mod->fec_column);
+        mod->fec_column = NULL;
+    }
+
     if(mod->sync.buffer)
     {
         free(mod->sync.buffer);
@@ -431,9 +857,20 @@ static void module_destroy(module_data_t *mod)
     }
 }
 
+static int method_status(module_data_t *mod)
+{
+    lua_newtable(lua);
+
+    if(mod->sync.buffer)
+        udp_histogram_push(&mod->sync.late, "late");
+
+    return 1;
+}
+
 MODULE_STREAM_METHODS()
 MODULE_LUA_METHODS()
 {
-    MODULE_STREAM_METHODS_REF()
+    MODULE_STREAM_METHODS_REF(),
+    { "status", method_status }
 };
 MODULE_LUA_REGISTER(udp_output)
@@ -0,0 +1,277 @@
+/*
+ * Astra Module: UDP (AF_PACKET ring)
+ * http://cesbo.com/astra
+ *
+ * Copyright (C) 2012-2015, Andrey Dyldin <and@cesbo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "packet.h"
+
+#define MSG(_msg) "[udp_input packet %s] " _msg, ifname
+
+#ifdef HAVE_TPACKET_V3
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+
+#define PACKET_BLOCK_SIZE (1 << 20)
+#define PACKET_FRAME_SIZE 2048
+#define PACKET_BLOCK_TIMEOUT 4 // ms. partially filled block is released to the user
+
+#define IP_HEADER_MIN 20
+#define UDP_HEADER_SIZE 8
+
+struct packet_ring_t
+{
+    int fd;
+    asc_event_t *event;
+    void *arg;
+
+    uint8_t *map;
+    size_t map_size;
+    uint32_t block_size;
+    uint32_t block_count;
+    uint32_t block; // next block to read
+};
+
+/* IPv4, UDP, not fragmented, destination address and port */
+static bool packet_ring_filter(int fd, uint32_t addr, int port)
+{
+    struct sock_filter code[] =
+    {
+        { BPF_LD | BPF_B | BPF_ABS, 0, 0, 9 },                  // 0: protocol
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 8, IPPROTO_UDP },       // 1
+        { BPF_LD | BPF_H | BPF_ABS, 0, 0, 6 },                  // 2: fragment offset
+        { BPF_JMP | BPF_JSET | BPF_K, 6, 0, 0x1FFF },           // 3
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, 16 },                 // 4: destination address
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 4, ntohl(addr) },       // 5
+        { BPF_LDX | BPF_B | BPF_MSH, 0, 0, 0 },                 // 6: IP header length
+        { BPF_LD | BPF_H | BPF_IND, 0, 0, 2 },                  // 7: destination port
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 1, (uint32_t)port },    // 8
+        { BPF_RET | BPF_K, 0, 0, 0xFFFF },                      // 9: accept
+        { BPF_RET | BPF_K, 0, 0, 0 },                           // 10: drop
+    };
+
+    if(addr == 0)
+    {
+        /* any address */
+        code[5].code = BPF_JMP | BPF_JA;
+        code[5].jt = 0;
+        code[5].jf = 0;
+        code[5].k = 0;
+    }
+
+    struct sock_fprog prog;
+    prog.len = ASC_ARRAY_SIZE(code);
+    prog.filter = code;
+
+    return (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) != -1);
+}
+
+packet_ring_t * packet_ring_init(  const char *ifname, uint32_t addr, int port
+                                 , size_t size, void *arg)
+{
+    const int ifindex = if_nametoindex(ifname);
+    if(ifindex == 0)
+    {
+        asc_log_error(MSG("interface is not found"));
+        return NULL;
+    }
+
+    /* no packets until bind() */
+    const int fd = socket(AF_PACKET, SOCK_DGRAM, 0);
+    if(fd == -1)
+    {
+        asc_log_error(MSG("failed to open socket [%s]"), strerror(errno));
+        return NULL;
+    }
+
+    packet_ring_t *ring = (packet_ring_t *)calloc(1, sizeof(packet_ring_t));
+    ring->fd = fd;
+    ring->arg = arg;
+    ring->block_size = PACKET_BLOCK_SIZE;
+    ring->block_count = size / PACKET_BLOCK_SIZE;
+    if(ring->block_count < 2)
+        ring->block_count = 2;
+    ring->map_size = (size_t)ring->block_size * ring->block_count;
+
+    do
+    {
+        const int version = TPACKET_V3;
+        if(setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == -1)
+        {
+            asc_log_error(MSG("TPACKET_V3 is not supported [%s]"), strerror(errno));
+            break;
+        }
+
+        if(!packet_ring_filter(fd, addr, port))
+        {
+            asc_log_error(MSG("failed to attach filter [%s]"), strerror(errno));
+            break;
+        }
+
+        struct tpacket_req3 req;
+        memset(&req, 0, sizeof(req));
+        req.tp_block_size = ring->block_size;
+        req.tp_block_nr = ring->block_count;
+        req.tp_frame_size = PACKET_FRAME_SIZE;
+        req.tp_frame_nr = (ring->block_size / PACKET_FRAME_SIZE) * ring->block_count;
+        req.tp_retire_blk_tov = PACKET_BLOCK_TIMEOUT;
+        if(setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) == -1)
+        {
+            asc_log_error(MSG("failed to set ring [%s]"), strerror(errno));
+            break;
+        }
+
+        ring->map = (uint8_t *)mmap(  NULL, ring->map_size, PROT_READ | PROT_WRITE
+                                    , MAP_SHARED, fd, 0);
+        if(ring->map == MAP_FAILED)
+        {
+            ring->map = NULL;
+            asc_log_error(MSG("failed to map ring [%s]"), strerror(errno));
+            break;
+        }
+
+        struct sockaddr_ll sll;
+        memset(&sll, 0, sizeof(sll));
+        sll.sll_family = AF_PACKET;
+        sll.sll_protocol = htons(ETH_P_IP);
+        sll.sll_ifindex = ifindex;
+        if(bind(fd, (struct sockaddr *)&sll, sizeof(sll)) == -1)
+        {
+            asc_log_error(MSG("failed to bind [%s]"), strerror(errno));
+            break;
+        }
+
+        return ring;
+    } while(0);
+
+    packet_ring_destroy(ring);
+    return NULL;
+}
+
+void packet_ring_destroy(packet_ring_t *ring)
+{
+    if(ring->event)
+        asc_event_close(ring->event);
+    if(ring->map)
+        munmap(ring->map, ring->map_size);
+    close(ring->fd);
+    free(ring);
+}
+
+void packet_ring_set_on_read(packet_ring_t *ring, event_callback_t on_read)
+{
+    if(!ring->event)
+        ring->event = asc_event_init(ring->fd, ring->arg);
+    asc_event_set_on_read(ring->event, on_read);
+}
+
+static void packet_ring_datagram(  packet_ring_t *ring, packet_callback_t callback
+                                 , const struct tpacket3_hdr *hdr)
+{
+    const struct sockaddr_ll *sll =
+        (const struct sockaddr_ll *)((const uint8_t *)hdr
+                                     + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+    if(sll->sll_pkttype == PACKET_OUTGOING)
+        return;
+
+    const uint8_t *ip = (const uint8_t *)hdr + hdr->tp_net;
+    const size_t len = hdr->tp_snaplen;
+    if(len < IP_HEADER_MIN || (ip[0] >> 4) != 4)
+        return;
+
+    const size_t ip_size = (ip[0] & 0x0F) * 4;
+    if(ip_size < IP_HEADER_MIN || ip_size + UDP_HEADER_SIZE > len)
+        return;
+
+    const uint8_t *udp = &ip[ip_size];
+    const size_t udp_size = (udp[4] << 8) | udp[5];
+    if(udp_size < UDP_HEADER_SIZE || ip_size + udp_size > len)
+        return;
+
+    callback(ring->arg, &udp[UDP_HEADER_SIZE], udp_size - UDP_HEADER_SIZE);
+}
+
+int packet_ring_read(packet_ring_t *ring, packet_callback_t callback)
+{
+    int count = 0;
+
+    while(1)
+    {
+        struct tpacket_block_desc *block =
+            (struct tpacket_block_desc *)&ring->map[(size_t)ring->block * ring->block_size];
+        if(!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+            break;
+
+        const uint32_t num = block->hdr.bh1.num_pkts;
+        const uint8_t *ptr = (const uint8_t *)block + block->hdr.bh1.offset_to_first_pkt;
+        for(uint32_t i = 0; i < num; ++i)
+        {
+            const struct tpacket3_hdr *hdr = (const struct tpacket3_hdr *)ptr;
+            packet_ring_datagram(ring, callback, hdr);
+            ptr += hdr->tp_next_offset;
+        }
+        count += num;
+
+        /* block is returned to the kernel */
+        __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+
+        ++ring->block;
+        if(ring->block == ring->block_count)
+            ring->block = 0;
+    }
+
+    return count;
+}
+
+#else /* HAVE_TPACKET_V3 */
+
+packet_ring_t * packet_ring_init(  const char *ifname, uint32_t addr, int port
+                                 , size_t size, void *arg)
+{
+    __uarg(addr);
+    __uarg(port);
+    __uarg(size);
+    __uarg(arg);
+    asc_log_error(MSG("AF_PACKET ring is not supported"));
+    return NULL;
+}
+
+void packet_ring_destroy(packet_ring_t *ring)
+{
+    __uarg(ring);
+}
+
+void packet_ring_set_on_read(packet_ring_t *ring, event_callback_t on_read)
+{
+    __uarg(ring);
+    __uarg(on_read);
+}
+
+int packet_ring_read(packet_ring_t *ring, packet_callback_t callback)
+{
+    __uarg(ring);
+    __uarg(callback);
+    return 0;
+}
+
+#endif /* HAVE_TPACKET_V3 */
@@ -0,0 +1,52 @@
+/*
+ * Astra Module: UDP (AF_PACKET ring)
+ * http://cesbo.com/astra
+ *
+ * Copyright (C) 2012-2015, Andrey Dyldin <and@cesbo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PACKET_H_
+#define _PACKET_H_ 1
+
+#include <astra.h>
+
+/*
+ * Linux AF_PACKET memory-mapped ring (TPACKET_V3). Kernel fills blocks of
+ * the ring with IPv4 datagrams selected by the BPF filter (destination address
+ * and UDP port), IP and UDP headers are parsed in the user space.
+ * Payload points to the ring memory and valid in the callback only.
+ * Requires CAP_NET_RAW
+ */
+
+#define PACKET_RING_SIZE 16 // MB
+
+typedef struct packet_ring_t packet_ring_t;
+
+/* data - UDP payload */
+typedef void (*packet_callback_t)(void *arg, const uint8_t *data, size_t size);
+
+/* addr - destination address in the network byte order, 0 - any */
+packet_ring_t * packet_ring_init(  const char *ifname, uint32_t addr, int port
+                                 , size_t size, void *arg) __wur;
+void packet_ring_destroy(packet_ring_t *ring);
+
+/* on_read is called when at least one block is ready */
+void packet_ring_set_on_read(packet_ring_t *ring, event_callback_t on_read);
+
+/* returns number of datagrams passed to the callback */
+int packet_ring_read(packet_ring_t *ring, packet_callback_t callback);
+
+#endif /* _PACKET_H_ */
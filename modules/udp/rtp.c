@@ -0,0 +1,362 @@
+/*
+ * Astra Module: UDP (RTP)
+ * http://cesbo.com/astra
+ *
+ * Copyright (C) 2012-2015, Andrey Dyldin <and@cesbo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rtp.h"
+
+size_t rtp_header_size(const uint8_t *data, size_t size)
+{
+    if(size < RTP_HEADER_SIZE || (data[0] & 0xC0) != 0x80)
+        return 0;
+
+    size_t skip = RTP_HEADER_SIZE + RTP_CSRC_COUNT(data) * 4;
+    if(RTP_IS_EXT(data))
+    {
+        if(size < skip + 4)
+            return 0;
+        skip += ((data[skip + 2] << 8) | data[skip + 3]) * 4 + 4;
+    }
+
+    return (skip <= size) ? skip : 0;
+}
+
+/*
+ * oooooooooo  ooooooooooo  ooooooo  oooooooooo  ooooooooo  ooooooooooo oooooooooo
+ *  888    888  888    88 o888   888o 888    888  888    88o 888    88   888    888
+ *  888oooo88   888ooo8   888     888 888oooo88   888    888 888ooo8     888oooo88
+ *  888  88o    888    oo 888o   o888 888  88o    888    888 888    oo   888  88o
+ * o888o  88o8 o888ooo8888  88ooo88  o888o  88o8 o888ooo88  o888ooo8888 o888o  88o8
+ *
+ */
+
+void rtp_reorder_init(  rtp_reorder_t *reorder, uint32_t depth, uint32_t slot_size
+                      , uint32_t delay_ms, rtp_callback_t callback, void *arg)
+{
+    memset(reorder, 0, sizeof(rtp_reorder_t));
+
+    reorder->callback = callback;
+    reorder->arg = arg;
+    reorder->depth = depth;
+    reorder->slot_size = slot_size;
+    reorder->delay = (uint64_t)delay_ms * 1000;
+
+    if(depth > 0)
+    {
+        reorder->slot_list = (rtp_slot_t *)calloc(depth, sizeof(rtp_slot_t));
+        reorder->buffer = (uint8_t *)malloc(depth * slot_size);
+        for(uint32_t i = 0; i < depth; ++i)
+            reorder->slot_list[i].payload = &reorder->buffer[i * slot_size];
+    }
+}
+
+void rtp_reorder_destroy(rtp_reorder_t *reorder)
+{
+    ASC_FREE(reorder->slot_list, free);
+    ASC_FREE(reorder->buffer, free);
+    reorder->count = 0;
+}
+
+/* delivers the next datagram or counts it as lost */
+static void reorder_release(rtp_reorder_t *reorder)
+{
+    rtp_slot_t *slot = &reorder->slot_list[reorder->head];
+    reorder->history <<= 1;
+    if(slot->is_set)
+    {
+        slot->is_set = false;
+        --reorder->count;
+        reorder->history |= 1;
+        reorder->callback(reorder->arg, slot->payload, slot->size);
+    }
+    else
+    {
+        ++reorder->stat.lost;
+    }
+
+    ++reorder->head;
+    if(reorder->head == reorder->depth)
+        reorder->head = 0;
+    ++reorder->next_seq;
+}
+
+/* delivers all buffered datagrams */
+void rtp_reorder_flush(rtp_reorder_t *reorder)
+{
+    while(reorder->count > 0)
+        reorder_release(reorder);
+}
+
+static void reorder_restart(rtp_reorder_t *reorder, uint16_t seq)
+{
+    rtp_reorder_flush(reorder);
+
+    reorder->is_started = true;
+    reorder->next_seq = seq;
+    reorder->max_seq = seq;
+    reorder->history = 0;
+    reorder->head = 0;
+}
+
+/* depth 0: delivers datagram immediately */
+static void reorder_pass(  rtp_reorder_t *reorder, uint16_t seq
+                         , const uint8_t *payload, size_t size)
+{
+    const int diff = (int16_t)(seq - reorder->max_seq);
+
+    if(reorder->history == 0)
+    {
+        reorder->history = 1;
+        reorder->max_seq = seq;
+    }
+    else if(diff > 0)
+    {
+        reorder->stat.lost += diff - 1;
+        reorder->history = (diff < 64) ? ((reorder->history << diff) | 1) : 1;
+        reorder->max_seq = seq;
+    }
+    else
+    {
+        const int back = -diff;
+        if(back >= 64)
+        {
+            ++reorder->stat.late;
+            return;
+        }
+
+        const uint64_t bit = 1ULL << back;
+        if(reorder->history & bit)
+        {
+            ++reorder->stat.duplicate;
+            return;
+        }
+
+        /* counted as lost before */
+        reorder->history |= bit;
+        ++reorder->stat.reordered;
+        if(reorder->stat.lost > 0)
+            --reorder->stat.lost;
+    }
+
+    reorder->next_seq = reorder->max_seq + 1;
+    reorder->callback(reorder->arg, payload, size);
+}
+
+/* stores datagram to the slot with offset diff from the head */
+static bool reorder_store(  rtp_reorder_t *reorder, int diff, uint16_t seq
+                          , const uint8_t *payload, size_t size, uint64_t time)
+{
+    uint32_t i = reorder->head + diff;
+    if(i >= reorder->depth)
+        i -= reorder->depth;
+
+    rtp_slot_t *slot = &reorder->slot_list[i];
+    if(slot->is_set)
+        return false;
+
+    memcpy(slot->payload, payload, size);
+    slot->size = size;
+    slot->time = time;
+    slot->seq = seq;
+    slot->is_set = true;
+    slot->is_received = true;
+    ++reorder->count;
+
+    while(reorder->slot_list[reorder->head].is_set)
+        reorder_release(reorder);
+
+    return true;
+}
+
+void rtp_reorder_push(  rtp_reorder_t *reorder, uint16_t seq
+                      , const uint8_t *payload, size_t size, uint64_t time)
+{
+    ++reorder->stat.packets;
+
+    if(!reorder->is_started)
+        reorder_restart(reorder, seq);
+
+    int diff = (int16_t)(seq - reorder->next_seq);
+    if(diff > RTP_SEQ_RESET || diff < -RTP_SEQ_RESET)
+    {
+        /* source is restarted */
+        reorder_restart(reorder, seq);
+        diff = 0;
+    }
+
+    if(reorder->depth == 0)
+    {
+        reorder_pass(reorder, seq, payload, size);
+        return;
+    }
+
+    if((int16_t)(seq - reorder->max_seq) < 0)
+        ++reorder->stat.reordered;
+    else
+        reorder->max_seq = seq;
+
+    if(diff < 0)
+    {
+        const int back = -diff - 1;
+        if(back < 64 && (reorder->history & (1ULL << back)))
+            ++reorder->stat.duplicate;
+        else
+            ++reorder->stat.late;
+        return;
+    }
+
+    /* move the window forward */
+    for(; diff >= (int)reorder->depth; --diff)
+        reorder_release(reorder);
+
+    if(size > reorder->slot_size)
+    {
+        /* datagram is too large for the buffer. deliver it in place */
+        for(; diff > 0; --diff)
+            reorder_release(reorder);
+
+        reorder->callback(reorder->arg, payload, size);
+
+        reorder->slot_list[reorder->head].is_received = false;
+        reorder->history = (reorder->history << 1) | 1;
+        ++reorder->head;
+        if(reorder->head == reorder->depth)
+            reorder->head = 0;
+        ++reorder->next_seq;
+
+        while(reorder->slot_list[reorder->head].is_set)
+            reorder_release(reorder);
+        return;
+    }
+
+    if(!reorder_store(reorder, diff, seq, payload, size, time))
+        ++reorder->stat.duplicate;
+}
+
+/* returns received datagram if it is still in the buffer */
+const rtp_slot_t * rtp_reorder_lookup(const rtp_reorder_t *reorder, uint16_t seq)
+{
+    if(reorder->depth == 0 || !reorder->is_started)
+        return NULL;
+
+    const int depth = reorder->depth;
+    const int diff = (int16_t)(seq - reorder->next_seq);
+    if(diff >= depth || diff < -depth)
+        return NULL;
+
+    int i = (int)reorder->head + diff;
+    if(i < 0)
+        i += depth;
+    else if(i >= depth)
+        i -= depth;
+
+    const rtp_slot_t *slot = &reorder->slot_list[i];
+    return (slot->is_received && slot->seq == seq) ? slot : NULL;
+}
+
+/* datagram is not delivered yet and could be recovered */
+bool rtp_reorder_is_pending(const rtp_reorder_t *reorder, uint16_t seq)
+{
+    if(reorder->depth == 0 || !reorder->is_started)
+        return false;
+
+    const int diff = (int16_t)(seq - reorder->next_seq);
+    return (diff >= 0 && diff < (int)reorder->depth);
+}
+
+/* stores datagram restored with FEC */
+bool rtp_reorder_recover(  rtp_reorder_t *reorder, uint16_t seq
+                         , const uint8_t *payload, size_t size, uint64_t time)
+{
+    if(!rtp_reorder_is_pending(reorder, seq) || size > reorder->slot_size)
+        return false;
+
+    const int diff = (int16_t)(seq - reorder->next_seq);
+    if(!reorder_store(reorder, diff, seq, payload, size, time))
+        return false;
+
+    ++reorder->stat.recovered;
+    return true;
+}
+
+/* skips missing datagrams if the next buffered datagram waits longer than delay */
+void rtp_reorder_timeout(rtp_reorder_t *reorder, uint64_t time)
+{
+    if(reorder->delay == 0)
+        return;
+
+    while(reorder->count > 0)
+    {
+        /* head is missing. find the first buffered datagram */
+        uint32_t i = reorder->head;
+        uint32_t gap = 0;
+        while(!reorder->slot_list[i].is_set)
+        {
+            ++gap;
+            ++i;
+            if(i == reorder->depth)
+                i = 0;
+        }
+
+        if(reorder->slot_list[i].time + reorder->delay > time)
+            return;
+
+        for(; gap > 0; --gap)
+            reorder_release(reorder);
+
+        while(reorder->slot_list[reorder->head].is_set)
+            reorder_release(reorder);
+    }
+}
+
+void rtp_stat_push(const rtp_stat_t *stat)
+{
+    lua_newtable(lua);
+
+    lua_pushnumber(lua, stat->packets);
+    lua_setfield(lua, -2, "packets");
+    lua_pushnumber(lua, stat->lost);
+    lua_setfield(lua, -2, "lost");
+    lua_pushnumber(lua, stat->reordered);
+    lua_setfield(lua, -2, "reordered");
+    lua_pushnumber(lua, stat->late);
+    lua_setfield(lua, -2, "late");
+    lua_pushnumber(lua, stat->duplicate);
+    lua_setfield(lua, -2, "duplicate");
+    lua_pushnumber(lua, stat->recovered);
+    lua_setfield(lua, -2, "recovered");
+}
+
+/* push table with the histogram summary to the table on top of the stack */
+void udp_histogram_push(const asc_histogram_t *histogram, const char *name)
+{
+    lua_newtable(lua);
+    lua_pushnumber(lua, histogram->count);
+    lua_setfield(lua, -2, "count");
+    lua_pushnumber(lua, (histogram->count > 0) ? (histogram->total / histogram->count) : 0);
+    lua_setfield(lua, -2, "avg");
+    lua_pushnumber(lua, asc_histogram_percentile(histogram, 50.0));
+    lua_setfield(lua, -2, "p50");
+    lua_pushnumber(lua, asc_histogram_percentile(histogram, 99.0));
+    lua_setfield(lua, -2, "p99");
+    lua_pushnumber(lua, asc_histogram_percentile(histogram, 99.9));
+    lua_setfield(lua, -2, "p999");
+    lua_pushnumber(lua, histogram->max);
+    lua_setfield(lua, -2, "max");
+    lua_setfield(lua, -2, name);
+}
@@ -0,0 +1,114 @@
+/*
+ * Astra Module: UDP (RTP)
+ * http://cesbo.com/astra
+ *
+ * Copyright (C) 2012-2015, Andrey Dyldin <and@cesbo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RTP_H_
+#define _RTP_H_ 1
+
+#include <astra.h>
+
+#define RTP_HEADER_SIZE 12
+
+#define RTP_IS_EXT(_data) ((_data[0] & 0x10))
+#define RTP_CSRC_COUNT(_data) ((_data[0] & 0x0F))
+#define RTP_GET_SEQ(_data) ((uint16_t)((_data[2] << 8) | _data[3]))
+
+/* sequence number jump to restart the reorder buffer */
+#define RTP_SEQ_RESET 3000
+
+/* returns size of the RTP header with CSRC list and extension or 0 on error */
+size_t rtp_header_size(const uint8_t *data, size_t size);
+
+/*
+ * oooooooooo  ooooooooooo  ooooooo  oooooooooo  ooooooooo  ooooooooooo oooooooooo
+ *  888    888  888    88 o888   888o 888    888  888    88o 888    88   888    888
+ *  888oooo88   888ooo8   888     888 888oooo88   888    888 888ooo8     888oooo88
+ *  888  88o    888    oo 888o   o888 888  88o    888    888 888    oo   888  88o
+ * o888o  88o8 o888ooo8888  88ooo88  o888o  88o8 o888ooo88  o888ooo8888 o888o  88o8
+ *
+ */
+
+typedef struct
+{
+    uint64_t packets;       // received datagrams
+    uint64_t lost;          // never received datagrams
+    uint64_t reordered;     // datagrams received after the next sequence number
+    uint64_t late;          // received after the delivery of the next datagrams
+    uint64_t duplicate;     // already in the buffer
+    uint64_t recovered;     // restored with FEC
+} rtp_stat_t;
+
+typedef void (*rtp_callback_t)(void *arg, const uint8_t *payload, size_t size);
+
+typedef struct
+{
+    bool is_set; // waits for delivery
+    bool is_received; // payload is kept after delivery until the slot is reused
+    uint16_t seq;
+    uint32_t size;
+    uint64_t time;
+    uint8_t *payload;
+} rtp_slot_t;
+
+/*
+ * keeps up to depth datagrams ordered by the sequence number.
+ * datagrams are delivered with callback in order, missing datagram is skipped
+ * if the buffer is full or the next datagram waits longer than delay.
+ * with depth 0 datagrams are delivered immediately, only counters are updated
+ */
+typedef struct
+{
+    rtp_callback_t callback;
+    void *arg;
+
+    uint32_t depth;
+    uint32_t slot_size;
+    uint64_t delay; // us
+
+    rtp_slot_t *slot_list;
+    uint8_t *buffer;
+    uint32_t head; // slot of the next_seq
+    uint32_t count;
+
+    bool is_started;
+    uint16_t next_seq;
+    uint16_t max_seq;
+    uint64_t history; // bit for each received datagram before max_seq (next_seq if depth > 0)
+
+    rtp_stat_t stat;
+} rtp_reorder_t;
+
+void rtp_reorder_init(  rtp_reorder_t *reorder, uint32_t depth, uint32_t slot_size
+                      , uint32_t delay_ms, rtp_callback_t callback, void *arg);
+void rtp_reorder_destroy(rtp_reorder_t *reorder);
+
+void rtp_reorder_push(  rtp_reorder_t *reorder, uint16_t seq
+                      , const uint8_t *payload, size_t size, uint64_t time);
+void rtp_reorder_timeout(rtp_reorder_t *reorder, uint64_t time);
+void rtp_reorder_flush(rtp_reorder_t *reorder);
+
+const rtp_slot_t * rtp_reorder_lookup(const rtp_reorder_t *reorder, uint16_t seq);
+bool rtp_reorder_is_pending(const rtp_reorder_t *reorder, uint16_t seq);
+bool rtp_reorder_recover(  rtp_reorder_t *reorder, uint16_t seq
+                         , const uint8_t *payload, size_t size, uint64_t time);
+
+void rtp_stat_push(const rtp_stat_t *stat);
+void udp_histogram_push(const asc_histogram_t *histogram, const char *name);
+
+#endif /* _RTP_H_ */
@@ -257,9 +257,30 @@ end
 init_input_module = {}
 kill_input_module = {}
 
-function init_input(conf)
-    local instance = { config = conf, }
+-- processing chain (input, channel, decrypt) is shared by the inputs
+-- with the same configuration
+input_instance_list = {}
+
+function input_instance_id(conf)
+    local function dump(value, skip_name)
+        if type(value) ~= "table" or value.__options then return tostring(value) end
+        local keys = {}
+        for k in pairs(value) do
+            if not (skip_name and k == "name") then
+                table.insert(keys, { tostring(k), k })
+            end
+        end
+        table.sort(keys, function(a, b) return a[1] < b[1] end)
+        local items = {}
+        for _,k in ipairs(keys) do
+            table.insert(items, k[1] .. "=" .. dump(value[k[2]], false))
+        end
+        return "{" .. table.concat(items, "&") .. "}"
+    end
+    return dump(conf, true)
+end
 
+function init_input(conf)
     if not conf.name then
         log.error("[init_input] option 'name' is required")
         astra.abort()
@@ -269,6 +290,23 @@ function init_input(conf)
         log.error("[" .. conf.name .. "] unknown input format")
         astra.abort()
     end
+
+    local instance_id = input_instance_id(conf)
+    local instance = input_instance_list[instance_id]
+    if instance then
+        instance.clients = instance.clients + 1
+        return instance
+    end
+
+    -- the chain options and the input modules modify the configuration,
+    -- the copy keeps the instance_id of the caller's table on the next init
+    local source = conf
+    conf = {}
+    for k,v in pairs(source) do conf[k] = v end
+
+    instance = { config = conf, id = instance_id, clients = 1, }
+    input_instance_list[instance_id] = instance
+
     instance.input = init_input_module[conf.format](conf)
     instance.tail = instance.input
 
@@ -359,6 +397,10 @@ end
 function kill_input(instance)
     if not instance then return nil end
 
+    instance.clients = instance.clients - 1
+    if instance.clients > 0 then return nil end
+    input_instance_list[instance.id] = nil
+
     instance.tail = nil
 
     kill_input_module[instance.config.format](instance.input, instance.config)
@@ -379,17 +421,39 @@ udp_input_instance_list = {}
 
 init_input_module.udp = function(conf)
     local instance_id = tostring(conf.localaddr) .. "@" .. conf.addr .. ":" .. conf.port
+    if conf.merge then instance_id = instance_id .. "+" .. tostring(conf.merge) end
     local instance = udp_input_instance_list[instance_id]
 
     if not instance then
         instance = { clients = 0, }
         udp_input_instance_list[instance_id] = instance
 
+        -- redundant sources: #merge=addr:port,localaddr@addr:port
+        local merge = conf.merge
+        if type(merge) == "string" then
+            merge = {}
+            for _,item in ipairs(conf.merge:split(",")) do
+                local leg = {}
+                if parse_url_format.udp(item, leg) then
+                    if not item:find(":") then leg.port = conf.port end
+                    if not leg.localaddr then leg.localaddr = conf.localaddr end
+                    table.insert(merge, leg)
+                else
+                    log.error("[" .. conf.name .. "] wrong merge source: " .. item)
+                end
+            end
+        end
+
         instance.input = udp_input({
             addr = conf.addr, port = conf.port, localaddr = conf.localaddr,
             socket_size = conf.socket_size,
             renew = conf.renew,
             rtp = conf.rtp,
+            reorder = conf.reorder,
+            reorder_delay = conf.reorder_delay,
+            fec = conf.fec,
+            merge = merge,
+            skew = conf.skew,
         })
     end
 
@@ -399,6 +463,7 @@ end
 
 kill_input_module.udp = function(module, conf)
     local instance_id = tostring(conf.localaddr) .. "@" .. conf.addr .. ":" .. conf.port
+    if conf.merge then instance_id = instance_id .. "+" .. tostring(conf.merge) end
     local instance = udp_input_instance_list[instance_id]
 
     instance.clients = instance.clients - 1
@@ -782,6 +847,8 @@ Astra Options:
     --no-stdout         do not print log messages into console
     --color             colored log messages in console
     --debug             print debug messages
+    --watchdog MS       report callbacks blocking the main loop
+                        longer than MS milliseconds
 ]])
 
     if _G.options_usage then
@@ -837,6 +904,12 @@ astra_options = {
         log.set({ debug = true })
         return 0
     end,
+    ["--watchdog"] = function(idx)
+        local ms = tonumber(argv[idx + 1])
+        if not ms then return -1 end
+        astra.watchdog(ms)
+        return 1
+    end,
 }
 
 function astra_parse_options(idx)
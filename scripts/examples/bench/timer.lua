@@ -0,0 +1,94 @@
+-- Main loop benchmark with 10000 timers
+--
+-- Loopback UDP stream wakes the main loop about 1000 times per second.
+-- Iteration time (loop_time from astra.stat) is measured without timers and
+-- with 10000 periodic timers that are not due. Timers are stored in the heap,
+-- so the iteration time should not depend on the number of timers.
+--
+-- Usage: astra scripts/examples/bench/timer.lua
+
+local port = 21100
+local timer_count = 10000
+local duration = 5
+
+local source_file = os.tmpname()
+
+-- 60 seconds, PCR in each 10th packet, about 10Mbit/s
+local ts_count = 400000
+local pcr_step = 10
+local pcr_interval = 40608 -- 27MHz, 1504us
+
+local function make_source()
+    local file = io.open(source_file, "wb")
+    local pcr = 0
+    for i = 0, ts_count - 1 do
+        local cc = i % 16
+        local header
+        if i % pcr_step == 0 then
+            local base = math.floor(pcr / 300) % 8589934592
+            local ext = pcr % 300
+            header = string.char(0x47, 0x01, 0x00, 0x30 + cc, 7, 0x10,
+                                 math.floor(base / 33554432) % 256,
+                                 math.floor(base / 131072) % 256,
+                                 math.floor(base / 512) % 256,
+                                 math.floor(base / 2) % 256,
+                                 (base % 2) * 128 + 0x7E + math.floor(ext / 256),
+                                 ext % 256)
+            pcr = pcr + pcr_interval
+        else
+            header = string.char(0x47, 0x01, 0x00, 0x10 + cc)
+        end
+        file:write(header, string.rep("\255", 188 - #header))
+    end
+    file:close()
+end
+
+local function report(name, stat)
+    local t = stat.loop_time
+    log.info(("[bench] %s: loops:%d loop_time avg:%dus p50:%dus p99:%dus max:%dus")
+             :format(name, stat.loop_count, t.avg, t.p50, t.p99, t.max))
+end
+
+make_source()
+
+rx = udp_input({ addr = "127.0.0.1", port = port, batch = 1 })
+tx_input = file_input({ filename = source_file })
+tx = udp_output({ upstream = tx_input:stream(), addr = "127.0.0.1", port = port, batch = 1 })
+
+local timer_list = {}
+local step = 0
+
+timer({
+    interval = duration,
+    callback = function(self)
+        step = step + 1
+        if step == 1 then
+            -- warm up
+            astra.stat(true)
+        elseif step == 2 then
+            report("0 timers", astra.stat(true))
+
+            local t = os.clock()
+            for i = 1, timer_count do
+                timer_list[i] = timer({ interval = 3600, callback = function() end })
+            end
+            log.info(("[bench] %d timers are started in %dms")
+                     :format(timer_count, (os.clock() - t) * 1000))
+
+            astra.stat(true)
+        else
+            report(timer_count .. " timers", astra.stat(true))
+
+            local t = os.clock()
+            for i = 1, timer_count do
+                timer_list[i]:close()
+            end
+            log.info(("[bench] %d timers are stopped in %dms")
+                     :format(timer_count, (os.clock() - t) * 1000))
+
+            self:close()
+            os.remove(source_file)
+            astra.exit()
+        end
+    end,
+})
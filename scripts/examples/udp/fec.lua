@@ -0,0 +1,155 @@
+-- SMPTE 2022-1 FEC loopback test
+--
+-- udp_output sends the RTP stream with FEC to the loopback interface and drops
+-- each Nth datagram after the FEC calculation. udp_input recovers the lost
+-- datagrams. The received stream should be a continuous part of the source
+-- file (file_input starts and ends on the PCR).
+-- The loss option of udp_output is a test hook, it is built only with:
+--     ./configure.sh --cflags="-DUDP_OUTPUT_LOSS"
+--
+-- Usage: astra scripts/examples/udp/fec.lua
+
+local port = 21000
+
+-- loss - each Nth datagram is dropped, one in each row and column of the matrix
+local test_list = {
+    { name = "2D", fec_columns = 5, fec_rows = 5, loss = 6 },
+    { name = "1D", fec_columns = 5, fec_rows = 1, loss = 5 },
+}
+
+local source_file = os.tmpname()
+local result_file = os.tmpname()
+
+-- PCR in each 10th packet, about 10Mbit/s
+local pcr_step = 10
+-- file_input sends packets between the first and the last PCR:
+-- 7000 packets, 1000 datagrams with 7 packets, 40 complete 5x5 matrices
+local ts_count = 7000 + pcr_step * 2
+local pcr_interval = 40608 -- 27MHz, 1504us
+
+local function make_source()
+    local file = io.open(source_file, "wb")
+    local pcr = 0
+    for i = 0, ts_count - 1 do
+        local cc = i % 16
+        local header
+        if i % pcr_step == 0 then
+            local base = math.floor(pcr / 300) % 8589934592
+            local ext = pcr % 300
+            header = string.char(0x47, 0x01, 0x00, 0x30 + cc, 7, 0x10,
+                                 math.floor(base / 33554432) % 256,
+                                 math.floor(base / 131072) % 256,
+                                 math.floor(base / 512) % 256,
+                                 math.floor(base / 2) % 256,
+                                 (base % 2) * 128 + 0x7E + math.floor(ext / 256),
+                                 ext % 256)
+            pcr = pcr + pcr_interval
+        else
+            header = string.char(0x47, 0x01, 0x00, 0x10 + cc)
+        end
+        local id = string.char(math.floor(i / 256) % 256, i % 256)
+        file:write(header, string.rep(id, (188 - #header) / 2))
+    end
+    file:close()
+end
+
+local function read_file(filename)
+    local file = io.open(filename, "rb")
+    local data = file:read("*a")
+    file:close()
+    return data
+end
+
+make_source()
+
+local test_id = 0
+local run_test
+
+local function check(test)
+    rx_output = nil
+    collectgarbage()
+
+    local status = rx:status()
+    local source = read_file(source_file)
+    local result = read_file(result_file)
+
+    log.info(("[fec %s] packets:%d lost:%d recovered:%d. received %d of %d bytes")
+             :format(test.name, status.packets, status.lost, status.recovered,
+                     #result, #source))
+
+    if status.recovered == 0 and status.lost == 0 then
+        log.error("[fec " .. test.name .. "] no datagrams are dropped. "
+                  .. "udp_output is built without UDP_OUTPUT_LOSS")
+        os.remove(source_file)
+        os.remove(result_file)
+        os.exit(1)
+    end
+
+    if status.recovered == 0 or status.lost > 0 or #result < #source * 0.9
+       or not source:find(result, 1, true)
+    then
+        log.error("[fec " .. test.name .. "] test failed")
+        os.remove(source_file)
+        os.remove(result_file)
+        os.exit(1)
+    end
+
+    log.info("[fec " .. test.name .. "] test passed")
+
+    tx = nil
+    tx_input = nil
+    rx = nil
+    collectgarbage()
+
+    run_test()
+end
+
+run_test = function()
+    test_id = test_id + 1
+    local test = test_list[test_id]
+    if not test then
+        os.remove(source_file)
+        os.remove(result_file)
+        astra.exit()
+        return
+    end
+
+    os.remove(result_file)
+
+    rx = udp_input({
+        addr = "127.0.0.1",
+        port = port,
+        rtp = true,
+        fec = true,
+    })
+
+    rx_output = file_output({
+        upstream = rx:stream(),
+        filename = result_file,
+    })
+
+    tx_input = file_input({
+        filename = source_file,
+        callback = function()
+            timer({
+                interval = 2,
+                callback = function(self)
+                    self:close()
+                    check(test)
+                end,
+            })
+        end,
+    })
+
+    tx = udp_output({
+        upstream = tx_input:stream(),
+        addr = "127.0.0.1",
+        port = port,
+        rtp = true,
+        fec_columns = test.fec_columns,
+        fec_rows = test.fec_rows,
+        loss = test.loss,
+    })
+end
+
+run_test()
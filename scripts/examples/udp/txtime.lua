@@ -0,0 +1,141 @@
+-- udp_output sync pacing jitter test
+--
+-- udp_output sends the file with the sync option to the loopback interface,
+-- udp_input takes the time of each received datagram (iat option) and reports
+-- the deviation of the inter-arrival time from the average (jitter).
+-- The receive time is taken by the kernel. Jitter p99 includes the wakeup
+-- delay of the sender thread, it depends on the host: the limit is extended
+-- by the sending delay reported by udp_output status().
+-- The test is run without and with the txtime option. SO_TXTIME is applied
+-- by the fq or etf qdisc only, loopback has no qdisc by default:
+--     tc qdisc replace dev lo root fq
+--
+-- Usage: astra scripts/examples/udp/txtime.lua
+
+local port = 21200
+
+-- target of the jitter p99, microseconds
+local jitter_max = 100
+
+local test_list = {
+    { name = "sync", txtime = false },
+    { name = "sync+txtime", txtime = true },
+}
+
+local duration = 10
+
+local source_file = os.tmpname()
+
+-- 15 seconds, PCR in each 10th packet, about 10Mbit/s:
+-- datagram with 7 TS packets each 1053us
+local ts_count = 100000
+local pcr_step = 10
+local pcr_interval = 40608 -- 27MHz, 1504us
+
+local function make_source()
+    local file = io.open(source_file, "wb")
+    local pcr = 0
+    for i = 0, ts_count - 1 do
+        local cc = i % 16
+        local header
+        if i % pcr_step == 0 then
+            local base = math.floor(pcr / 300) % 8589934592
+            local ext = pcr % 300
+            header = string.char(0x47, 0x01, 0x00, 0x30 + cc, 7, 0x10,
+                                 math.floor(base / 33554432) % 256,
+                                 math.floor(base / 131072) % 256,
+                                 math.floor(base / 512) % 256,
+                                 math.floor(base / 2) % 256,
+                                 (base % 2) * 128 + 0x7E + math.floor(ext / 256),
+                                 ext % 256)
+            pcr = pcr + pcr_interval
+        else
+            header = string.char(0x47, 0x01, 0x00, 0x10 + cc)
+        end
+        file:write(header, string.rep("\255", 188 - #header))
+    end
+    file:close()
+end
+
+make_source()
+
+local test_id = 0
+local is_failed = false
+local run_test
+
+local function check(test)
+    local status = rx:status()
+    local iat = status.iat
+    local jitter = status.jitter
+    local late = tx:status().late
+
+    log.info(("[txtime %s] datagrams:%d iat avg:%dus p50:%dus p99:%dus max:%dus")
+             :format(test.name, iat.count, iat.avg, iat.p50, iat.p99, iat.max))
+    log.info(("[txtime %s] jitter avg:%dus p50:%dus p99:%dus max:%dus")
+             :format(test.name, jitter.avg, jitter.p50, jitter.p99, jitter.max))
+    log.info(("[txtime %s] sending delay avg:%dus p50:%dus p99:%dus p999:%dus max:%dus")
+             :format(test.name, late.avg, late.p50, late.p99, late.p999, late.max))
+
+    -- pacing error moves most of the datagrams. delayed sending changes
+    -- two inter-arrival times by up to the sum of the delays, so less than
+    -- 0.2% of the jitter values have the delay greater than p999.
+    -- percentiles are the upper bounds of the histogram buckets (12.5%)
+    local limit = math.floor((jitter_max + late.p999 * 2) * 1.125)
+    if iat.count == 0 or jitter.p50 > jitter_max then
+        log.error(("[txtime %s] test failed: jitter p50 is greater than %dus")
+                  :format(test.name, jitter_max))
+        is_failed = true
+    elseif jitter.p99 > limit then
+        log.error(("[txtime %s] test failed: jitter p99 is greater than %dus")
+                  :format(test.name, limit))
+        is_failed = true
+    elseif jitter.p99 > jitter_max then
+        log.warning(("[txtime %s] test passed. jitter p99 is greater than %dus, "
+                     .. "the host delays the sending")
+                    :format(test.name, jitter_max))
+    else
+        log.info("[txtime " .. test.name .. "] test passed")
+    end
+
+    tx = nil
+    tx_input = nil
+    rx = nil
+    collectgarbage()
+
+    run_test()
+end
+
+run_test = function()
+    test_id = test_id + 1
+    local test = test_list[test_id]
+    if not test then
+        os.remove(source_file)
+        if is_failed then
+            os.exit(1)
+        end
+        astra.exit()
+        return
+    end
+
+    rx = udp_input({ addr = "127.0.0.1", port = port, batch = 1, iat = true })
+
+    tx_input = file_input({ filename = source_file })
+
+    tx = udp_output({
+        upstream = tx_input:stream(),
+        addr = "127.0.0.1",
+        port = port,
+        sync = 1,
+        txtime = test.txtime,
+    })
+
+    timer({
+        interval = duration,
+        callback = function(self)
+            self:close()
+            check(test)
+        end,
+    })
+end
+
+run_test()
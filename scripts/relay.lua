@@ -153,7 +153,6 @@ function on_request_stat(server, client, request)
                 headers = {
                     "WWW-Authenticate: Basic realm=\"Astra Relay\"",
                     "Content-Length: 0",
-                    "Connection: close",
                 }
             })
             return nil
@@ -164,12 +163,38 @@ function on_request_stat(server, client, request)
         code = 200,
         headers = {
             "Content-Type: text/html; charset=utf-8",
-            "Connection: close",
         },
         content = render_stat_html(),
     })
 end
 
+function on_request_stat_loop(server, client, request)
+    if not request then return nil end
+
+    if relay_stat_pass then
+        if request.headers['authorization'] ~= relay_stat_pass then
+            server:send(client, {
+                code = 401,
+                headers = {
+                    "WWW-Authenticate: Basic realm=\"Astra Relay\"",
+                    "Content-Length: 0",
+                }
+            })
+            return nil
+        end
+    end
+
+    local reset = (request.query and request.query.reset) and true or false
+
+    server:send(client, {
+        code = 200,
+        headers = {
+            "Content-Type: application/json; charset=utf-8",
+        },
+        content = json.encode(astra.stat(reset)),
+    })
+end
+
 -- oooooooooo ooooo            o   ooooo  oooo ooooo       ooooo  oooooooo8 ooooooooooo
 --  888    888 888            888    888  88    888         888  888        88  888  88
 --  888oooo88  888           8  88     888      888         888   888oooooo     888
@@ -190,7 +215,6 @@ function on_request_playlist(server, client, request)
                 code = 200,
                 headers = {
                     "Content-Type: " .. content_type,
-                    "Connection: close",
                 },
                 content = content,
             })
@@ -435,6 +459,7 @@ function main()
     log.info("Astra Relay started on " .. relay_addr .. ":" .. relay_port)
 
     local route = {
+        { "/stat/loop", on_request_stat_loop },
         { "/stat/", on_request_stat },
         { "/stat", http_redirect({ location = "/stat/" }) },
     }
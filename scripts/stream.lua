@@ -306,6 +306,8 @@ init_output_module.udp = function(channel_data, output_id)
         rtp = (output_data.config.format == "rtp"),
         sync = output_data.config.sync,
         cbr = output_data.config.cbr,
+        fec_columns = output_data.config.fec_columns,
+        fec_rows = output_data.config.fec_rows,
     })
 end
 
@@ -425,6 +427,11 @@ function http_output_on_request(server, client, request)
             upstream = channel_data.tail:stream(),
             buffer_size = client_data.output_data.config.buffer_size,
             buffer_fill = client_data.output_data.config.buffer_fill,
+            fast_start = client_data.output_data.config.fast_start,
+            overflow = client_data.output_data.config.overflow,
+            overflow_limit = client_data.output_data.config.overflow_limit,
+            drop_pids = client_data.output_data.config.drop_pids,
+            zerocopy = client_data.output_data.config.zerocopy,
         })
     end
 
@@ -442,6 +449,7 @@ init_output_module.http = function(channel_data, output_id)
             addr = output_data.config.host,
             port = output_data.config.port,
             sctp = output_data.config.sctp,
+            reuseport = (worker_count > 1 and not output_data.config.worker_relay),
             route = {
                 { "/*", http_upstream({ callback = http_output_on_request }) },
             },
@@ -589,6 +597,7 @@ end
 --  888oooo88  o888o o888o o88o  o888o o88o    88  o88o    88  o888ooo8888 o888ooooo88
 
 channel_list = {}
+channel_index = 0
 
 function make_channel(channel_config)
     if not channel_config.name then
@@ -677,6 +686,34 @@ function make_channel(channel_config)
         end
     end
 
+    -- channel belongs to the one worker. other workers keep only http outputs
+    -- to serve clients accepted on the shared port. the stream is relayed
+    -- from the owner worker over the loopback, so the input is opened once
+    channel_index = channel_index + 1
+    if worker_count > 1 then
+        local owner_id = channel_index % worker_count
+        local relay = { config = parse_url("http://127.0.0.1:" .. (worker_port + owner_id)
+                                           .. "/" .. channel_index) }
+        relay.config.name = channel_config.name .. " relay"
+
+        local http_output = {}
+        for _, o in ipairs(channel_data.output) do
+            if o.config.format == "http" then table.insert(http_output, o) end
+        end
+
+        if owner_id == worker_id then
+            if #http_output > 0 then
+                relay.config.worker_relay = true
+                table.insert(channel_data.output, relay)
+            end
+        else
+            if #http_output == 0 then return nil end
+            for _, o in ipairs(http_output) do o.config.keep_active = nil end
+            channel_data.output = http_output
+            channel_data.input = { relay }
+        end
+    end
+
     if #channel_data.output == 0 then
         channel_data.clients = 1
     else
@@ -755,14 +792,47 @@ end
 -- o88oooo888    o888o    o888o  88o8 o888ooo8888 o88o  o888o o88o  8  o88o
 
 options_usage = [[
+    --workers COUNT     start channels in COUNT processes
+    --worker-port PORT  first port to relay channels between workers on 127.0.0.1.
+                        worker uses PORT + id. default: 8100
     FILE                Astra script
 ]]
 
+worker_id = 0
+worker_count = 1
+worker_port = 8100
+
+-- scripts are loaded in main() after the workers start,
+-- so the options could be defined in any order
+local script_list = {}
+
 options = {
+    ["--workers"] = function(idx)
+        local count = tonumber(argv[idx + 1])
+        if not count or count < 1 then
+            log.error("[stream] option '--workers' has wrong format")
+            astra.exit()
+        end
+        if not worker then
+            log.error("[stream] workers are not available")
+            astra.exit()
+        end
+        worker_count = count
+        return 1
+    end,
+    ["--worker-port"] = function(idx)
+        local port = tonumber(argv[idx + 1])
+        if not port or port < 1 or port > 65535 then
+            log.error("[stream] option '--worker-port' has wrong format")
+            astra.exit()
+        end
+        worker_port = port
+        return 1
+    end,
     ["*"] = function(idx)
         local filename = argv[idx]
         if utils.stat(filename).type == "file" then
-            dofile(filename)
+            table.insert(script_list, filename)
             return 0
         end
         return -1
@@ -771,4 +841,12 @@ options = {
 
 function main()
     log.info("Starting Astra " .. astra.version)
+
+    if worker_count > 1 then
+        worker_id = worker.fork(worker_count)
+    end
+
+    for _, filename in ipairs(script_list) do
+        dofile(filename)
+    end
 end